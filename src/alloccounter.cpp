@@ -0,0 +1,68 @@
+#include "alloccounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Plain counters rather than members, operator new can run before any constructor
+static std::atomic<unsigned long long> allocations(0);
+static std::atomic<unsigned long long> bytes(0);
+
+
+/** --------------------------------------------------------------------------------------
+ Replaces the global operator new to count each allocation. Array and nothrow forms call
+ this one, so they are counted too
+
+ @param size  Number of bytes to allocate
+ @returns     The allocated memory
+ */
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* memory = malloc(size == 0 ? 1 : size);
+
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Replaces the global operator delete to match operator new
+
+ @param memory  Memory allocated by operator new
+ */
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of allocations made since the process started
+
+ @returns The number of allocations
+ */
+unsigned long long AllocCounter::getAllocations()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of bytes allocated since the process started, frees are not subtracted
+
+ @returns The number of bytes
+ */
+unsigned long long AllocCounter::getBytes()
+{
+    return bytes.load(std::memory_order_relaxed);
+}
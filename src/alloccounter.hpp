@@ -0,0 +1,20 @@
+#ifndef alloccounter_hpp
+#define alloccounter_hpp
+
+#include <stddef.h>
+
+
+/**
+ Counts every heap allocation the process makes through operator new, so a frame or tick
+ that should not allocate can be checked. The counts only ever go up, take the difference
+ between two reads
+ */
+class AllocCounter
+{
+public:
+    static unsigned long long getAllocations();
+    static unsigned long long getBytes();
+};
+
+
+#endif /* alloccounter_hpp */
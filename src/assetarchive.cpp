@@ -0,0 +1,393 @@
+#include "assetarchive.hpp"
+
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#ifdef ASSETARCHIVE_LZ4
+  #include <lz4.h>
+#endif
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an archive with nothing open
+
+ */
+AssetArchive::AssetArchive()
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the archive, unmapping the file. Surfaces made by createSurface point into
+ the mapping, so they must be freed first
+
+ */
+AssetArchive::~AssetArchive()
+{
+    close();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Maps a whole file into memory read only. Pages are only read from disk when touched, so
+ mapping a large archive costs nothing until its images are used
+
+ @param path  Path of the file
+ @returns     False if the file could not be mapped
+ */
+bool AssetArchive::map(const std::string& path)
+{
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    data = (const Uint8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    dataSize = (size_t)fileSize.QuadPart;
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+
+    if (file == -1)
+    {
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (mapped == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    data = (const Uint8*)mapped;
+    dataSize = status.st_size;
+#endif
+
+    return data != nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Maps an archive and checks its index, closing whatever was open before
+
+ @param path  Path of the archive
+ @returns     False if there is no archive there or it is not one this build can read
+ */
+bool AssetArchive::open(const std::string& path)
+{
+    close();
+
+    if (!map(path))
+    {
+        return false;
+    }
+
+    header = (const ArchiveHeader*)data;
+
+    if (dataSize < sizeof(ArchiveHeader) || memcmp(header->magic, ARCHIVE_MAGIC, 4) != 0 ||
+        header->version != ARCHIVE_VERSION ||
+        dataSize < sizeof(ArchiveHeader) + (size_t)header->entryCount * sizeof(ArchiveEntry))
+    {
+        printf("%s is not an asset archive this version can read\n", path.c_str());
+        close();
+        return false;
+    }
+
+    entries = (const ArchiveEntry*)(data + sizeof(ArchiveHeader));
+
+    // Check every entry once here so lookups never have to. Entries have to be stored in a
+    // way this build can read, rows have to hold the width in pixels, and uncompressed
+    // pixels are read straight from the file, so every row has to be inside it
+    for (Uint32 i = 0; i < header->entryCount; i++)
+    {
+        const ArchiveEntry& entry = entries[i];
+        const Uint64 pixelBytes = (Uint64)entry.pitch * entry.height;
+
+        if (entry.name[ARCHIVE_NAME_LENGTH - 1] != '\0' || entry.offset > dataSize ||
+            entry.storedSize > dataSize - entry.offset || entry.size < pixelBytes ||
+            !isCompressionSupported(entry.compression) ||
+            entry.pitch < (Uint64)entry.width * SDL_BYTESPERPIXEL(entry.format) ||
+            (entry.compression == ARCHIVE_UNCOMPRESSED && entry.storedSize < pixelBytes))
+        {
+            printf("%s has a broken entry %u\n", path.c_str(), i);
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Unmaps the archive if one is open
+
+ */
+void AssetArchive::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data != nullptr)
+    {
+        munmap((void*)data, dataSize);
+    }
+
+    if (file != -1)
+    {
+        ::close(file);
+    }
+
+    file = -1;
+#endif
+
+    data = nullptr;
+    dataSize = 0;
+    header = nullptr;
+    entries = nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether an archive is open
+
+ @returns True if an archive is mapped
+ */
+bool AssetArchive::isOpen() const { return header != nullptr; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of images in the archive
+
+ @returns Number of entries, 0 if nothing is open
+ */
+int AssetArchive::size() const { return header != nullptr ? header->entryCount : 0; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Looks up an image by the path it was packed from, with a binary search of the index
+
+ @param name  Path of the image relative to the game directory, either separator
+ @returns     Entry of the image, nullptr if it is not in the archive
+ */
+const ArchiveEntry* AssetArchive::find(const std::string& name) const
+{
+    if (header == nullptr || name.size() >= ARCHIVE_NAME_LENGTH)
+    {
+        return nullptr;
+    }
+
+    // Entries always use / separators, paths on Windows are built with backslashes
+    char key[ARCHIVE_NAME_LENGTH];
+
+    for (size_t i = 0; i <= name.size(); i++)
+    {
+        key[i] = name.c_str()[i] == '\\' ? '/' : name.c_str()[i];
+    }
+
+    int low = 0, high = (int)header->entryCount - 1;
+
+    while (low <= high)
+    {
+        const int middle = (low + high) / 2;
+        const int order = strcmp(entries[middle].name, key);
+
+        if (order == 0)
+        {
+            return &entries[middle];
+        }
+
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether this build can read entries stored with a compression
+
+ @param compression  One of ArchiveCompression
+ @returns            True if such entries can be loaded
+ */
+bool AssetArchive::isCompressionSupported(Uint32 compression)
+{
+#ifdef ASSETARCHIVE_LZ4
+    return compression == ARCHIVE_UNCOMPRESSED || compression == ARCHIVE_LZ4;
+#else
+    return compression == ARCHIVE_UNCOMPRESSED;
+#endif
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Decompresses the pixels of a compressed entry
+
+ @param entry   Entry to decompress
+ @param pixels  Buffer of at least entry->size bytes to decompress into
+ @returns       False if the entry could not be decompressed
+ */
+bool AssetArchive::decompress(const ArchiveEntry* entry, void* pixels) const
+{
+#ifdef ASSETARCHIVE_LZ4
+    if (entry->compression == ARCHIVE_LZ4)
+    {
+        const int written = LZ4_decompress_safe((const char*)data + entry->offset, (char*)pixels,
+                                                (int)entry->storedSize, (int)entry->size);
+        return written == (int)entry->size;
+    }
+#endif
+
+    printf("Cannot decompress %s, compression %u is not supported by this build\n", entry->name, entry->compression);
+    return false;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a texture of an image. Uncompressed pixels are uploaded straight from the mapped
+ file, the only copy is the one the driver makes
+
+ @param renderer  Renderer to create the texture with
+ @param entry     Entry of the image
+ @returns         The texture, nullptr if it could not be created
+ */
+SDL_Texture* AssetArchive::createTexture(SDL_Renderer* renderer, const ArchiveEntry* entry) const
+{
+    SDL_Texture* texture = SDL_CreateTexture(renderer, entry->format, SDL_TEXTUREACCESS_STATIC,
+                                             entry->width, entry->height);
+
+    if (texture == nullptr)
+    {
+        printf("Failed to create texture for %s: %s\n", entry->name, SDL_GetError());
+        return nullptr;
+    }
+
+    // Textures made this way do not blend by default, unlike those made from surfaces
+    if (SDL_ISPIXELFORMAT_ALPHA(entry->format))
+    {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+
+    if (entry->compression == ARCHIVE_UNCOMPRESSED)
+    {
+        SDL_UpdateTexture(texture, nullptr, data + entry->offset, entry->pitch);
+        return texture;
+    }
+
+    std::vector<Uint8> pixels(entry->size);
+
+    if (!decompress(entry, pixels.data()))
+    {
+        SDL_DestroyTexture(texture);
+        return nullptr;
+    }
+
+    SDL_UpdateTexture(texture, nullptr, pixels.data(), entry->pitch);
+
+    return texture;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a surface of an image for CPU side use. An uncompressed surface points straight
+ into the mapped file, it must be treated as read only and freed before the archive is
+ closed
+
+ @param entry     Entry of the image
+ @returns         The surface for the caller to free, nullptr if it could not be created
+ */
+SDL_Surface* AssetArchive::createSurface(const ArchiveEntry* entry) const
+{
+    if (entry->compression == ARCHIVE_UNCOMPRESSED)
+    {
+        return SDL_CreateRGBSurfaceWithFormatFrom((void*)(data + entry->offset), entry->width, entry->height,
+                                                  SDL_BITSPERPIXEL(entry->format), entry->pitch, entry->format);
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, entry->width, entry->height,
+                                                          SDL_BITSPERPIXEL(entry->format), entry->format);
+
+    if (surface == nullptr)
+    {
+        return nullptr;
+    }
+
+    // Packed rows are never padded, so only a surface with the same pitch can take them
+    if (surface->pitch != (int)entry->pitch || !decompress(entry, surface->pixels))
+    {
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+
+    return surface;
+}
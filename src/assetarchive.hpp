@@ -0,0 +1,100 @@
+#ifndef assetarchive_hpp
+#define assetarchive_hpp
+
+#include <stdio.h>
+#include <string>
+#include <SDL.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+/**
+ Archive layout, every field little endian:
+
+     ArchiveHeader
+     ArchiveEntry[entryCount], sorted by name
+     pixel data of each entry, starting on an ARCHIVE_ALIGNMENT boundary
+
+ Images are stored already decoded, in the pixel format given to the packer, so loading
+ one is a texture upload straight from the mapped file with no decoding and no copy.
+ Entries compressed with LZ4 are decompressed into a buffer first
+ */
+#define ARCHIVE_MAGIC "SGAR"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_ALIGNMENT 64
+#define ARCHIVE_NAME_LENGTH 96
+
+enum ArchiveCompression
+{
+    ARCHIVE_UNCOMPRESSED = 0,
+    ARCHIVE_LZ4 = 1
+};
+
+
+struct ArchiveHeader
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 entryCount;
+    Uint32 reserved;
+};
+
+
+struct ArchiveEntry
+{
+    // Path of the image relative to the game directory with / separators, 0 terminated
+    char name[ARCHIVE_NAME_LENGTH];
+
+    Uint32 format;
+    Uint32 width, height, pitch;
+    Uint32 compression;
+    Uint32 reserved;
+
+    // Where the pixels start in the file, the bytes they take there and once decompressed
+    Uint64 offset, storedSize, size;
+};
+
+static_assert(sizeof(ArchiveHeader) == 16, "ArchiveHeader must match the file layout");
+static_assert(sizeof(ArchiveEntry) == 144, "ArchiveEntry must match the file layout");
+
+
+class AssetArchive
+{
+private:
+    const Uint8* data = nullptr;
+    size_t dataSize = 0;
+
+    const ArchiveHeader* header = nullptr;
+    const ArchiveEntry* entries = nullptr;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    AssetArchive(const AssetArchive&);
+    AssetArchive& operator=(const AssetArchive&);
+
+    bool map(const std::string& path);
+    bool decompress(const ArchiveEntry* entry, void* pixels) const;
+
+public:
+    AssetArchive();
+    ~AssetArchive();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    int size() const;
+
+    const ArchiveEntry* find(const std::string& name) const;
+    SDL_Texture* createTexture(SDL_Renderer* renderer, const ArchiveEntry* entry) const;
+    SDL_Surface* createSurface(const ArchiveEntry* entry) const;
+
+    static bool isCompressionSupported(Uint32 compression);
+};
+
+
+#endif /* assetarchive_hpp */
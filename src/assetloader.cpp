@@ -0,0 +1,304 @@
+#include "assetloader.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Constructs an asset loader with a pool of worker threads that decode images in the
+ background. Only uploading to the GPU is left to the render thread
+
+ @param textureCache  Texture cache decoded textures are uploaded into
+ @param threadCount   Number of worker threads to decode images on
+ */
+AssetLoader::AssetLoader(TextureCache *textureCache, int threadCount)
+    : textureCache(textureCache)
+{
+    // Initialise the PNG loader here rather than letting the first workers race to do it
+    IMG_Init(IMG_INIT_PNG);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers.push_back(std::thread(&AssetLoader::work, this));
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an asset loader with a worker for every hardware thread but the render thread
+
+ @param textureCache  Texture cache decoded textures are uploaded into
+ */
+AssetLoader::AssetLoader(TextureCache *textureCache)
+    : AssetLoader(textureCache, SDL_GetCPUCount() > 1 ? SDL_GetCPUCount() - 1 : 1)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the loader, waiting for the workers to finish the image they are decoding
+ and freeing anything decoded but never used
+
+ */
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (Decoded& image : decoded)
+    {
+        SDL_FreeSurface(image.surface);
+    }
+
+    for (auto& surface : surfaces)
+    {
+        SDL_FreeSurface(surface.second);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Worker thread loop, decodes requested images until the loader is destroyed
+
+ */
+void AssetLoader::work()
+{
+    while (true)
+    {
+        Request request;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+
+            if (stopping)
+            {
+                return;
+            }
+
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        SDL_Surface* surface = IMG_Load(request.path.c_str());
+
+        if (surface == nullptr)
+        {
+            printf("Failed to load %s: %s\n", request.path.c_str(), IMG_GetError());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Decoded image = {request, surface, nullptr};
+        decoded.push_back(image);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Queues an image to be decoded by a worker, or straight to the render thread if it is in
+ the texture cache's archive and there is nothing to decode
+
+ @param path         Path of the image file
+ @param keepSurface  True to keep the image as a surface instead of uploading it
+ */
+void AssetLoader::queue(const std::string& path, bool keepSurface)
+{
+    AssetArchive* archive = textureCache->getArchive();
+    const ArchiveEntry* entry = archive != nullptr ? archive->find(path) : nullptr;
+    Request request = {path, keepSurface};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (entry != nullptr)
+        {
+            Decoded image = {request, nullptr, entry};
+            decoded.push_back(image);
+        }
+        else
+        {
+            requests.push_back(request);
+        }
+    }
+
+    total++;
+
+    if (entry == nullptr)
+    {
+        wake.notify_one();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Queues an image to be decoded in the background and uploaded into the texture cache. The
+ texture is held by the loader until release is called, so loading it from the cache in
+ the meantime is a hit
+
+ @param path  Path of the image file
+ */
+void AssetLoader::requestTexture(const std::string& path)
+{
+    queue(path, false);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Queues an image to be decoded in the background and kept as a surface for CPU side use,
+ for example packing into an atlas
+
+ @param path  Path of the image file
+ */
+void AssetLoader::requestSurface(const std::string& path)
+{
+    queue(path, true);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Uploads images the workers have decoded, must be called on the render thread. Limiting
+ the number of uploads per call keeps a loading screen responsive
+
+ @param maxUploads  Largest number of images to handle in this call, -1 for no limit
+ @returns           Number of images handled
+ */
+int AssetLoader::upload(int maxUploads)
+{
+    int handled = 0;
+
+    while (maxUploads < 0 || handled < maxUploads)
+    {
+        Decoded image;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (decoded.empty())
+            {
+                break;
+            }
+
+            image = decoded.front();
+            decoded.pop_front();
+        }
+
+        // Archived images are uploaded from the mapped archive, surfaces point into it
+        if (image.entry != nullptr && image.request.keepSurface)
+        {
+            image.surface = textureCache->getArchive()->createSurface(image.entry);
+        }
+        else if (image.entry != nullptr && textureCache->getRenderer() != nullptr)
+        {
+            std::shared_ptr<SDL_Texture> handle = textureCache->insert(image.request.path,
+                textureCache->getArchive()->createTexture(textureCache->getRenderer(), image.entry));
+
+            if (handle)
+            {
+                held.push_back(handle);
+            }
+        }
+
+        if (image.surface != nullptr && image.request.keepSurface)
+        {
+            surfaces[image.request.path] = image.surface;
+        }
+        else if (image.surface != nullptr)
+        {
+            SDL_Texture* texture = nullptr;
+
+            if (textureCache->getRenderer() != nullptr)
+            {
+                texture = SDL_CreateTextureFromSurface(textureCache->getRenderer(), image.surface);
+            }
+
+            SDL_FreeSurface(image.surface);
+
+            std::shared_ptr<SDL_Texture> handle = textureCache->insert(image.request.path, texture);
+
+            if (handle)
+            {
+                held.push_back(handle);
+            }
+        }
+
+        finished++;
+        handled++;
+    }
+
+    return handled;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Takes ownership of a decoded surface requested with requestSurface
+
+ @param path  Path of the image file
+ @returns     The decoded surface for the caller to free, nullptr if it is not loaded
+ */
+SDL_Surface* AssetLoader::takeSurface(const std::string& path)
+{
+    auto surface = surfaces.find(path);
+
+    if (surface == surfaces.end())
+    {
+        return nullptr;
+    }
+
+    SDL_Surface* taken = surface->second;
+    surfaces.erase(surface);
+
+    return taken;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Lets go of the loaded textures, once their users hold their own handles from the cache
+
+ */
+void AssetLoader::release()
+{
+    held.clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how much of the requested work is done
+
+ @returns Fraction of requested images that are decoded and uploaded, 0 to 1
+ */
+float AssetLoader::getProgress() const
+{
+    return total > 0 ? (float)finished / total : 1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether every requested image is decoded and uploaded
+
+ @returns True when nothing is left to load
+ */
+bool AssetLoader::isReady() const { return finished == total; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of images requested and the number finished so far
+ */
+int AssetLoader::getTotal() const { return total; }
+int AssetLoader::getFinished() const { return finished; }
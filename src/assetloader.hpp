@@ -0,0 +1,74 @@
+#ifndef assetloader_hpp
+#define assetloader_hpp
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "texturecache.hpp"
+
+
+class AssetLoader
+{
+private:
+    struct Request
+    {
+        std::string path;
+        bool keepSurface;
+    };
+
+    struct Decoded
+    {
+        Request request;
+        SDL_Surface* surface;
+
+        // Set instead of surface for images in the archive, which need no decoding
+        const ArchiveEntry* entry;
+    };
+
+    TextureCache *textureCache;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // Paths waiting for a worker and images a worker has decoded, both guarded by mutex
+    std::deque<Request> requests;
+    std::deque<Decoded> decoded;
+
+    // Only touched by the render thread
+    std::vector<std::shared_ptr<SDL_Texture>> held;
+    std::map<std::string, SDL_Surface*> surfaces;
+    int total = 0, finished = 0;
+
+    void work();
+    void queue(const std::string& path, bool keepSurface);
+
+public:
+    AssetLoader(TextureCache *textureCache, int threadCount);
+    AssetLoader(TextureCache *textureCache);
+    ~AssetLoader();
+
+    void requestTexture(const std::string& path);
+    void requestSurface(const std::string& path);
+    int upload(int maxUploads);
+
+    SDL_Surface* takeSurface(const std::string& path);
+    void release();
+
+    float getProgress() const;
+    bool isReady() const;
+    int getTotal() const;
+    int getFinished() const;
+};
+
+
+#endif /* assetloader_hpp */
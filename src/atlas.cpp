@@ -0,0 +1,337 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+
+// Gap left between packed images so filtering never samples a neighbouring image
+#define ATLAS_PADDING 2
+
+
+/** --------------------------------------------------------------------------------------
+ Rounds a size up to a power of two
+
+ @param size  Size of at least 1
+ @returns     The smallest power of two no less than size
+ */
+static int roundUpToPowerOfTwo(int size)
+{
+    int rounded = 1;
+
+    while (rounded < size)
+    {
+        rounded *= 2;
+    }
+
+    return rounded;
+}
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty texture atlas with square pages of a given size
+
+ @param renderer  Renderer to create the page textures with
+ @param pageSize  Width and height of each page
+ */
+Atlas::Atlas(SDL_Renderer *renderer, int pageSize)
+    : renderer(renderer), pageSize(pageSize)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty texture atlas with pages as large as the renderer supports, up to
+ 4096 x 4096
+
+ @param renderer  Renderer to create the page textures with
+ */
+Atlas::Atlas(SDL_Renderer *renderer)
+    : Atlas(renderer, 4096)
+{
+    SDL_RendererInfo info;
+
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0)
+    {
+        pageSize = std::min(pageSize, std::min(info.max_texture_width, info.max_texture_height));
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the atlas, destroying the page textures and any images never built
+
+ */
+Atlas::~Atlas()
+{
+    for (PendingImage& image : pending)
+    {
+        SDL_FreeSurface(image.surface);
+    }
+
+    for (SDL_Texture* page : pages)
+    {
+        if (rotations != nullptr)
+        {
+            rotations->evict(page);
+        }
+
+        SDL_DestroyTexture(page);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Loads an image to be packed into the atlas by the next call to build
+
+ @param name  Name the image region is looked up by
+ @param path  Path of the image file
+ @returns     False if the image could not be loaded
+ */
+bool Atlas::addImage(const std::string& name, const std::string& path)
+{
+    SDL_Surface* loaded = IMG_Load(path.c_str());
+
+    if (loaded == nullptr)
+    {
+        printf("Failed to load %s: %s\n", path.c_str(), IMG_GetError());
+        return false;
+    }
+
+    return addImage(name, loaded);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds an already decoded image to be packed into the atlas by the next call to build
+
+ @param name     Name the image region is looked up by
+ @param loaded   Decoded image, the atlas takes ownership of it
+ @returns        False if the image could not be added
+ */
+bool Atlas::addImage(const std::string& name, SDL_Surface* loaded)
+{
+    if (loaded == nullptr)
+    {
+        return false;
+    }
+
+    // Every page uses the same pixel format, so convert before packing
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+
+    if (surface == nullptr)
+    {
+        return false;
+    }
+
+    PendingImage image = {name, surface};
+    pending.push_back(image);
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates an empty page surface to pack images into
+
+ @param width   Width of the page
+ @param height  Height of the page
+ @returns       The new page surface
+ */
+SDL_Surface* Atlas::createPage(int width, int height)
+{
+    return SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Uploads a packed page surface as a texture and frees the surface
+
+ @param page  Page surface to upload
+ */
+void Atlas::finishPage(SDL_Surface* page)
+{
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, page);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    SDL_Point size = {page->w, page->h};
+    pageSizes.push_back(size);
+    pages.push_back(texture);
+
+    SDL_FreeSurface(page);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a page just large enough for the images placed on it, rounded up to a power of
+ two, copies them onto it and uploads it. Their regions are pointed at the page and the
+ images freed
+
+ @param images  Images placed on the page, their regions already hold where. Cleared
+                afterwards
+ @param width   Width the images reach across the page
+ @param height  Height the images reach down the page
+ */
+void Atlas::packPage(std::vector<PendingImage*>& images, int width, int height)
+{
+    SDL_Surface* page = createPage(std::min(roundUpToPowerOfTwo(width), pageSize),
+                                   std::min(roundUpToPowerOfTwo(height), pageSize));
+
+    for (PendingImage* image : images)
+    {
+        AtlasRegion& region = regions[image->name];
+        SDL_Rect rect = region.rect;
+
+        SDL_BlitSurface(image->surface, nullptr, page, &rect);
+        region.page = pages.size();
+
+        SDL_FreeSurface(image->surface);
+        image->surface = nullptr;
+    }
+
+    images.clear();
+    finishPage(page);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Packs every image added since the last build into pages. Images are placed tallest first
+ on shelves running left to right, a new shelf starts when a row is full and a new page
+ when a page is full. Pages only take up the room their shelves reach, and images larger
+ than a page get a page of their own
+
+ */
+void Atlas::build()
+{
+    std::sort(pending.begin(), pending.end(), [](const PendingImage& a, const PendingImage& b)
+    {
+        return a.surface->h > b.surface->h;
+    });
+
+    std::vector<PendingImage*> onPage;
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    int usedWidth = 0, usedHeight = 0;
+
+    for (PendingImage& image : pending)
+    {
+        SDL_Surface* surface = image.surface;
+        SDL_Rect rect = {0, 0, surface->w, surface->h};
+
+        // Copy pixels as they are, including alpha, rather than blending onto the page
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+
+        if (surface->w > pageSize || surface->h > pageSize)
+        {
+            SDL_Surface* ownPage = createPage(surface->w, surface->h);
+            SDL_BlitSurface(surface, nullptr, ownPage, &rect);
+
+            AtlasRegion region = {(int)pages.size(), rect};
+            regions[image.name] = region;
+
+            finishPage(ownPage);
+            SDL_FreeSurface(surface);
+            image.surface = nullptr;
+            continue;
+        }
+
+        // Start a new shelf when the image does not fit in what is left of this one
+        if (shelfX + surface->w > pageSize)
+        {
+            shelfX = 0;
+            shelfY += shelfHeight + ATLAS_PADDING;
+            shelfHeight = 0;
+        }
+
+        // Start a new page when the shelf does not fit on this one
+        if (!onPage.empty() && shelfY + surface->h > pageSize)
+        {
+            packPage(onPage, usedWidth, usedHeight);
+            shelfX = shelfY = shelfHeight = 0;
+            usedWidth = usedHeight = 0;
+        }
+
+        rect.x = shelfX;
+        rect.y = shelfY;
+
+        // The page index is only known once the page is uploaded, own pages for large
+        // images may be uploaded before it
+        AtlasRegion region = {-1, rect};
+        regions[image.name] = region;
+        onPage.push_back(&image);
+
+        usedWidth = std::max(usedWidth, shelfX + surface->w);
+        usedHeight = std::max(usedHeight, shelfY + surface->h);
+
+        shelfX += surface->w + ATLAS_PADDING;
+        shelfHeight = std::max(shelfHeight, surface->h);
+    }
+
+    if (!onPage.empty())
+    {
+        packPage(onPage, usedWidth, usedHeight);
+    }
+
+    pending.clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the rotation cache the pages are drawn through, so their rotated frames are dropped
+ when the pages are destroyed
+
+ @param rotations  Rotation cache, nullptr if there is none
+ */
+void Atlas::setRotationCache(RotationCache *rotations)
+{
+    this->rotations = rotations;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the page and rectangle an image was packed into
+
+ @param name  Name the image was added with
+ @returns     The region of the image, nullptr if no image has that name
+ */
+const AtlasRegion* Atlas::getRegion(const std::string& name) const
+{
+    auto region = regions.find(name);
+    return region != regions.end() ? &region->second : nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a page texture
+
+ @param page  Index of the page
+ @returns     Texture of the page
+ */
+SDL_Texture* Atlas::getPage(int page) const { return pages[page]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the width and height of a page texture
+
+ @param page  Index of the page
+ @returns     Width (x) and height (y) of the page
+ */
+const SDL_Point& Atlas::getPageSize(int page) const { return pageSizes[page]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of pages the atlas has built
+
+ @returns The number of pages
+ */
+int Atlas::getPageCount() const { return pages.size(); }
@@ -0,0 +1,61 @@
+#ifndef atlas_hpp
+#define atlas_hpp
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "rotationcache.hpp"
+
+
+struct AtlasRegion
+{
+    int page;
+    SDL_Rect rect;
+};
+
+
+class Atlas
+{
+private:
+    struct PendingImage
+    {
+        std::string name;
+        SDL_Surface* surface;
+    };
+
+    SDL_Renderer *renderer;
+    int pageSize;
+
+    std::vector<PendingImage> pending;
+    std::vector<SDL_Texture*> pages;
+    std::vector<SDL_Point> pageSizes;
+    std::map<std::string, AtlasRegion> regions;
+
+    // Rotated frames of the pages, dropped along with the pages
+    RotationCache *rotations = nullptr;
+
+    SDL_Surface* createPage(int width, int height);
+    void finishPage(SDL_Surface* page);
+    void packPage(std::vector<PendingImage*>& images, int width, int height);
+
+public:
+    Atlas(SDL_Renderer *renderer, int pageSize);
+    Atlas(SDL_Renderer *renderer);
+    ~Atlas();
+
+    bool addImage(const std::string& name, const std::string& path);
+    bool addImage(const std::string& name, SDL_Surface* surface);
+    void build();
+    void setRotationCache(RotationCache *rotations);
+
+    const AtlasRegion* getRegion(const std::string& name) const;
+    SDL_Texture* getPage(int page) const;
+    const SDL_Point& getPageSize(int page) const;
+    int getPageCount() const;
+};
+
+
+#endif /* atlas_hpp */
@@ -0,0 +1,100 @@
+#include "camera.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Constructs a camera at the world origin with no zoom, looking through the whole screen
+
+ @param SCREEN_WIDTH  Width of the screen
+ @param SCREEN_HEIGHT Height of the screen
+ */
+Camera::Camera(int SCREEN_WIDTH, int SCREEN_HEIGHT)
+{
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.w = SCREEN_WIDTH;
+    viewport.h = SCREEN_HEIGHT;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the world position shown at the top left of the viewport
+
+ @param position  World position
+ */
+void Camera::setPosition(const Vec2& position)
+{
+    this->position = position;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves the camera through the world
+
+ @param offset    World distance to move by
+ */
+void Camera::move(const Vec2& offset)
+{
+    position += offset;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves the camera so a world position is in the middle of the viewport
+
+ @param target    World position to center on
+ */
+void Camera::centerOn(const Vec2& target)
+{
+    position = target - getViewSize() * 0.5f;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the zoom, keeping the world position at the top left of the viewport where it is
+
+ @param zoom      Screen pixels per world unit, greater than 0
+ */
+void Camera::setZoom(float zoom)
+{
+    if (zoom > 0)
+    {
+        this->zoom = zoom;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the part of the screen the camera draws to
+
+ @param viewport  Rectangle on screen
+ */
+void Camera::setViewport(const SDL_Rect& viewport)
+{
+    this->viewport = viewport;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the camera settings
+
+ */
+Vec2 Camera::getPosition() const { return position; }
+float Camera::getZoom() const { return zoom; }
+const SDL_Rect& Camera::getViewport() const { return viewport; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the size of the part of the world in view
+
+ @returns Width and height of the view in world units
+ */
+Vec2 Camera::getViewSize() const
+{
+    return Vec2(viewport.w / zoom, viewport.h / zoom);
+}
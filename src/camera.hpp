@@ -0,0 +1,104 @@
+#ifndef camera_hpp
+#define camera_hpp
+
+#include <cmath>
+#include <SDL.h>
+#include "math2d.hpp"
+
+
+/**
+ View onto the world. The world point at position is drawn at the top left of the
+ viewport, and zoom is the number of screen pixels per world unit. Everything drawn in
+ world coordinates goes through a camera, which also tells what is in view so nothing
+ off screen is submitted to SDL. Drawing is not clipped to the viewport
+ */
+class Camera
+{
+private:
+    Vec2 position;
+    float zoom = 1;
+    SDL_Rect viewport;
+
+public:
+    Camera(int SCREEN_WIDTH, int SCREEN_HEIGHT);
+
+    void setPosition(const Vec2& position);
+    void move(const Vec2& offset);
+    void centerOn(const Vec2& target);
+    void setZoom(float zoom);
+    void setViewport(const SDL_Rect& viewport);
+
+    Vec2 getPosition() const;
+    float getZoom() const;
+    const SDL_Rect& getViewport() const;
+    Vec2 getViewSize() const;
+
+    /**
+     Converts a world position to a screen position
+
+     @param world  Position in the world
+     @returns      Position on screen
+     */
+    Vec2 worldToScreen(const Vec2& world) const
+    {
+        return Vec2(viewport.x + (world.x - position.x) * zoom, viewport.y + (world.y - position.y) * zoom);
+    }
+
+    /**
+     Converts a screen position to a world position
+
+     @param screen  Position on screen
+     @returns       Position in the world
+     */
+    Vec2 screenToWorld(const Vec2& screen) const
+    {
+        return Vec2(position.x + (screen.x - viewport.x) / zoom, position.y + (screen.y - viewport.y) / zoom);
+    }
+
+    /**
+     Converts a world rectangle to a screen rectangle. Both edges are rounded rather than
+     the size, so rectangles that touch in the world still touch on screen at any zoom
+
+     @param world  Rectangle in the world
+     @returns      Rectangle on screen
+     */
+    SDL_Rect worldToScreen(const SDL_Rect& world) const
+    {
+        const Vec2 topLeft = worldToScreen(Vec2(world.x, world.y));
+        const Vec2 bottomRight = worldToScreen(Vec2(world.x + world.w, world.y + world.h));
+
+        const int left = (int)floorf(topLeft.x + 0.5f);
+        const int top = (int)floorf(topLeft.y + 0.5f);
+
+        SDL_Rect screen = {left, top, (int)floorf(bottomRight.x + 0.5f) - left, (int)floorf(bottomRight.y + 0.5f) - top};
+        return screen;
+    }
+
+    /**
+     Checks whether a circle in the world is at least partly in view
+
+     @param center  Center of the circle in the world
+     @param radius  Radius of the circle in world units
+     @returns       False if the circle is entirely outside the view
+     */
+    bool isVisible(const Vec2& center, float radius) const
+    {
+        return center.x + radius >= position.x && center.x - radius <= position.x + viewport.w / zoom &&
+               center.y + radius >= position.y && center.y - radius <= position.y + viewport.h / zoom;
+    }
+
+    /**
+     Checks whether a rectangle in the world is at least partly in view
+
+     @param world  Rectangle in the world
+     @returns      False if the rectangle is entirely outside the view
+     */
+    bool isVisible(const SDL_Rect& world) const
+    {
+        return world.x + world.w >= position.x && world.x <= position.x + viewport.w / zoom &&
+               world.y + world.h >= position.y && world.y <= position.y + viewport.h / zoom;
+    }
+};
+
+
+#endif /* camera_hpp */
@@ -14,75 +14,431 @@ ColDet::ColDet(int SCREEN_WIDTH, int SCREEN_HEIGHT)
 
 
 /** --------------------------------------------------------------------------------------
- Wraps the particle around to the opposite edge of the screen when it collides with the
- edge of the screen.
+ Wraps a position around to the opposite edge of the screen when it goes past the edge of
+ the screen
 
- @param p             Particle on which to do collision detection
- @param midPoint      Midpoint of the particle for collision detection purposes, may not
+ @param position      Position, changed if it wraps
+ @param midPoint      Midpoint of the body for collision detection purposes, may not
                       always actually be the middle in certain cases
  */
-void ColDet::wrapScreen(Particle *p, const float& midPoint)
+void ColDet::wrapScreen(Vec2& position, float midPoint)
 {
     // If it goes off the left side of the screen bring it back on the right side
-    if (p->getPositionX() < (0 - midPoint))
+    if (position.x < (0 - midPoint))
     {
-        p->setPositionX(SCREEN_WIDTH + midPoint);
+        position.x = SCREEN_WIDTH + midPoint;
     }
     // If it goes off the right side of the screen bring it back on the left side
-    else if (p->getPositionX() > SCREEN_WIDTH + midPoint)
+    else if (position.x > SCREEN_WIDTH + midPoint)
     {
-        p->setPositionX(0 - midPoint);
+        position.x = 0 - midPoint;
     }
     // If it goes off the top of the screen bring it back on the bottom
-    else if (p->getPositionY() < (0 - midPoint))
+    else if (position.y < (0 - midPoint))
     {
-        p->setPositionY(SCREEN_HEIGHT + midPoint);
+        position.y = SCREEN_HEIGHT + midPoint;
     }
     // If it goes off the bottom of the screen bring it back on the top
-    else if (p->getPositionY() > SCREEN_HEIGHT + midPoint)
+    else if (position.y > SCREEN_HEIGHT + midPoint)
     {
-        p->setPositionY(0 - midPoint);
+        position.y = 0 - midPoint;
     }
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Bounces the particle on the edge of the screen when it collides with that edge
+ Bounces a position on the edge of the screen when it collides with that edge, reversing
+ the velocity towards that edge
 
- @param p             Particle on which to do collision detection
- @param midPoint      Midpoint of the particle for collision detection purposes, may not
+ @param position      Position, changed if it bounces
+ @param velocity      Velocity, reversed on the axis it bounces on
+ @param midPoint      Midpoint of the body for collision detection purposes, may not
                       always actually be the middle in certain cases
  */
-void ColDet::bounceScreen(Particle *p, const float& midPoint)
+void ColDet::bounceScreen(Vec2& position, Vec2& velocity, float midPoint)
 {
     // If it goes off left edge of the screen bring it back on the left edge of the screen
     // and kill its velocity
-    if (p->getPositionX() - midPoint < 0)
+    if (position.x - midPoint < 0)
     {
-        p->setPositionX(0 + midPoint);
-        p->setVelocityX(p->getVelocityX() * -1);
+        position.x = 0 + midPoint;
+        velocity.x *= -1;
     }
     // If it goes off right edge of the screen bring it back on the right edge of the
     // screen and kill its velocity
-    else if (p->getPositionX() + midPoint > SCREEN_WIDTH)
+    else if (position.x + midPoint > SCREEN_WIDTH)
     {
-        p->setPositionX(SCREEN_WIDTH - midPoint);
-        p->setVelocityX(p->getVelocityX() * -1);
+        position.x = SCREEN_WIDTH - midPoint;
+        velocity.x *= -1;
     }
 
     // If it goes off top edge of the screen bring it back on the top edge of the screen
     // and kill its velocity
-    if (p->getPositionY() - midPoint < 0)
+    if (position.y - midPoint < 0)
     {
-        p->setPositionY(0 + midPoint);
-        p->setVelocityY(p->getVelocityY() * -1);
+        position.y = 0 + midPoint;
+        velocity.y *= -1;
     }
     // If it goes off bottom edge of the screen bring it back on the bottom edge of the
     // bottom and kill its velocity
-    else if (p->getPositionY() + midPoint > SCREEN_HEIGHT)
+    else if (position.y + midPoint > SCREEN_HEIGHT)
+    {
+        position.y = SCREEN_HEIGHT - midPoint;
+        velocity.y *= -1;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Wraps a position held as separate components, as wrapScreen does for a vector
+
+ @param x             Horizontal position, changed if it wraps
+ @param y             Vertical position, changed if it wraps
+ @param midPoint      Midpoint of the body for collision detection purposes
+ */
+void ColDet::wrapScreen(float& x, float& y, const float& midPoint)
+{
+    Vec2 position(x, y);
+
+    wrapScreen(position, midPoint);
+
+    x = position.x;
+    y = position.y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces a position and velocity held as separate components, as bounceScreen does for
+ vectors
+
+ @param x             Horizontal position, changed if it bounces
+ @param y             Vertical position, changed if it bounces
+ @param velocityX     Horizontal velocity, reversed if it bounces on a side
+ @param velocityY     Vertical velocity, reversed if it bounces on the top or bottom
+ @param midPoint      Midpoint of the body for collision detection purposes
+ */
+void ColDet::bounceScreen(float& x, float& y, float& velocityX, float& velocityY, const float& midPoint)
+{
+    Vec2 position(x, y);
+    Vec2 velocity(velocityX, velocityY);
+
+    bounceScreen(position, velocity, midPoint);
+
+    x = position.x;
+    y = position.y;
+    velocityX = velocity.x;
+    velocityY = velocity.y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Wraps a fixed point position, as wrapScreen does for a float one, for bodies simulated in
+ deterministic mode
+
+ @param position      Position, changed if it wraps
+ @param midPoint      Midpoint of the body for collision detection purposes
+ */
+void ColDet::wrapScreen(FixedVec2& position, Fixed midPoint)
+{
+    const Fixed width = Fixed::fromInt(SCREEN_WIDTH);
+    const Fixed height = Fixed::fromInt(SCREEN_HEIGHT);
+
+    if (position.x < -midPoint)
+    {
+        position.x = width + midPoint;
+    }
+    else if (position.x > width + midPoint)
+    {
+        position.x = -midPoint;
+    }
+    else if (position.y < -midPoint)
+    {
+        position.y = height + midPoint;
+    }
+    else if (position.y > height + midPoint)
+    {
+        position.y = -midPoint;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces a fixed point position and velocity, as bounceScreen does for float ones, for
+ bodies simulated in deterministic mode
+
+ @param position      Position, changed if it bounces
+ @param velocity      Velocity, reversed on the axis it bounces on
+ @param midPoint      Midpoint of the body for collision detection purposes
+ */
+void ColDet::bounceScreen(FixedVec2& position, FixedVec2& velocity, Fixed midPoint)
+{
+    const Fixed width = Fixed::fromInt(SCREEN_WIDTH);
+    const Fixed height = Fixed::fromInt(SCREEN_HEIGHT);
+
+    if (position.x - midPoint < Fixed())
     {
-        p->setPositionY(SCREEN_HEIGHT - midPoint);
-        p->setVelocityY(p->getVelocityY() * -1);
+        position.x = midPoint;
+        velocity.x = -velocity.x;
     }
+    else if (position.x + midPoint > width)
+    {
+        position.x = width - midPoint;
+        velocity.x = -velocity.x;
+    }
+
+    if (position.y - midPoint < Fixed())
+    {
+        position.y = midPoint;
+        velocity.y = -velocity.y;
+    }
+    else if (position.y + midPoint > height)
+    {
+        position.y = height - midPoint;
+        velocity.y = -velocity.y;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Wraps the particle around to the opposite edge of the screen when it collides with the
+ edge of the screen.
+
+ @param p             Particle on which to do collision detection
+ @param midPoint      Midpoint of the particle for collision detection purposes, may not
+                      always actually be the middle in certain cases
+ */
+void ColDet::wrapScreen(Particle *p, const float& midPoint)
+{
+    Vec2 position = p->getPosition();
+
+    wrapScreen(position, midPoint);
+
+    p->setPosition(position);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces the particle on the edge of the screen when it collides with that edge
+
+ @param p             Particle on which to do collision detection
+ @param midPoint      Midpoint of the particle for collision detection purposes, may not
+                      always actually be the middle in certain cases
+ */
+void ColDet::bounceScreen(Particle *p, const float& midPoint)
+{
+    Vec2 position = p->getPosition();
+    Vec2 velocity = p->getVelocity();
+
+    bounceScreen(position, velocity, midPoint);
+
+    p->setPosition(position);
+    p->setVelocity(velocity);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Wraps every particle in a particle system around to the opposite edge of the screen, as
+ wrapScreen does for a single particle, using the radius of each particle as its midpoint
+
+ @param particles     Particle system on which to do collision detection
+ */
+void ColDet::wrapScreen(ParticleSystem *particles)
+{
+    if (particles->isDeterministic())
+    {
+        ParticleKernel::collide(particles->getArrays(), particles->getFixedArrays(), 0, particles->size(),
+                                ScreenCollision::Wrap, SCREEN_WIDTH, SCREEN_HEIGHT);
+        return;
+    }
+
+    ParticleKernel::collide(particles->getArrays(), 0, particles->size(), ScreenCollision::Wrap,
+                            SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces every particle in a particle system on the edges of the screen, as bounceScreen
+ does for a single particle, using the radius of each particle as its midpoint
+
+ @param particles     Particle system on which to do collision detection
+ */
+void ColDet::bounceScreen(ParticleSystem *particles)
+{
+    bounceScreen(particles, 0, particles->size());
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces the particles in a range of dense indices on the edges of the screen. Ranges that
+ do not overlap can be bounced on different threads at the same time
+
+ @param particles     Particle system on which to do collision detection
+ @param begin         First dense index to bounce
+ @param end           One past the last dense index to bounce
+ */
+void ColDet::bounceScreen(ParticleSystem *particles, int begin, int end)
+{
+    if (particles->isDeterministic())
+    {
+        ParticleKernel::collide(particles->getArrays(), particles->getFixedArrays(), begin, end,
+                                ScreenCollision::Bounce, SCREEN_WIDTH, SCREEN_HEIGHT);
+        return;
+    }
+
+    ParticleKernel::collide(particles->getArrays(), begin, end, ScreenCollision::Bounce,
+                            SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the size of the broad phase grid cells. Cells must be at least twice the largest
+ midpoint of any particle so touching particles are always in the same or neighbouring
+ cells. Changing the size refiles every particle on the next grid update
+
+ @param cellSize      Width and height of a grid cell
+ */
+void ColDet::setCellSize(float cellSize)
+{
+    grid.setCellSize(cellSize);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Brings the broad phase grid up to date with the positions of the particles. Only the
+ particles that moved into another cell since the last update, were added or were removed
+ are refiled, so the cost is one cell key per particle plus the moves
+
+ @param particles     Particle system to build the grid from
+ */
+void ColDet::updateGrid(ParticleSystem *particles)
+{
+    const int count = particles->size();
+    const float* x = particles->getPositionsX();
+    const float* y = particles->getPositionsY();
+
+    grid.beginUpdate();
+
+    for (int i = 0; i < count; i++)
+    {
+        grid.update(particles->getId(i), x[i], y[i]);
+    }
+
+    // Anything still filed but not seen this update has been removed from the system
+    grid.endUpdate();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the broad phase grid of particle ids, as of the last call to updateGrid
+
+ @returns The grid
+ */
+const SpatialGrid& ColDet::getGrid() const { return grid; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the broad phase grid of entity indices, filed by the collision system
+
+ @returns The grid
+ */
+SpatialGrid& ColDet::getEntityGrid() { return entityGrid; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds candidate pairs of particles that may be touching, using the grid from the last
+ call to updateGrid. Each pair of particles in the same cell or in neighbouring cells is
+ reported once
+
+ @returns             Pairs of particle ids that may be colliding
+ */
+const std::vector<std::pair<int, int>>& ColDet::findPairs()
+{
+    grid.findPairs(pairs);
+
+    return pairs;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Updates the grid and returns the pairs of particles that are actually touching, treating
+ each particle as a circle with its radius as the midpoint
+
+ @param particles     Particle system on which to do collision detection
+ @returns             Pairs of particle ids that are colliding
+ */
+const std::vector<std::pair<int, int>>& ColDet::findCollisions(ParticleSystem *particles)
+{
+    updateGrid(particles);
+    findPairs();
+
+    ParticleArrays p = particles->getArrays();
+    size_t kept = 0;
+
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        int a = particles->getIndex(pairs[i].first);
+        int b = particles->getIndex(pairs[i].second);
+
+        if (circles(Vec2(p.x[a], p.y[a]), p.radius[a], Vec2(p.x[b], p.y[b]), p.radius[b]))
+        {
+            pairs[kept++] = pairs[i];
+        }
+    }
+
+    pairs.resize(kept);
+
+    return pairs;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether two circles overlap, comparing squared distances so no square root is
+ taken
+
+ @param center1       Center of the first circle
+ @param midPoint1     Midpoint (radius) of the first circle
+ @param center2       Center of the second circle
+ @param midPoint2     Midpoint (radius) of the second circle
+ @returns             True if the circles touch or overlap
+ */
+bool ColDet::circles(const Vec2& center1, float midPoint1, const Vec2& center2, float midPoint2)
+{
+    float reach = midPoint1 + midPoint2;
+
+    return distanceSquared(center1, center2) <= reach * reach;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether two circles overlap
+
+ @param x1            Horizontal position of the first circle
+ @param y1            Vertical position of the first circle
+ @param midPoint1     Midpoint (radius) of the first circle
+ @param x2            Horizontal position of the second circle
+ @param y2            Vertical position of the second circle
+ @param midPoint2     Midpoint (radius) of the second circle
+ @returns             True if the circles touch or overlap
+ */
+bool ColDet::circles(float x1, float y1, const float& midPoint1, float x2, float y2, const float& midPoint2)
+{
+    return circles(Vec2(x1, y1), midPoint1, Vec2(x2, y2), midPoint2);
 }
@@ -3,7 +3,15 @@
 
 #include <SDL.h>
 #include <stdio.h>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "math2d.hpp"
+#include "fixed.hpp"
 #include "particle.hpp"
+#include "particlesystem.hpp"
+#include "spatialgrid.hpp"
 
 
 class ColDet {
@@ -11,12 +19,42 @@ class ColDet {
 private:
     int SCREEN_WIDTH, SCREEN_HEIGHT;
 
+    // Broad phase uniform grids of particle ids and of entity indices, keyed by the cell
+    // their center lies in. Drawing culls entities against the entity grid too
+    SpatialGrid grid{64};
+    SpatialGrid entityGrid{64};
+
+    std::vector<std::pair<int, int>> pairs;
+
 public:
     ColDet();
     ColDet(int SCREEN_WIDTH, int SCREEN_HEIGHT);
 
+    void wrapScreen(Vec2& position, float midPoint);
+    void bounceScreen(Vec2& position, Vec2& velocity, float midPoint);
+
+    void wrapScreen(float& x, float& y, const float& midPoint);
+    void bounceScreen(float& x, float& y, float& velocityX, float& velocityY, const float& midPoint);
+
+    void wrapScreen(FixedVec2& position, Fixed midPoint);
+    void bounceScreen(FixedVec2& position, FixedVec2& velocity, Fixed midPoint);
+
     void wrapScreen(Particle *p, const float& midPoint);
     void bounceScreen(Particle *p, const float& midPoint);
+
+    void wrapScreen(ParticleSystem *particles);
+    void bounceScreen(ParticleSystem *particles);
+    void bounceScreen(ParticleSystem *particles, int begin, int end);
+
+    void setCellSize(float cellSize);
+    void updateGrid(ParticleSystem *particles);
+    const SpatialGrid& getGrid() const;
+    SpatialGrid& getEntityGrid();
+    const std::vector<std::pair<int, int>>& findPairs();
+    const std::vector<std::pair<int, int>>& findCollisions(ParticleSystem *particles);
+
+    static bool circles(const Vec2& center1, float midPoint1, const Vec2& center2, float midPoint2);
+    static bool circles(float x1, float y1, const float& midPoint1, float x2, float y2, const float& midPoint2);
 };
 
 
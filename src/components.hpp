@@ -0,0 +1,64 @@
+#ifndef components_hpp
+#define components_hpp
+
+#include "texture.hpp"
+#include "fixed.hpp"
+
+/**
+ Plain data components entities are made of. Each archetype in the registry stores every
+ component type it has in its own packed array
+ */
+
+enum ComponentType
+{
+    TRANSFORM = 1 << 0,
+    VELOCITY  = 1 << 1,
+    SPRITE    = 1 << 2,
+    COLLIDER  = 1 << 3,
+    LIFETIME  = 1 << 4,
+    BODY      = 1 << 5
+};
+
+
+struct Transform
+{
+    float x, y, angle;
+};
+
+
+struct Velocity
+{
+    float x, y, friction, gravity;
+};
+
+
+struct Sprite
+{
+    Texture* texture;
+};
+
+
+struct Collider
+{
+    float midPoint;
+    bool wrap;
+};
+
+
+struct Lifetime
+{
+    float remaining;
+};
+
+
+/**
+ Fixed point position and velocity of an entity simulated in deterministic mode. Its
+ Transform and Velocity then hold a float copy of them for drawing
+ */
+struct Body
+{
+    Fixed x, y, velocityX, velocityY;
+};
+
+
+#endif /* components_hpp */
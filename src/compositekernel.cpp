@@ -0,0 +1,396 @@
+#include "compositekernel.hpp"
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define COMPOSITE_X86
+  #include <immintrin.h>
+#endif
+
+// As in the particle kernel, the SSE2 and AVX2 paths are compiled for their own functions
+// only so the rest of the game still runs on CPUs without them
+#if defined(COMPOSITE_X86) && (defined(__GNUC__) || defined(__clang__))
+  #define COMPOSITE_TARGET_SSE2 __attribute__((target("sse2")))
+  #define COMPOSITE_TARGET_AVX2 __attribute__((target("avx2")))
+  #define COMPOSITE_HAVE_AVX2
+#elif defined(COMPOSITE_X86) && defined(_MSC_VER)
+  #define COMPOSITE_TARGET_SSE2
+  #define COMPOSITE_TARGET_AVX2
+  #define COMPOSITE_HAVE_AVX2
+#endif
+
+
+namespace
+{
+
+/** --------------------------------------------------------------------------------------
+ Scalar reference path. Each channel becomes source + destination * (255 - source alpha)
+ / 255, the division rounded to nearest with the usual add and shift in place of dividing
+ */
+inline Uint32 divide255(Uint32 value)
+{
+    value += 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+
+inline Uint32 blendScalar(Uint32 destination, Uint32 source)
+{
+    const Uint32 inverse = 255 - (source >> 24);
+
+    if (inverse == 0)
+    {
+        return source;
+    }
+
+    Uint32 result = 0;
+
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        const Uint32 channel = ((source >> shift) & 0xFF) + divide255(((destination >> shift) & 0xFF) * inverse);
+        result |= std::min(channel, 255u) << shift;
+    }
+
+    return result;
+}
+
+
+void blendRowScalar(Uint32* destination, const Uint32* source, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (source[i] != 0)
+        {
+            destination[i] = blendScalar(destination[i], source[i]);
+        }
+    }
+}
+
+
+#ifdef COMPOSITE_X86
+
+/** --------------------------------------------------------------------------------------
+ SSE2 path, four pixels per iteration. Channels are widened to 16 bits, two pixels to a
+ register, with each pixel's inverse alpha copied across its four channels. Runs of fully
+ opaque or fully transparent source pixels skip the arithmetic
+ */
+COMPOSITE_TARGET_SSE2
+inline __m128i blendHalfSSE2(__m128i destination, __m128i source, __m128i c255, __m128i c128)
+{
+    const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)),
+                                              _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m128i value = _mm_add_epi16(_mm_mullo_epi16(destination, _mm_sub_epi16(c255, alpha)), c128);
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+
+COMPOSITE_TARGET_SSE2
+void blendRowSSE2(Uint32* destination, const Uint32* source, int begin, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(255);
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+
+    int i = begin;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128i s = _mm_loadu_si128((const __m128i*)(source + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xFFFF)
+        {
+            continue;
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(s, 24), opaque)) == 0xFFFF)
+        {
+            _mm_storeu_si128((__m128i*)(destination + i), s);
+            continue;
+        }
+
+        const __m128i d = _mm_loadu_si128((const __m128i*)(destination + i));
+
+        const __m128i low = blendHalfSSE2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), c255, c128);
+        const __m128i high = blendHalfSSE2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), c255, c128);
+
+        _mm_storeu_si128((__m128i*)(destination + i), _mm_adds_epu8(s, _mm_packus_epi16(low, high)));
+    }
+
+    blendRowScalar(destination, source, i, end);
+}
+
+#endif
+
+
+#ifdef COMPOSITE_HAVE_AVX2
+
+/** --------------------------------------------------------------------------------------
+ AVX2 path, eight pixels per iteration. Unpacking and packing work within each 128 bit
+ half, so the pixels come back out in the order they went in
+ */
+COMPOSITE_TARGET_AVX2
+inline __m256i blendHalfAVX2(__m256i destination, __m256i source, __m256i c255, __m256i c128)
+{
+    const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3)),
+                                                 _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m256i value = _mm256_add_epi16(_mm256_mullo_epi16(destination, _mm256_sub_epi16(c255, alpha)), c128);
+    return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+}
+
+
+COMPOSITE_TARGET_AVX2
+void blendRowAVX2(Uint32* destination, const Uint32* source, int begin, int end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(255);
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i c128 = _mm256_set1_epi16(128);
+
+    int i = begin;
+
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(source + i));
+
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(s, zero)) == -1)
+        {
+            continue;
+        }
+
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_srli_epi32(s, 24), opaque)) == -1)
+        {
+            _mm256_storeu_si256((__m256i*)(destination + i), s);
+            continue;
+        }
+
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(destination + i));
+
+        const __m256i low = blendHalfAVX2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), c255, c128);
+        const __m256i high = blendHalfAVX2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), c255, c128);
+
+        _mm256_storeu_si256((__m256i*)(destination + i), _mm256_adds_epu8(s, _mm256_packus_epi16(low, high)));
+    }
+
+    blendRowScalar(destination, source, i, end);
+}
+
+#endif
+
+
+CompositeKernel::Path detectPath()
+{
+#ifdef COMPOSITE_HAVE_AVX2
+    if (SDL_HasAVX2())
+    {
+        return CompositeKernel::AVX2;
+    }
+#endif
+#ifdef COMPOSITE_X86
+    if (SDL_HasSSE2())
+    {
+        return CompositeKernel::SSE2;
+    }
+#endif
+    return CompositeKernel::Scalar;
+}
+
+
+CompositeKernel::Path currentPath = detectPath();
+
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the path the kernel currently runs on
+
+ @returns The active kernel path
+ */
+CompositeKernel::Path CompositeKernel::getPath() { return currentPath; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Forces the kernel onto a path, to measure or check one path against another. Asking for
+ a path the CPU does not support falls back to the best supported path below it
+
+ @param path  Path to run on
+ */
+void CompositeKernel::setPath(Path path)
+{
+    Path supported = detectPath();
+    currentPath = path < supported ? path : supported;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a human readable name of the active path
+
+ @returns "scalar", "sse2" or "avx2"
+ */
+const char* CompositeKernel::getPathName()
+{
+    switch (currentPath)
+    {
+        case AVX2: return "avx2";
+        case SSE2: return "sse2";
+        default:   return "scalar";
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Blends the same rows of pixels on every path the CPU supports and compares each with the
+ scalar path. Every alpha from fully clear to opaque comes up. The count is best left odd
+ so the scalar tail of the vector paths is checked too. The kernel is left on the path it
+ was on
+
+ @param count  Number of pixels to blend
+ @returns      True if every path matched the scalar path exactly
+ */
+bool CompositeKernel::checkPaths(int count)
+{
+    const Path previous = currentPath;
+    const Path supported = detectPath();
+
+    // Small linear congruential generator, the same pixels on every platform
+    unsigned int seed = 12345;
+    std::vector<Uint32> source(count), background(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        source[i] = (seed & 0x00FFFFFF) | (Uint32)(i % 256) << 24;
+
+        seed = seed * 1664525u + 1013904223u;
+        background[i] = seed;
+    }
+
+    premultiply(source.data(), count);
+    premultiply(background.data(), count);
+
+    std::vector<Uint32> scalar;
+    bool passed = true;
+
+    for (int path = Scalar; path <= supported; path++)
+    {
+        std::vector<Uint32> destination(background);
+
+        currentPath = (Path)path;
+        blend(destination.data(), source.data(), count);
+
+        if (path == Scalar)
+        {
+            scalar.swap(destination);
+            continue;
+        }
+
+        int differing = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            differing += destination[i] != scalar[i];
+        }
+
+        printf("Composite kernel %s: %d of %d pixels differ from scalar\n", getPathName(), differing, count);
+
+        passed = passed && differing == 0;
+    }
+
+    currentPath = previous;
+    return passed;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws a row of premultiplied pixels over a row of premultiplied pixels
+
+ @param destination  Pixels drawn over, and set to the result
+ @param source       Pixels to draw, with premultiplied alpha
+ @param count        Number of pixels in the rows
+ */
+void CompositeKernel::blend(Uint32* destination, const Uint32* source, int count)
+{
+    switch (currentPath)
+    {
+#ifdef COMPOSITE_HAVE_AVX2
+        case AVX2:
+            blendRowAVX2(destination, source, 0, count);
+            break;
+#endif
+#ifdef COMPOSITE_X86
+        case SSE2:
+            blendRowSSE2(destination, source, 0, count);
+            break;
+#endif
+        default:
+            blendRowScalar(destination, source, 0, count);
+            break;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Multiplies the color of each pixel by its alpha, images are premultiplied once when
+ loaded so blending them needs no division
+
+ @param pixels  Pixels to premultiply in place
+ @param count   Number of pixels
+ */
+void CompositeKernel::premultiply(Uint32* pixels, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const Uint32 alpha = pixels[i] >> 24;
+        Uint32 result = alpha << 24;
+
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            result |= divide255(((pixels[i] >> shift) & 0xFF) * alpha) << shift;
+        }
+
+        pixels[i] = result;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Divides the color of each pixel by its alpha, for handing a composite that is not opaque
+ to a renderer that blends plain alpha. Only needed when the bottom layer has see through
+ pixels, so it is left scalar
+
+ @param pixels  Pixels to convert in place
+ @param count   Number of pixels
+ */
+void CompositeKernel::unpremultiply(Uint32* pixels, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const Uint32 alpha = pixels[i] >> 24;
+
+        if (alpha == 255)
+        {
+            continue;
+        }
+
+        Uint32 result = alpha << 24;
+
+        for (int shift = 0; shift < 24 && alpha > 0; shift += 8)
+        {
+            const Uint32 channel = (((pixels[i] >> shift) & 0xFF) * 255 + alpha / 2) / alpha;
+            result |= std::min(channel, 255u) << shift;
+        }
+
+        pixels[i] = result;
+    }
+}
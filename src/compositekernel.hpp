@@ -0,0 +1,35 @@
+#ifndef compositekernel_hpp
+#define compositekernel_hpp
+
+/**
+ Blending of rows of ARGB8888 pixels with premultiplied alpha, for compositing layers on
+ the CPU. The work is done by a scalar, an SSE2 or an AVX2 path, the fastest one the CPU
+ supports is picked at runtime. Every path rounds the same way, so results match the
+ scalar path exactly
+ */
+
+#include <SDL.h>
+
+
+class CompositeKernel
+{
+public:
+    enum Path
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    static Path getPath();
+    static void setPath(Path path);
+    static const char* getPathName();
+    static bool checkPaths(int count);
+
+    static void blend(Uint32* destination, const Uint32* source, int count);
+    static void premultiply(Uint32* pixels, int count);
+    static void unpremultiply(Uint32* pixels, int count);
+};
+
+
+#endif /* compositekernel_hpp */
@@ -0,0 +1,337 @@
+#include "fixed.hpp"
+
+// Sine table entries per quarter turn, the table holds one more for the end of the quarter
+#define FIXED_SINE_ENTRIES 1024
+
+// Pi / 2 with 30 fractional bits
+#define FIXED_HALF_PI_Q30 1686629713LL
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the integer square root of a 64 bit value, bit by bit so it is exact everywhere
+
+ @param value  Value to take the square root of
+ @returns      Largest integer whose square is at most value
+ */
+static uint64_t isqrt64(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+
+
+/**
+ Sine of a quarter turn with 30 fractional bits. It is built once with integer arithmetic
+ from the Taylor series rather than with sinf, whose last bits vary between libms, so
+ every machine builds the same table
+ */
+struct SineTable
+{
+    int32_t values[FIXED_SINE_ENTRIES + 1];
+
+    SineTable()
+    {
+        for (int i = 0; i <= FIXED_SINE_ENTRIES; i++)
+        {
+            const int64_t x = FIXED_HALF_PI_Q30 * i / FIXED_SINE_ENTRIES;
+            int64_t sum = x;
+            int64_t term = x;
+
+            // Terms to x^17 take the series well below the last bit at pi / 2
+            for (int n = 1; n <= 8; n++)
+            {
+                term = ((term * x) >> 30) * x >> 30;
+                term /= (2 * n) * (2 * n + 1);
+                sum += n % 2 == 1 ? -term : term;
+            }
+
+            values[i] = (int32_t)sum;
+        }
+    }
+};
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the sine of an angle within the first quarter turn from the table, interpolated
+ between entries
+
+ @param angle  Angle from 0 to a quarter turn, 16384
+ @returns      Sine with 30 fractional bits
+ */
+static int64_t quarterSine(int angle)
+{
+    static const SineTable table;
+
+    const int index = angle >> 4;
+    const int fraction = angle & 15;
+
+    int64_t value = table.values[index];
+
+    if (fraction != 0)
+    {
+        value += (table.values[index + 1] - value) * fraction / 16;
+    }
+
+    return value;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Converts an angle in radians to 65536ths of a turn, truncating. A single float multiply
+ and conversion, so the same float gives the same angle everywhere
+
+ @param radians  Angle in radians
+ @returns        The angle wrapped to a whole turn
+ */
+FixedAngle fixedAngleFromRadians(float radians)
+{
+    return (FixedAngle)(int32_t)(radians * (FIXED_ANGLE_TURN / (2 * (float)M_PI)));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the sine of an angle from the quarter turn table
+
+ @param angle  Angle in 65536ths of a turn
+ @returns      Sine of the angle
+ */
+Fixed fixedSin(FixedAngle angle)
+{
+    const int quarter = FIXED_ANGLE_TURN / 4;
+    const int within = angle % quarter;
+    int64_t sine;
+
+    switch (angle / quarter)
+    {
+        case 0:  sine = quarterSine(within);            break;
+        case 1:  sine = quarterSine(quarter - within);  break;
+        case 2:  sine = -quarterSine(within);           break;
+        default: sine = -quarterSine(quarter - within); break;
+    }
+
+    // Round from 30 to 16 fractional bits
+    return Fixed::fromRaw((int32_t)((sine + (1 << 13)) >> 14));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the cosine of an angle, the sine a quarter turn on
+
+ @param angle  Angle in 65536ths of a turn
+ @returns      Cosine of the angle
+ */
+Fixed fixedCos(FixedAngle angle)
+{
+    return fixedSin((FixedAngle)(angle + FIXED_ANGLE_TURN / 4));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the square root of a value, rounded down to the nearest 1 / 65536
+
+ @param value  Value to take the square root of
+ @returns      The square root, 0 for values of 0 or less
+ */
+Fixed fixedSqrt(Fixed value)
+{
+    if (value.raw <= 0)
+    {
+        return Fixed();
+    }
+
+    return Fixed::fromRaw((int32_t)isqrt64((uint64_t)value.raw << FIXED_SHIFT));
+}
+
+
+
+// Fractional bits the logarithm and power of fixedPow are worked out with, friction close
+// to 1 has a logarithm close to 0 which needs more than 16 to keep its precision
+#define FIXED_LOG_SHIFT 30
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the base 2 logarithm of a positive value, an integer part from normalising the value
+ to between 1 and 2 and then one fractional bit per squaring
+
+ @param raw  Raw value, greater than 0
+ @returns    Logarithm with FIXED_LOG_SHIFT fractional bits
+ */
+static int64_t log2Raw(int32_t raw)
+{
+    uint64_t y = (uint64_t)raw << (FIXED_LOG_SHIFT - FIXED_SHIFT);
+    int64_t integer = 0;
+
+    while (y >= (2ULL << FIXED_LOG_SHIFT))
+    {
+        y >>= 1;
+        integer++;
+    }
+
+    while (y < (1ULL << FIXED_LOG_SHIFT))
+    {
+        y <<= 1;
+        integer--;
+    }
+
+    int64_t fraction = 0;
+
+    for (int bit = FIXED_LOG_SHIFT - 1; bit >= 0; bit--)
+    {
+        y = (y * y) >> FIXED_LOG_SHIFT;
+
+        if (y >= (2ULL << FIXED_LOG_SHIFT))
+        {
+            y >>= 1;
+            fraction |= 1LL << bit;
+        }
+    }
+
+    return integer * (1LL << FIXED_LOG_SHIFT) + fraction;
+}
+
+
+
+/**
+ 2 ^ (1 / 2), 2 ^ (1 / 4) and so on, one root per fractional bit of the logarithm, with
+ FIXED_LOG_SHIFT fractional bits. Each is the integer square root of the one before
+ */
+struct RootTable
+{
+    uint64_t values[FIXED_LOG_SHIFT];
+
+    RootTable()
+    {
+        uint64_t root = 2ULL << FIXED_LOG_SHIFT;
+
+        for (int i = 0; i < FIXED_LOG_SHIFT; i++)
+        {
+            root = isqrt64(root << FIXED_LOG_SHIFT);
+            values[i] = root;
+        }
+    }
+};
+
+
+/** --------------------------------------------------------------------------------------
+ Raises 2 to a power, multiplying together the roots of 2 for each fractional bit and
+ shifting for the integer part
+
+ @param power  Exponent with FIXED_LOG_SHIFT fractional bits
+ @returns      Raw result, 0 when it is too small to hold
+ */
+static int32_t exp2Raw(int64_t power)
+{
+    static const RootTable roots;
+
+    // Split into the integer part rounded down and a fraction from 0 to 1
+    const int64_t fraction = power & ((1LL << FIXED_LOG_SHIFT) - 1);
+    const int64_t integer = (power - fraction) / (1LL << FIXED_LOG_SHIFT);
+
+    uint64_t result = 1ULL << FIXED_LOG_SHIFT;
+
+    for (int bit = FIXED_LOG_SHIFT - 1; bit >= 0; bit--)
+    {
+        if (fraction & (1LL << bit))
+        {
+            result = (result * roots.values[FIXED_LOG_SHIFT - 1 - bit]) >> FIXED_LOG_SHIFT;
+        }
+    }
+
+    // Round to 16 fractional bits, then shift by the integer part
+    const int64_t shift = FIXED_LOG_SHIFT - FIXED_SHIFT - integer;
+
+    if (shift >= 63)
+    {
+        return 0;
+    }
+
+    if (shift > 0)
+    {
+        return (int32_t)((result + (1ULL << (shift - 1))) >> shift);
+    }
+
+    return (int32_t)(result << -shift);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Raises a value to a power, used to compound per frame friction over a tick that is not
+ one frame long. An exponent of 1 gives the base back exactly
+
+ @param base      Value to raise, greater than 0
+ @param exponent  Power to raise it to
+ @returns         base ^ exponent, 0 for a base of 0 or less
+ */
+Fixed fixedPow(Fixed base, Fixed exponent)
+{
+    if (base.raw <= 0)
+    {
+        return Fixed();
+    }
+
+    if (exponent == Fixed::fromInt(1))
+    {
+        return base;
+    }
+
+    return Fixed::fromRaw(exp2Raw((log2Raw(base.raw) * exponent.raw) >> FIXED_SHIFT));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the length of the vector, rounded down to the nearest 1 / 65536
+
+ @returns The length
+ */
+Fixed FixedVec2::length() const
+{
+    return Fixed::fromRaw((int32_t)isqrt64((uint64_t)lengthSquaredRaw()));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a vector of length 1 pointing the same way
+
+ @returns The unit vector, the zero vector stays zero
+ */
+FixedVec2 FixedVec2::normalized() const
+{
+    const Fixed l = length();
+
+    if (l.raw == 0)
+    {
+        return *this;
+    }
+
+    return FixedVec2(x / l, y / l);
+}
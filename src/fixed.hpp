@@ -0,0 +1,130 @@
+#ifndef fixed_hpp
+#define fixed_hpp
+
+#include <cstdint>
+#include "math2d.hpp"
+
+/**
+ Number of fractional bits in a Fixed and the steps in a full turn of a FixedAngle
+ */
+#define FIXED_SHIFT 16
+#define FIXED_ANGLE_TURN 65536
+
+
+/**
+ Signed Q16.16 fixed point value, 16 integer bits and 16 fractional bits held in one 32
+ bit integer. Everything done with it is integer arithmetic, so the same operations give
+ the same bits with any compiler, optimisation level or CPU, unlike float where fused
+ multiply-add, extended precision and libm all vary. Multiplication rounds towards
+ negative infinity and division towards zero. Floats only come in through fromFloat,
+ which is exact for the same float on every machine, and go out through toFloat for
+ drawing
+ */
+struct Fixed
+{
+    int32_t raw;
+
+    constexpr Fixed() : raw(0) {}
+
+    static constexpr Fixed fromRaw(int32_t raw) { return Fixed(raw, 0); }
+    static constexpr Fixed fromInt(int value) { return Fixed(value * (1 << FIXED_SHIFT), 0); }
+
+    /**
+     Converts a float, truncating towards zero to the nearest 1 / 65536
+
+     @param value  Value within the range of 16 integer bits
+     @returns      The fixed point value
+     */
+    static Fixed fromFloat(float value) { return fromRaw((int32_t)(value * (float)(1 << FIXED_SHIFT))); }
+
+    float toFloat() const { return raw * (1.0f / (1 << FIXED_SHIFT)); }
+
+    constexpr Fixed operator+(Fixed f) const { return fromRaw(raw + f.raw); }
+    constexpr Fixed operator-(Fixed f) const { return fromRaw(raw - f.raw); }
+    constexpr Fixed operator-() const { return fromRaw(-raw); }
+
+    Fixed operator*(Fixed f) const { return fromRaw((int32_t)(((int64_t)raw * f.raw) >> FIXED_SHIFT)); }
+    Fixed operator/(Fixed f) const { return fromRaw((int32_t)(((int64_t)raw * (1 << FIXED_SHIFT)) / f.raw)); }
+
+    Fixed& operator+=(Fixed f) { raw += f.raw; return *this; }
+    Fixed& operator-=(Fixed f) { raw -= f.raw; return *this; }
+    Fixed& operator*=(Fixed f) { return *this = *this * f; }
+
+    constexpr bool operator==(Fixed f) const { return raw == f.raw; }
+    constexpr bool operator!=(Fixed f) const { return raw != f.raw; }
+    constexpr bool operator<(Fixed f) const { return raw < f.raw; }
+    constexpr bool operator>(Fixed f) const { return raw > f.raw; }
+    constexpr bool operator<=(Fixed f) const { return raw <= f.raw; }
+    constexpr bool operator>=(Fixed f) const { return raw >= f.raw; }
+
+private:
+    constexpr Fixed(int32_t raw, int) : raw(raw) {}
+};
+
+
+/**
+ Angle in 65536ths of a turn, wrapping around by itself. 0 is right and a quarter turn,
+ 16384, is down
+ */
+typedef uint16_t FixedAngle;
+
+FixedAngle fixedAngleFromRadians(float radians);
+Fixed fixedSin(FixedAngle angle);
+Fixed fixedCos(FixedAngle angle);
+Fixed fixedSqrt(Fixed value);
+Fixed fixedPow(Fixed base, Fixed exponent);
+
+
+/**
+ Two component fixed point vector, the deterministic counterpart of Vec2
+ */
+struct FixedVec2
+{
+    Fixed x, y;
+
+    constexpr FixedVec2() : x(), y() {}
+    constexpr FixedVec2(Fixed x, Fixed y) : x(x), y(y) {}
+
+    /**
+     Makes a unit vector pointing along an angle, looked up in the sine table
+
+     @param angle  Angle in 65536ths of a turn
+     @returns      Vector of length 1 at that angle
+     */
+    static FixedVec2 fromAngle(FixedAngle angle) { return FixedVec2(fixedCos(angle), fixedSin(angle)); }
+
+    static FixedVec2 fromVec2(const Vec2& v) { return FixedVec2(Fixed::fromFloat(v.x), Fixed::fromFloat(v.y)); }
+    Vec2 toVec2() const { return Vec2(x.toFloat(), y.toFloat()); }
+
+    FixedVec2 operator+(const FixedVec2& v) const { return FixedVec2(x + v.x, y + v.y); }
+    FixedVec2 operator-(const FixedVec2& v) const { return FixedVec2(x - v.x, y - v.y); }
+    FixedVec2 operator*(Fixed s) const { return FixedVec2(x * s, y * s); }
+
+    bool operator==(const FixedVec2& v) const { return x == v.x && y == v.y; }
+    bool operator!=(const FixedVec2& v) const { return !(*this == v); }
+
+    /**
+     Gets the squared length in Q32.32, which does not overflow for any vector
+
+     @returns Raw squared length with 32 fractional bits
+     */
+    int64_t lengthSquaredRaw() const { return (int64_t)x.raw * x.raw + (int64_t)y.raw * y.raw; }
+
+    Fixed length() const;
+
+    /**
+     Rotates the vector by the angle of a unit vector, as Vec2::rotated does
+
+     @param rotation  Unit vector at the angle to rotate by
+     @returns         The rotated vector
+     */
+    FixedVec2 rotated(const FixedVec2& rotation) const
+    {
+        return FixedVec2(x * rotation.x - y * rotation.y, x * rotation.y + y * rotation.x);
+    }
+
+    FixedVec2 normalized() const;
+};
+
+
+#endif /* fixed_hpp */
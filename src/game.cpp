@@ -1,11 +1,22 @@
 #include "game.hpp"
 
+#include <cstring>
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <sys/resource.h>
+#endif
+
 /** --------------------------------------------------------------------------------------
  Consructs a new game object and then calls the game loop function. In this case the game
  object consists of a collision detection object, a background layer with 2 textures and
- a foreground layer with 1 texture
+ a foreground layer with 1 texture. The images are decoded in the background while the
+ game shows a loading screen, or uploaded straight from the asset archive if there is one
 
- @param renderer      SDL2 render object to pass to constructors which require an instance
+ @param renderer      SDL2 render object to pass to constructors which require an instance,
+                      nullptr for a headless game that simulates without drawing
  @param SCREEN_WIDTH  Width of the game screen
  @param SCREEN_HEIGHT Height of the game screen
  */
@@ -13,146 +24,1779 @@ Game::Game(SDL_Renderer* renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT)
   : renderer(renderer), SCREEN_WIDTH(SCREEN_WIDTH), SCREEN_HEIGHT(SCREEN_HEIGHT)
 {
     colDet = new ColDet(SCREEN_WIDTH, SCREEN_HEIGHT);
+    camera = new Camera(SCREEN_WIDTH, SCREEN_HEIGHT);
+    particles = new ParticleSystem();
+    textureCache = new TextureCache(renderer);
+
+    background = nullptr;
+    foreground = nullptr;
+    tiles = nullptr;
+    ship = nullptr;
+    shipTexture = nullptr;
+    shipHandle.index = shipTextureHandle.index = -1;
+    shipHandle.generation = shipTextureHandle.generation = 0;
+    atlas = nullptr;
+    spriteBatch = nullptr;
+    assetLoader = nullptr;
+    profiler = new Profiler();
+
+    world = new Registry();
+    movementSystem = new MovementSystem();
+    collisionSystem = new CollisionSystem(colDet);
+    lifetimeSystem = new LifetimeSystem();
+    spriteSystem = new SpriteSystem(collisionSystem);
+
+    jobs = new JobSystem();
+    collisionGraph = nullptr;
+    updateGraph = nullptr;
+
+    particlePool = new Pool<Particle>(256);
+    texturePool = new Pool<Texture>(64);
+
+    archive = new AssetArchive();
+    inputLog = new InputLog();
+
+    // Start decoding every image straight away, headless games draw nothing
+    if (renderer != nullptr)
+    {
+        // The archive is found next to the executable whatever the working directory is,
+        // without it images are decoded from the files
+        char* basePath = SDL_GetBasePath();
+
+        if (basePath != nullptr && archive->open(string(basePath) + "assets.pak"))
+        {
+            textureCache->setArchive(archive);
+        }
 
-    background = new Layer(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
-    background->addLayer("images/bg1.png");
-    background->addLayer("images/bg2.png");
+        SDL_free(basePath);
 
-    foreground = new Layer(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
-    foreground->addLayer("images/fg1.png");
+        assetLoader = new AssetLoader(textureCache);
+        assetLoader->requestTexture("images" + DS + "bg1.png");
+        assetLoader->requestTexture("images" + DS + "bg2.png");
+        assetLoader->requestTexture("images" + DS + "fg1.png");
+        assetLoader->requestSurface("images" + DS + "ship.png");
+    }
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Main game loop, gets events, calculates any collisions based on those (user) events and
- then renders a frame
+ Deconstructs the game, releasing the pooled objects before the systems they live in and
+ the textures before the cache they came from
 
  */
-void Game::runGame()
+Game::~Game()
 {
-    createShip();
+    // Joins the worker threads before anything the graphs run on goes away
+    delete jobs;
+    delete collisionGraph;
+    delete updateGraph;
+
+    particlePool->release(shipHandle);
+    texturePool->release(shipTextureHandle);
 
+    delete particlePool;
+    delete texturePool;
+
+    delete spriteSystem;
+    delete lifetimeSystem;
+    delete collisionSystem;
+    delete movementSystem;
+    delete world;
+
+    delete background;
+    delete foreground;
+    delete tiles;
+    delete spriteBatch;
+    delete atlas;
+
+    // Joins the decoding threads
+    delete assetLoader;
+
+    delete netServer;
+    delete netClient;
+    delete rewind;
+    delete inputLog;
+    delete profiler;
+    delete particles;
+    delete camera;
+    delete colDet;
+    delete textureCache;
+    delete rotationCache;
+
+    // Unmapped last, surfaces of archived images point into it
+    delete archive;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Shows a loading screen with a progress bar until the asset loader has decoded and
+ uploaded every requested image, or the user quits
+
+ */
+void Game::loadAssets()
+{
     quit = false;
 
-    while (!quit)
+    while (!assetLoader->isReady() && !quit)
     {
         getEvents();
 
-        getCollisions();
+        // Upload a few images per frame so the progress bar keeps moving
+        assetLoader->upload(2);
+
+        int barWidth = SCREEN_WIDTH / 2;
+        int barHeight = 16;
+        int barX = (SCREEN_WIDTH - barWidth) / 2;
+        int barY = (SCREEN_HEIGHT - barHeight) / 2;
+        int filled = barWidth * assetLoader->getProgress();
 
-        render();
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+
+        boxRGBA(renderer, barX, barY, barX + filled, barY + barHeight, 255, 255, 255, 255);
+        rectangleRGBA(renderer, barX, barY, barX + barWidth, barY + barHeight, 255, 255, 255, 255);
+
+        SDL_RenderPresent(renderer);
     }
+
+    // Set base color of renderer back
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Creates a new particle with a space ship texture that the player can later control
+ Creates the background and foreground layers and packs the sprite atlas. The layer
+ textures were uploaded into the texture cache by the asset loader, so adding them is a
+ cache hit
 
  */
-void Game::createShip()
+void Game::createLayers()
 {
-    // Create ship rectangle and texture, then bind the texture to a new ship particle
-    SDL_Rect shipRect = {0, 0, 64, 64};
-    Texture *shipTexture = new Texture(renderer, "images" + DS + "ship.png", shipRect);
+    background = new Layer(textureCache, SCREEN_WIDTH, SCREEN_HEIGHT);
+    background->addLayer(("images" + DS + "bg1.png").c_str());
+    background->addLayer(("images" + DS + "bg2.png").c_str());
 
-    // M_PI * 1.5 makes the particles heading upwards. 0 is Right, .5 is Down, 1 is Left
-    angle = M_PI * 1.5;
-    //                   x position        y position         speed heading friction gravity
-    ship = new Particle(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 0,    angle,  0.97,    0, shipTexture);
+    foreground = new Layer(textureCache, SCREEN_WIDTH, SCREEN_HEIGHT);
+    foreground->addLayer(("images" + DS + "fg1.png").c_str());
+
+    // Still inner layers are drawn into one texture once instead of every frame
+    background->setComposited(true);
+    foreground->setComposited(true);
+
+    // The background is far behind the world and the foreground just in front of it
+    background->setParallax(0.5f);
+    foreground->setParallax(1.5f);
+
+    // The software renderer is slow to blend whole screen images, blend them on the CPU
+    // across every core instead
+    SDL_RendererInfo rendererInfo;
+
+    if (renderer != nullptr && SDL_GetRendererInfo(renderer, &rendererInfo) == 0 &&
+        !(rendererInfo.flags & SDL_RENDERER_ACCELERATED))
+    {
+        background->setSoftwareComposited(jobs);
+        foreground->setSoftwareComposited(jobs);
+    }
+
+    // A tile map replaces the background, its tiles are loaded as the camera reaches them
+    if (!tileMapPath.empty() && renderer != nullptr)
+    {
+        tiles = new TileLayer(textureCache, tileBudget);
+
+        if (!tiles->open(tileMapPath))
+        {
+            delete tiles;
+            tiles = nullptr;
+        }
+    }
+
+    // Pack every sprite image into the atlas once
+    if (renderer != nullptr)
+    {
+        atlas = new Atlas(renderer);
+        atlas->addImage("ship", assetLoader->takeSurface("images" + DS + "ship.png"));
+        atlas->build();
+
+        spriteBatch = new SpriteBatch(renderer, atlas);
+        spriteBatch->setRotationCache(rotationCache);
+        atlas->setRotationCache(rotationCache);
+    }
+
+    // The layers hold their own handles now
+    if (assetLoader != nullptr)
+    {
+        assetLoader->release();
+    }
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Get events from the user, such as key strokes or closing the window and update variables
- the game state uses accordingly
+ Main game loop, gets events, then advances the simulation in fixed ticks for the time
+ that has passed since the last frame and renders a frame interpolated between the last
+ two ticks. Simulation speed does not depend on how fast frames are presented. A replay
+ plays at the same speed and quits when the recording ends
 
  */
-void Game::getEvents()
+void Game::runGame()
 {
-    SDL_Event event;
+    loadAssets();
 
-    // If the window is closed or the esc key is pressed, exiit
-    while (SDL_PollEvent(&event))
+    if (quit)
     {
-        if (currentKeyStates[SDL_SCANCODE_ESCAPE] || event.type == SDL_QUIT)
+        return;
+    }
+
+    createLayers();
+    createShip();
+    createDebris(particleCount);
+    createJobGraphs();
+
+    // A client's entities come from the server
+    if (netClient == nullptr)
+    {
+        createEntities(entityCount);
+    }
+
+    // Rewinding would leave a recording or replay out of step with the ticks it played,
+    // and a client's world belongs to the server
+    if (rewindSeconds > 0 && netClient == nullptr && !inputLog->isRecording() && !inputLog->isReplaying())
+    {
+        rewind = new RewindBuffer(lround(rewindSeconds * tickRate), rewindBudget);
+
+        saveWorldState(worldState);
+        rewind->push(worldState);
+    }
+
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 previousCounter = SDL_GetPerformanceCounter();
+    double accumulator = 0;
+
+    frameDeadline = previousCounter;
+
+    while (!quit)
+    {
+        const double tickLength = 1.0 / tickRate;
+
+        // Wait until just enough time is left to get the next frame ready, so the input it
+        // is simulated with is as fresh as it can be when the frame is shown
+        if (lowLatency)
         {
-            quit = true;
+            const Uint64 period = framePeriod * frequency;
+            const Uint64 slack = presentSlack * frequency;
+            const Uint64 now = SDL_GetPerformanceCounter();
+
+            frameDeadline += period;
+
+            // After a frame that ran long pick the cadence up from now instead of rushing
+            // out frames to catch up
+            if (frameDeadline < now + slack)
+            {
+                frameDeadline = now + slack;
+            }
+
+            waitUntil(frameDeadline - slack);
+        }
+
+        Uint64 counter = SDL_GetPerformanceCounter();
+        double frameTime = (double)(counter - previousCounter) / frequency;
+        previousCounter = counter;
+
+        // Clamp long frames (window drags, breakpoints) to avoid the spiral of death
+        if (frameTime > maxFrameTime)
+        {
+            frameTime = maxFrameTime;
+        }
+
+        accumulator += frameTime;
+
+        profiler->beginFrame();
+
+        {
+            PROFILE_SCOPE(profiler, Profiler::Events);
+            getEvents();
         }
+
+        while (accumulator >= tickLength && !quit)
+        {
+            if (rewindTick())
+            {
+                accumulator -= tickLength;
+                continue;
+            }
+
+            // A replay ends the game once every recorded tick has been played
+            if (!sampleInput())
+            {
+                quit = true;
+                break;
+            }
+
+            {
+                PROFILE_SCOPE(profiler, Profiler::Collisions);
+                getCollisions();
+            }
+
+            {
+                // Simulation constants are tuned per 60hz frame, so scale the tick to that
+                PROFILE_SCOPE(profiler, Profiler::Physics);
+                update(60.0f / tickRate);
+            }
+
+            reportTick();
+
+            if (rewind != nullptr)
+            {
+                PROFILE_SCOPE(profiler, Profiler::Rewind);
+                saveWorldState(worldState);
+                rewind->push(worldState);
+            }
+
+            accumulator -= tickLength;
+        }
+
+        if (netClient != nullptr)
+        {
+            updateNetClient();
+        }
+
+        render(accumulator / tickLength);
+
+        profiler->endFrame();
+    }
+
+    finishInputLog();
+    profiler->printLatency();
+
+    if (netClient != nullptr)
+    {
+        netClient->printStats();
+    }
+
+    textureCache->printStats();
+
+    if (tiles != nullptr)
+    {
+        tiles->printStats();
+    }
+
+    if (rotationCache != nullptr)
+    {
+        rotationCache->printStats();
+    }
+
+    if (rewind != nullptr)
+    {
+        rewind->printStats();
+    }
+
+    if (!profileCsvPath.empty())
+    {
+        profiler->writeCsv(profileCsvPath);
+    }
+
+    if (!profileTracePath.empty())
+    {
+        profiler->writeTrace(profileTracePath);
     }
+}
+
 
-    thrusting = currentKeyStates[SDL_SCANCODE_UP];
-    braking = currentKeyStates[SDL_SCANCODE_DOWN];
 
-    turningRight = currentKeyStates[SDL_SCANCODE_RIGHT];
-    turningLeft = currentKeyStates[SDL_SCANCODE_LEFT];
+/** --------------------------------------------------------------------------------------
+ Sets files to dump the profiler's frame history to when the game exits
+
+ @param csvPath    Path of a CSV file with per frame timings, empty for none
+ @param tracePath  Path of a Chrome trace JSON file with timed events, empty for none
+ */
+void Game::setProfileOutput(const string& csvPath, const string& tracePath)
+{
+    profileCsvPath = csvPath;
+    profileTracePath = tracePath;
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Calculate collision detection for each collision enabled object on screen
+ Sets a tile map to draw instead of the background layer, call before the game runs
 
+ @param path    Path of the tile map file, empty for the background layer
+ @param budget  Most bytes of tiles to keep loaded at once
  */
-void Game::getCollisions()
+void Game::setTileMap(const string& path, long budget)
 {
-    // Pass the ship with it's center value of 32 (it's 64 x 64)
-    colDet->bounceScreen(ship, 32);
+    tileMapPath = path;
+    tileBudget = budget;
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Render the current frame after any changes made by the game setup or user, such as
- scrolling the background, or the heading / velocity of the ship. This function also adds
- the 16ms delay to hit ~60fps
+ Draws rotated sprites from frames rotated once to a fixed number of angles instead of
+ rotating them every frame, for the software renderer. Call before the game runs
 
+ @param steps   Number of angles a full turn is rounded to, 0 to rotate sprites as they
+                are drawn
+ @param budget  Most bytes of rotated frames to keep
  */
-void Game::render()
+void Game::setRotationCache(int steps, long budget)
 {
-    // Clear the window
-    SDL_RenderClear(renderer);
+    if (renderer == nullptr || steps <= 0 || rotationCache != nullptr)
+    {
+        return;
+    }
+
+    rotationCache = new RotationCache(renderer, steps, budget);
+    textureCache->setRotationCache(rotationCache);
+}
 
-    // Scroll the second inner layer positive 1 pixel on the y axis (downwards)
-    background->offsetInnerLayer(2, 0, 1);
-    background->render();
 
-    // Make any modifications to the ships direction and set the new heading
-    if(turningRight)
+
+/** --------------------------------------------------------------------------------------
+ Sets how much of the world's past is kept for rewinding, call before the game runs. Not
+ kept while recording or replaying an input log or connected to a server
+
+ @param seconds  Seconds of ticks to keep, 0 to turn rewinding off
+ @param budget   Most bytes of encoded ticks to keep, older ticks are dropped to fit
+ */
+void Game::setRewind(double seconds, long budget)
+{
+    rewindSeconds = seconds;
+    rewindBudget = budget;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the peak resident set size of the process
+
+ @returns Peak resident memory in kilobytes, 0 if it cannot be determined
+ */
+static long getPeakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
     {
-        angle += 0.05;
+        return counters.PeakWorkingSetSize / 1024;
     }
 
-    if(turningLeft)
+    return 0;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
     {
-        angle -= 0.05;
+        return 0;
     }
 
-    ship->setHeading(angle);
+  #ifdef __APPLE__
+    // macOS reports bytes, Linux reports kilobytes
+    return usage.ru_maxrss / 1024;
+  #else
+    return usage.ru_maxrss;
+  #endif
+#endif
+}
 
-    // Make any modifications to the ships velocity and then update the ship
-    if (thrusting)
+
+
+/** --------------------------------------------------------------------------------------
+ Headless benchmark loop, runs a number of simulation ticks as fast as possible with no
+ rendering, event handling or frame pacing, then reports the throughput. The ship is
+ joined by the debris particles and entities set by setPopulation, placed by fixed seeds,
+ so every run simulates exactly the same world. A replay steers the ship as it was
+ recorded and runs for as many ticks as were recorded
+
+ @param ticks         Number of ticks to simulate, ignored when replaying
+ @returns             False if the second half of the run made any heap allocations
+ */
+bool Game::runHeadless(int ticks)
+{
+    createLayers();
+    createShip();
+    createEntities(entityCount);
+    createDebris(particleCount);
+    createJobGraphs();
+
+    if (inputLog->isReplaying())
     {
-        ship->accelerate(0.2);
+        ticks = inputLog->getTickCount();
     }
-    else
+
+    const float dt = 60.0f / tickRate;
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    // The first half of the run warms up, growing containers to the sizes they settle at.
+    // The second half is the steady state and should not allocate at all
+    const int warmupTicks = ticks / 2;
+    unsigned long long steadyAllocations = 0;
+
+    for (int i = 0; i < ticks; i++)
     {
-        ship->accelerate(0);
+        if (i == warmupTicks)
+        {
+            steadyAllocations = AllocCounter::getAllocations();
+        }
+
+        sampleInput();
+        getCollisions();
+        update(dt);
+        reportTick();
     }
 
-    if (braking)
+    steadyAllocations = AllocCounter::getAllocations() - steadyAllocations;
+
+    const double seconds = (double)(SDL_GetPerformanceCounter() - start) / frequency;
+
+    printf("kernel: %s\n", deterministic ? "fixed" : ParticleKernel::getPathName());
+    printf("threads: %d\n", jobs->getThreadCount());
+    printf("ticks: %d\n", ticks);
+    printf("particles: %d\n", particles->size());
+    printf("entities: %d\n", world->size());
+    printf("seconds: %.6f\n", seconds);
+    printf("ticks/sec: %.1f\n", seconds > 0 ? ticks / seconds : 0);
+    printf("ns/tick: %.1f\n", ticks > 0 ? seconds * 1e9 / ticks : 0);
+    printf("peak rss kb: %ld\n", getPeakRssKb());
+    printf("steady state allocations: %llu\n", steadyAllocations);
+    printf("checksum: %016llx\n", (unsigned long long)getChecksum());
+
+    finishInputLog();
+
+    return steadyAllocations == 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Authoritative server loop, simulates the world in real time with no window and sends
+ snapshots of it to every client that connects. The ship stays put, it is nobody's
+
+ @param ticks  Number of ticks to run for
+ */
+void Game::runServer(int ticks)
+{
+    createLayers();
+    createShip();
+    createEntities(entityCount);
+    createDebris(particleCount);
+    createJobGraphs();
+
+    const float dt = 60.0f / tickRate;
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    const Uint64 tickLength = frequency / tickRate;
+    Uint64 deadline = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < ticks; i++)
     {
-        ship->decelerate(0.075);
+        netServer->receive();
+
+        sampleInput();
+        getCollisions();
+        update(dt);
+        reportTick();
+
+        netServer->send(*world, ticksRun);
+
+        deadline += tickLength;
+        waitUntil(deadline);
     }
 
-    ship->update();
+    printf("checksum: %016llx\n", (unsigned long long)getChecksum());
+}
 
-    // Scroll the first inner layer positive 1 pixel on the x axis (right)
-    foreground->offsetInnerLayer(1, 1, 0);
-    foreground->render();
 
-    // Render the frame with the above changes
-    SDL_RenderPresent(renderer);
+
+/** --------------------------------------------------------------------------------------
+ Client loop with no window, mirrors the server's entities in real time for a number of
+ ticks and then prints what it received. For measuring a server with many clients
+
+ @param ticks  Number of ticks to run for
+ */
+void Game::runClient(int ticks)
+{
+    createLayers();
+    createShip();
+
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+    const Uint64 tickLength = frequency / tickRate;
+    Uint64 deadline = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < ticks; i++)
+    {
+        updateNetClient();
+
+        deadline += tickLength;
+        waitUntil(deadline);
+    }
+
+    printf("entities: %d\n", world->size());
+    netClient->printStats();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Receives snapshots from the server and mirrors its entities into the world where they
+ should be drawn now. The server sends what is near the ship
+
+ */
+void Game::updateNetClient()
+{
+    const double now = (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+
+    netClient->update(now, ship->getPosition());
+    netClient->apply(*world, shipTexture, now);
+
+    // The mirrored entities moved, file them where they are now so drawing finds them
+    if (renderer != nullptr)
+    {
+        collisionSystem->updateGrid(*world);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Makes the game an authoritative server for clients on other processes or machines. Call
+ after setting the tick rate and before the game runs
+
+ @param port              UDP port to listen on
+ @param interestRadius    Clients are only sent entities this close to their ship
+ @param snapshotInterval  Ticks between snapshots
+ @param printStats        Print bandwidth and encoding time per client once a second
+ @returns                 False if the port could not be opened
+ */
+bool Game::setServer(int port, float interestRadius, int snapshotInterval, bool printStats)
+{
+    netServer = new NetServer();
+    return netServer->open(port, tickRate, snapshotInterval, interestRadius, printStats);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Makes the game a client that draws the entities of a server instead of simulating its
+ own. Call before the game runs
+
+ @param host  Host name or address of the server
+ @param port  UDP port the server listens on
+ @returns     False if the server could not be found
+ */
+bool Game::setClient(const string& host, int port)
+{
+    netClient = new NetClient();
+    return netClient->connect(host, port);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets how many simulation ticks run per second
+
+ @param tickRate      Number of ticks per second, 60 matches the original frame rate
+ */
+void Game::setTickRate(int tickRate)
+{
+    if (tickRate > 0)
+    {
+        this->tickRate = tickRate;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets how many threads run the simulation, call before the game runs
+
+ @param threadCount   Number of threads including the main thread, 1 runs everything on
+                      the main thread
+ */
+void Game::setThreadCount(int threadCount)
+{
+    if (threadCount > 0)
+    {
+        delete jobs;
+        jobs = new JobSystem(threadCount - 1);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the longest frame the simulation will try to catch up on, anything longer slows the
+ world down instead of running an ever growing number of ticks
+
+ @param maxFrameTime  Longest frame time in seconds
+ */
+void Game::setMaxFrameTime(double maxFrameTime)
+{
+    this->maxFrameTime = maxFrameTime;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Turns on low latency mode, where the game paces frames to the display itself and reads
+ input as late as it can instead of relying on a vsynced present, which would leave input
+ waiting while the previous frame blocks. Create the renderer without vsync to use it
+
+ @param refreshRate   Refresh rate of the display in hz, frames are presented at this rate
+ @param presentSlack  Seconds before each frame is due to start getting it ready, enough to
+                      simulate and render a frame with some to spare
+ */
+void Game::setLowLatency(int refreshRate, double presentSlack)
+{
+    lowLatency = true;
+    framePeriod = 1.0 / (refreshRate > 0 ? refreshRate : 60);
+    this->presentSlack = std::max(0.0, std::min(presentSlack, framePeriod));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sleeps until a point in time, spinning for the last couple of milliseconds as a sleep can
+ overshoot by a whole scheduler tick
+
+ @param counter   Performance counter value to wait for
+ */
+void Game::waitUntil(Uint64 counter)
+{
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+
+    for (Uint64 now = SDL_GetPerformanceCounter(); now < counter; now = SDL_GetPerformanceCounter())
+    {
+        const Uint64 ms = (counter - now) * 1000 / frequency;
+
+        if (ms > 2)
+        {
+            SDL_Delay(ms - 2);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets how many debris particles and entities the world starts with, call before the game
+ runs
+
+ @param particleCount Number of debris particles to add alongside the ship
+ @param entityCount   Number of asteroid and bullet entities to add
+ */
+void Game::setPopulation(int particleCount, int entityCount)
+{
+    this->particleCount = particleCount;
+    this->entityCount = entityCount;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Simulates the particles, entities and ship in fixed point so every machine and build
+ ends a run in exactly the same state, for lockstep play. Call before the game runs
+
+ @param deterministic  True to simulate in fixed point
+ @param hashInterval   Print the state hash every this many ticks, 0 for never
+ */
+void Game::setDeterministic(bool deterministic, int hashInterval)
+{
+    this->deterministic = deterministic;
+    this->hashInterval = hashInterval;
+
+    particles->setDeterministic(deterministic);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Records the ship's input on every tick to a file, or steers the ship from a recording
+ instead of the keyboard. A replay sets the tick rate, population and mode it was
+ recorded with, so call this after setting those. Call before the game runs
+
+ @param recordPath    Path of a log to record to, empty for none
+ @param replayPath    Path of a log to replay, empty for none. Replaying takes precedence
+                      over recording
+ @returns             False if the log could not be opened
+ */
+bool Game::setInputLog(const string& recordPath, const string& replayPath)
+{
+    if (!replayPath.empty())
+    {
+        if (!inputLog->replay(replayPath))
+        {
+            return false;
+        }
+
+        setTickRate(inputLog->getTickRate());
+        setPopulation(inputLog->getParticleCount(), inputLog->getEntityCount());
+        setDeterministic(inputLog->getFlags() & INPUT_LOG_DETERMINISTIC, hashInterval);
+
+        printf("Replaying %d ticks from %s\n", inputLog->getTickCount(), replayPath.c_str());
+        return true;
+    }
+
+    if (!recordPath.empty())
+    {
+        return inputLog->record(recordPath, tickRate, particleCount, entityCount,
+                                deterministic ? INPUT_LOG_DETERMINISTIC : 0);
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a new particle with a space ship texture that the player can later control
+
+ */
+void Game::createShip()
+{
+    // Create ship rectangle and texture, then bind the texture to a new ship particle
+    SDL_Rect shipRect = {0, 0, 64, 64};
+    if (spriteBatch != nullptr)
+    {
+        shipTextureHandle = texturePool->acquire(spriteBatch, "ship", shipRect);
+    }
+    else
+    {
+        shipTextureHandle = texturePool->acquire(textureCache, "images" + DS + "ship.png", shipRect);
+    }
+
+    shipTexture = texturePool->get(shipTextureHandle);
+
+    // M_PI * 1.5 makes the particles heading upwards. 0 is Right, .5 is Down, 1 is Left
+    const float angle = M_PI * 1.5;
+    //                                 system     x position        y position         speed  heading  friction gravity
+    shipHandle = particlePool->acquire(particles, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 0,     angle,   0.97f,   0.0f,   shipTexture);
+    ship = particlePool->get(shipHandle);
+    previousHeading = ship->getHeading();
+
+    // Give the ship a collision midpoint of 32 (it's 64 x 64)
+    particles->setRadius(ship->getId(), 32);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a number of entities placed by a fixed seed. Every fourth one is a bullet that
+ wraps around the screen and expires after a few seconds, the rest are asteroids that
+ bounce on the screen edges. Asteroids are drawn with the ship sprite for now
+
+ @param count  Number of entities to create
+ */
+void Game::createEntities(int count)
+{
+    // Small linear congruential generator, the same sequence on every platform
+    unsigned int seed = 54321;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+
+    for (int i = 0; i < count; i++)
+    {
+        bool bullet = i % 4 == 3;
+        float heading = random() * 2 * M_PI;
+        float speed = bullet ? 8 : random() * 2;
+
+        Entity entity = world->create((bullet ? TRANSFORM | VELOCITY | COLLIDER | LIFETIME
+                                              : TRANSFORM | VELOCITY | COLLIDER | SPRITE) |
+                                      (deterministic ? BODY : 0));
+
+        Transform* transform = world->get<Transform>(entity);
+        transform->x = random() * SCREEN_WIDTH;
+        transform->y = random() * SCREEN_HEIGHT;
+        transform->angle = heading;
+
+        Vec2 launch = Vec2::fromAngle(heading) * speed;
+
+        // Deterministic entities move as a body, launched along a table angle, and their
+        // transform and velocity start as a copy of it
+        if (deterministic)
+        {
+            const FixedVec2 fixedLaunch = FixedVec2::fromAngle(fixedAngleFromRadians(heading)) * Fixed::fromFloat(speed);
+
+            Body* body = world->get<Body>(entity);
+            body->x = Fixed::fromFloat(transform->x);
+            body->y = Fixed::fromFloat(transform->y);
+            body->velocityX = fixedLaunch.x;
+            body->velocityY = fixedLaunch.y;
+
+            transform->x = body->x.toFloat();
+            transform->y = body->y.toFloat();
+            launch = fixedLaunch.toVec2();
+        }
+
+        Velocity* velocity = world->get<Velocity>(entity);
+        velocity->x = launch.x;
+        velocity->y = launch.y;
+        velocity->friction = bullet ? 1 : 0.999;
+        velocity->gravity = 0;
+
+        Collider* collider = world->get<Collider>(entity);
+        collider->midPoint = bullet ? 1 : 16;
+        collider->wrap = bullet;
+
+        if (bullet)
+        {
+            world->get<Lifetime>(entity)->remaining = 180;
+        }
+        else
+        {
+            world->get<Sprite>(entity)->texture = shipTexture;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates a number of debris particles placed by a fixed seed, drifting in every direction
+ and slowly falling
+
+ @param count  Number of particles to create
+ */
+void Game::createDebris(int count)
+{
+    // Small linear congruential generator, the same sequence on every platform
+    unsigned int seed = 12345;
+    auto random = [&seed]() -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0f;
+    };
+
+    particles->reserve(particles->size() + count);
+
+    for (int i = 0; i < count; i++)
+    {
+        float x = random() * SCREEN_WIDTH;
+        float y = random() * SCREEN_HEIGHT;
+        float speed = random() * 4;
+        float heading = random() * 2 * M_PI;
+
+        int id = particles->add(x, y, speed, heading, 0.999, 0.05);
+        particles->setRadius(id, 2);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Get events from the user, such as key strokes or closing the window and update variables
+ the game state uses accordingly
+
+ */
+void Game::getEvents()
+{
+    SDL_Event event;
+
+    // If the window is closed or the esc key is pressed, exiit
+    while (SDL_PollEvent(&event))
+    {
+        if (currentKeyStates[SDL_SCANCODE_ESCAPE] || event.type == SDL_QUIT)
+        {
+            quit = true;
+        }
+
+        // Render target contents are lost when the device resets, redraw the composites
+        if ((event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) && background != nullptr)
+        {
+            background->invalidate();
+            foreground->invalidate();
+
+            if (rotationCache != nullptr)
+            {
+                rotationCache->clear();
+            }
+        }
+
+        // F3 shows or hides the frame time overlay
+        if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_F3 && !event.key.repeat)
+        {
+            profiler->toggleOverlay();
+        }
+
+        // Plus and minus zoom the camera in and out, never further out than the whole screen
+        if (event.type == SDL_KEYDOWN)
+        {
+            const SDL_Scancode key = event.key.keysym.scancode;
+
+            if (key == SDL_SCANCODE_EQUALS || key == SDL_SCANCODE_KP_PLUS)
+            {
+                camera->setZoom(std::min(camera->getZoom() * CAMERA_ZOOM_STEP, CAMERA_MAX_ZOOM));
+            }
+            else if (key == SDL_SCANCODE_MINUS || key == SDL_SCANCODE_KP_MINUS)
+            {
+                camera->setZoom(std::max(camera->getZoom() / CAMERA_ZOOM_STEP, 1.0f));
+            }
+        }
+
+        // Time the first steering key press until it shows up on screen
+        if (event.type == SDL_KEYDOWN && !event.key.repeat && !pressPending && !pressSimulated)
+        {
+            const SDL_Scancode key = event.key.keysym.scancode;
+
+            if (key == SDL_SCANCODE_UP || key == SDL_SCANCODE_DOWN || key == SDL_SCANCODE_LEFT || key == SDL_SCANCODE_RIGHT)
+            {
+                pressTime = event.key.timestamp;
+                pressPending = true;
+            }
+        }
+    }
+
+    heldButtons = (currentKeyStates[SDL_SCANCODE_UP] ? INPUT_THRUST : 0) |
+                  (currentKeyStates[SDL_SCANCODE_DOWN] ? INPUT_BRAKE : 0) |
+                  (currentKeyStates[SDL_SCANCODE_LEFT] ? INPUT_TURN_LEFT : 0) |
+                  (currentKeyStates[SDL_SCANCODE_RIGHT] ? INPUT_TURN_RIGHT : 0);
+
+    rewinding = currentKeyStates[SDL_SCANCODE_BACKSPACE];
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the ship's controls for the next tick, from the input log when replaying or from
+ the held buttons otherwise, recording them if a recording is running
+
+ @returns False once a replay has played every recorded tick
+ */
+bool Game::sampleInput()
+{
+    Uint8 buttons = heldButtons;
+
+    if (inputLog->isReplaying())
+    {
+        if (!inputLog->read(buttons))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        inputLog->write(buttons);
+    }
+
+    // The press is in this tick, so the next frame presented shows it
+    if (pressPending)
+    {
+        pressPending = false;
+        pressSimulated = true;
+    }
+
+    thrusting = buttons & INPUT_THRUST;
+    braking = buttons & INPUT_BRAKE;
+    turningLeft = buttons & INPUT_TURN_LEFT;
+    turningRight = buttons & INPUT_TURN_RIGHT;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Ends a recording with the state the simulation ended in, or checks a replay ended in the
+ state that was recorded
+
+ */
+void Game::finishInputLog()
+{
+    if (inputLog->isRecording())
+    {
+        inputLog->finish(getChecksum());
+        printf("Recorded %d ticks\n", inputLog->getTickCount());
+    }
+    else if (inputLog->isReplaying() && inputLog->hasChecksum())
+    {
+        const Uint64 checksum = getChecksum();
+
+        if (checksum == inputLog->getChecksum())
+        {
+            printf("Replay matched the recording\n");
+        }
+        else
+        {
+            printf("Replay diverged from the recording, checksum %016llx instead of %016llx\n",
+                   (unsigned long long)checksum, (unsigned long long)inputLog->getChecksum());
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a checksum of the simulation state, the raw bits of every particle, entity and the
+ ship's heading, so runs that differ in the last bit of any value are told apart
+
+ @returns 64 bit FNV-1a hash of the state
+ */
+Uint64 Game::getChecksum()
+{
+    Uint64 hash = 14695981039346656037ull;
+
+    auto add = [&hash](const void* data, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++)
+        {
+            hash = (hash ^ ((const Uint8*)data)[i]) * 1099511628211ull;
+        }
+    };
+
+    // Deterministic runs hash the fixed point state, the floats are only a copy of it
+    if (deterministic)
+    {
+        const FixedParticleArrays p = particles->getFixedArrays();
+        const size_t bytes = particles->size() * sizeof(Fixed);
+        add(p.x, bytes);
+        add(p.y, bytes);
+        add(p.velocityX, bytes);
+        add(p.velocityY, bytes);
+
+        const FixedVec2 heading = ship->getFixedHeading();
+        add(&heading, sizeof(heading));
+
+        world->each(BODY, [&add](Archetype& archetype)
+        {
+            add(archetype.bodies.data(), archetype.size() * sizeof(Body));
+        });
+
+        return hash;
+    }
+
+    const size_t floats = particles->size() * sizeof(float);
+    add(particles->getPositionsX(), floats);
+    add(particles->getPositionsY(), floats);
+    add(particles->getVelocitiesX(), floats);
+    add(particles->getVelocitiesY(), floats);
+
+    const Vec2 heading = ship->getHeading();
+    add(&heading, sizeof(heading));
+
+    world->each(TRANSFORM, [&add](Archetype& archetype)
+    {
+        add(archetype.transforms.data(), archetype.size() * sizeof(Transform));
+
+        if (archetype.mask & VELOCITY)
+        {
+            add(archetype.velocities.data(), archetype.size() * sizeof(Velocity));
+        }
+    });
+
+    return hash;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Counts a finished tick and prints the state hash every hashInterval ticks, so the output
+ of two machines or builds running the same input can be diffed to find the first tick
+ they part ways
+
+ */
+void Game::reportTick()
+{
+    ticksRun++;
+
+    if (hashInterval > 0 && ticksRun % hashInterval == 0)
+    {
+        printf("tick %d hash %016llx\n", ticksRun, (unsigned long long)getChecksum());
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the raw bits of a float and back, for keeping floats in states of words
+
+ */
+static Uint32 floatBits(float value)
+{
+    Uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+
+static float bitsFloat(Uint32 bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Writes the state of the world to a vector of words, the raw bits of every value so it
+ can be put back exactly. In order: the tick count, particle count and entity capacity,
+ the ship's heading in float and fixed point, the layer scroll fractions and offsets,
+ each particle array in turn, then WORLD_STATE_ENTITY columns of a word per entity index
+
+    0 mask   1 transform   4 velocity   8 collider   10 lifetime   11 body
+
+ The mask is 0 for an index no entity is using. Values are laid out in columns so values
+ that change alike sit next to each other, which is what the rewind buffer packs well.
+ Deterministic runs keep the fixed point particle state, the floats are only a copy of it
+
+ @param state  Set to the state, only allocates when the world grows
+ */
+void Game::saveWorldState(std::vector<Uint32>& state)
+{
+    const int count = particles->size();
+    const int capacity = world->getCapacity();
+
+    state.resize(WORLD_STATE_HEADER + count * 4 + capacity * WORLD_STATE_ENTITY);
+    entitySprites.resize(capacity);
+
+    Uint32* out = state.data();
+
+    auto putArray = [&out, count](const void* array)
+    {
+        memcpy(out, array, count * sizeof(Uint32));
+        out += count;
+    };
+
+    const Vec2 heading = ship->getHeading();
+    const FixedVec2 fixedHeading = ship->getFixedHeading();
+    const SDL_Point backgroundOffset = background->getInnerLayerOffset(2);
+    const SDL_Point foregroundOffset = foreground->getScroll();
+    const SDL_Point tileOffset = tiles != nullptr ? tiles->getScroll() : SDL_Point{0, 0};
+
+    *out++ = ticksRun;
+    *out++ = count;
+    *out++ = capacity;
+    *out++ = floatBits(heading.x);
+    *out++ = floatBits(heading.y);
+    *out++ = fixedHeading.x.raw;
+    *out++ = fixedHeading.y.raw;
+    *out++ = floatBits(backgroundScroll);
+    *out++ = floatBits(foregroundScroll);
+    *out++ = backgroundOffset.x;
+    *out++ = backgroundOffset.y;
+    *out++ = foregroundOffset.x;
+    *out++ = foregroundOffset.y;
+    *out++ = tileOffset.x;
+    *out++ = tileOffset.y;
+
+    if (deterministic)
+    {
+        const FixedParticleArrays p = particles->getFixedArrays();
+        putArray(p.x);
+        putArray(p.y);
+        putArray(p.velocityX);
+        putArray(p.velocityY);
+    }
+    else
+    {
+        putArray(particles->getPositionsX());
+        putArray(particles->getPositionsY());
+        putArray(particles->getVelocitiesX());
+        putArray(particles->getVelocitiesY());
+    }
+
+    std::fill(out, out + capacity * WORLD_STATE_ENTITY, 0);
+
+    world->each(0, [this, out, capacity](Archetype& archetype)
+    {
+        const unsigned int mask = archetype.mask;
+
+        for (int row = 0; row < archetype.size(); row++)
+        {
+            const int index = archetype.entities[row].index;
+            Uint32* slot = out + index;
+
+            slot[0] = mask;
+
+            if (mask & TRANSFORM)
+            {
+                const Transform& transform = archetype.transforms[row];
+                slot[1 * capacity] = floatBits(transform.x);
+                slot[2 * capacity] = floatBits(transform.y);
+                slot[3 * capacity] = floatBits(transform.angle);
+            }
+
+            if (mask & VELOCITY)
+            {
+                const Velocity& velocity = archetype.velocities[row];
+                slot[4 * capacity] = floatBits(velocity.x);
+                slot[5 * capacity] = floatBits(velocity.y);
+                slot[6 * capacity] = floatBits(velocity.friction);
+                slot[7 * capacity] = floatBits(velocity.gravity);
+            }
+
+            if (mask & COLLIDER)
+            {
+                slot[8 * capacity] = floatBits(archetype.colliders[row].midPoint);
+                slot[9 * capacity] = archetype.colliders[row].wrap;
+            }
+
+            if (mask & LIFETIME)
+            {
+                slot[10 * capacity] = floatBits(archetype.lifetimes[row].remaining);
+            }
+
+            if (mask & BODY)
+            {
+                const Body& body = archetype.bodies[row];
+                slot[11 * capacity] = body.x.raw;
+                slot[12 * capacity] = body.y.raw;
+                slot[13 * capacity] = body.velocityX.raw;
+                slot[14 * capacity] = body.velocityY.raw;
+            }
+
+            if (mask & SPRITE)
+            {
+                entitySprites[index] = archetype.sprites[row].texture;
+            }
+        }
+    });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Puts the world back in a state written by saveWorldState. Entities that have expired
+ since are put back at their index and ones that were not there are destroyed. Nothing
+ is drawn part way from where it was before, the state is shown as it is
+
+ @param state  State to restore, ignored if the world has changed size since
+ */
+void Game::restoreWorldState(const std::vector<Uint32>& state)
+{
+    const int count = particles->size();
+    const int capacity = world->getCapacity();
+
+    if (state.size() != (size_t)(WORLD_STATE_HEADER + count * 4 + capacity * WORLD_STATE_ENTITY) ||
+        (int)state[1] != count || (int)state[2] != capacity)
+    {
+        return;
+    }
+
+    const Uint32* in = state.data() + 3;
+
+    auto getArray = [&in, count](void* array)
+    {
+        memcpy(array, in, count * sizeof(Uint32));
+        in += count;
+    };
+
+    ticksRun = state[0];
+
+    ship->restoreHeading(Vec2(bitsFloat(in[0]), bitsFloat(in[1])),
+                         FixedVec2(Fixed::fromRaw(in[2]), Fixed::fromRaw(in[3])));
+    previousHeading = ship->getHeading();
+
+    backgroundScroll = bitsFloat(in[4]);
+    foregroundScroll = bitsFloat(in[5]);
+    in += 6;
+
+    // Offsetting by the difference wraps to exactly the offset that was saved, and marks
+    // the layers moved so their composites are redrawn
+    const SDL_Point backgroundOffset = background->getInnerLayerOffset(2);
+    const SDL_Point foregroundOffset = foreground->getScroll();
+
+    background->offsetInnerLayer(2, (int)in[0] - backgroundOffset.x, (int)in[1] - backgroundOffset.y);
+    foreground->scroll((int)in[2] - foregroundOffset.x, (int)in[3] - foregroundOffset.y);
+
+    if (tiles != nullptr)
+    {
+        const SDL_Point tileOffset = tiles->getScroll();
+        tiles->scroll((int)in[4] - tileOffset.x, (int)in[5] - tileOffset.y);
+    }
+
+    in += 6;
+
+    if (deterministic)
+    {
+        const FixedParticleArrays p = particles->getFixedArrays();
+        getArray(p.x);
+        getArray(p.y);
+        getArray(p.velocityX);
+        getArray(p.velocityY);
+
+        const ParticleArrays copy = particles->getArrays();
+
+        for (int i = 0; i < count; i++)
+        {
+            copy.x[i] = p.x[i].toFloat();
+            copy.y[i] = p.y[i].toFloat();
+            copy.velocityX[i] = p.velocityX[i].toFloat();
+            copy.velocityY[i] = p.velocityY[i].toFloat();
+        }
+    }
+    else
+    {
+        getArray(particles->getPositionsX());
+        getArray(particles->getPositionsY());
+        getArray(particles->getVelocitiesX());
+        getArray(particles->getVelocitiesY());
+    }
+
+    particles->savePositions();
+
+    for (int index = 0; index < capacity; index++)
+    {
+        const Uint32* slot = in + index;
+        const unsigned int mask = slot[0];
+        Entity entity = world->getEntity(index);
+
+        if (world->getMask(entity) != mask)
+        {
+            world->destroy(entity);
+
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            entity = world->createAt(index, mask);
+
+            if (mask & SPRITE)
+            {
+                world->get<Sprite>(entity)->texture = entitySprites[index];
+            }
+        }
+
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        if (mask & TRANSFORM)
+        {
+            Transform* transform = world->get<Transform>(entity);
+            transform->x = bitsFloat(slot[1 * capacity]);
+            transform->y = bitsFloat(slot[2 * capacity]);
+            transform->angle = bitsFloat(slot[3 * capacity]);
+        }
+
+        if (mask & VELOCITY)
+        {
+            Velocity* velocity = world->get<Velocity>(entity);
+            velocity->x = bitsFloat(slot[4 * capacity]);
+            velocity->y = bitsFloat(slot[5 * capacity]);
+            velocity->friction = bitsFloat(slot[6 * capacity]);
+            velocity->gravity = bitsFloat(slot[7 * capacity]);
+        }
+
+        if (mask & COLLIDER)
+        {
+            Collider* collider = world->get<Collider>(entity);
+            collider->midPoint = bitsFloat(slot[8 * capacity]);
+            collider->wrap = slot[9 * capacity] != 0;
+        }
+
+        if (mask & LIFETIME)
+        {
+            world->get<Lifetime>(entity)->remaining = bitsFloat(slot[10 * capacity]);
+        }
+
+        if (mask & BODY)
+        {
+            Body* body = world->get<Body>(entity);
+            body->x = Fixed::fromRaw(slot[11 * capacity]);
+            body->y = Fixed::fromRaw(slot[12 * capacity]);
+            body->velocityX = Fixed::fromRaw(slot[13 * capacity]);
+            body->velocityY = Fixed::fromRaw(slot[14 * capacity]);
+        }
+    }
+
+    if (renderer != nullptr)
+    {
+        collisionSystem->updateGrid(*world);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Steps the world back one tick while backspace is held, staying on the oldest tick kept
+ once it gets there. When it is let go the ticks after the one shown are dropped and the
+ game carries on from it
+
+ @returns True if the tick was spent rewinding instead of simulating
+ */
+bool Game::rewindTick()
+{
+    if (rewind == nullptr)
+    {
+        return false;
+    }
+
+    if (!rewinding)
+    {
+        rewind->truncate(rewindBack);
+        rewindBack = 0;
+        return false;
+    }
+
+    if (rewindBack + 1 < rewind->getCount() && rewind->seek(rewindBack + 1, worldState))
+    {
+        rewindBack++;
+        restoreWorldState(worldState);
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Builds the job graphs a tick runs. Particles and entities never touch each other, so the
+ particle stages and the entity stages run side by side, and each particle stage is split
+ into ranges across threads
+
+    collisions:  bounce particles -> update grid       update:  steer ship -> move particles
+                 collide entities -> file entities              move entities -> expire entities
+                                                                scroll layers
+ */
+void Game::createJobGraphs()
+{
+    collisionGraph = new JobGraph();
+
+    // Bounce every particle on the screen edges, each particle uses its own radius as the
+    // midpoint
+    int bounce = collisionGraph->add([this]() { return particles->size(); }, particleGrain,
+                                     [this](int begin, int end) { colDet->bounceScreen(particles, begin, end); });
+
+    // Keep the broad phase grid in step with the bounced particles, so particle vs
+    // particle checks only look at neighbouring cells
+    int grid = collisionGraph->add([this]() { colDet->updateGrid(particles); });
+    collisionGraph->precede(bounce, grid);
+
+    // Keep every entity with a collider on screen, then file the entities where they ended
+    // up so drawing only visits those in view. Headless games draw nothing so skip the
+    // filing
+    int collide = collisionGraph->add([this]() { collisionSystem->update(*world, *jobs); });
+
+    if (renderer != nullptr)
+    {
+        int fileEntities = collisionGraph->add([this]() { collisionSystem->updateGrid(*world); });
+        collisionGraph->precede(collide, fileEntities);
+    }
+
+    updateGraph = new JobGraph();
+
+    // Apply the user's input to the ship before the particles it lives among are moved
+    int steer = updateGraph->add([this]() { steerShip(tickDt); });
+    int move = updateGraph->add([this]() { return particles->size(); }, particleGrain,
+                                [this](int begin, int end) { particles->updateRange(tickDt, begin, end); });
+    updateGraph->precede(steer, move);
+
+    // Move every entity then expire the ones whose time is up
+    int moveEntities = updateGraph->add([this]() { movementSystem->update(*world, tickDt, *jobs); });
+    int expire = updateGraph->add([this]() { lifetimeSystem->update(*world, tickDt); });
+    updateGraph->precede(moveEntities, expire);
+
+    updateGraph->add([this]() { scrollLayers(tickDt); });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Calculate collision detection for each collision enabled object on screen
+
+ */
+void Game::getCollisions()
+{
+    jobs->run(*collisionGraph);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Advance the simulation by one tick, applying the user's input to the ship, moving every
+ particle and entity and scrolling the layers
+
+ @param dt  Length of the tick in 60hz frames
+ */
+void Game::update(float dt)
+{
+    tickDt = dt;
+
+    jobs->run(*updateGraph);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Remembers where the particles were and applies the user's input to the ship, then gets
+ the particles ready to be moved in ranges
+
+ @param dt  Length of the tick in 60hz frames
+ */
+void Game::steerShip(float dt)
+{
+    // Remember where everything was so frames can be interpolated within this tick
+    particles->savePositions();
+    previousHeading = ship->getHeading();
+
+    // Turn the ship's heading if a turn key is held and point its velocity along it
+    if(turningRight)
+    {
+        ship->turn(0.05f * dt);
+    }
+
+    if(turningLeft)
+    {
+        ship->turn(-0.05f * dt);
+    }
+
+    ship->steer();
+
+    // Make any modifications to the ships velocity
+    if (thrusting)
+    {
+        ship->accelerate(0.2 * dt);
+    }
+    else
+    {
+        ship->accelerate(0);
+    }
+
+    if (braking)
+    {
+        // Deterministic mode keeps libm out of the simulation, its last bits vary
+        const float keep = deterministic ? fixedPow(Fixed::fromFloat(1 - 0.075f), Fixed::fromFloat(dt)).toFloat()
+                                         : powf(1 - 0.075, dt);
+
+        ship->decelerate(1 - keep);
+    }
+
+    particles->prepareUpdate(dt);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Scrolls the second inner layer of the background 1 pixel on the y axis (downwards) and
+ the foreground 1 pixel on the x axis (right) per 60hz frame. The tile map scrolls down
+ with the background
+
+ @param dt  Length of the tick in 60hz frames
+ */
+void Game::scrollLayers(float dt)
+{
+    backgroundScroll += dt;
+    foregroundScroll += dt;
+
+    int backgroundStep = (int)backgroundScroll;
+    int foregroundStep = (int)foregroundScroll;
+
+    if (backgroundStep > 0)
+    {
+        background->offsetInnerLayer(2, 0, backgroundStep);
+        backgroundScroll -= backgroundStep;
+
+        if (tiles != nullptr)
+        {
+            tiles->scroll(0, backgroundStep);
+        }
+    }
+
+    // The foreground has one inner layer, so scrolling the whole layer is the same and
+    // only moves its source rects
+    if (foregroundStep > 0)
+    {
+        foreground->scroll(foregroundStep, 0);
+        foregroundScroll -= foregroundStep;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Centers the camera on the ship, between where it was at the start and end of the last
+ tick. The world wraps at the edges of the screen, so the camera never looks past them
+ and stays put when zoomed all the way out
+
+ @param alpha  How far the frame is between the previous and the current tick, 0 to 1
+ */
+void Game::updateCamera(float alpha)
+{
+    camera->centerOn(particles->getInterpolated(ship->getId(), alpha));
+
+    const Vec2 view = camera->getViewSize();
+    Vec2 position = camera->getPosition();
+
+    position.x = std::max(0.0f, std::min(position.x, SCREEN_WIDTH - view.x));
+    position.y = std::max(0.0f, std::min(position.y, SCREEN_HEIGHT - view.y));
+
+    camera->setPosition(position);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Render the current frame after any changes made by the game setup or user, such as
+ scrolling the background, or the heading / velocity of the ship. Moving things are drawn
+ part way between the last two ticks so motion stays smooth at any refresh rate
+
+ @param alpha  How far the frame is between the previous and the current tick, 0 to 1
+ */
+void Game::render(float alpha)
+{
+    // Clear the window
+    SDL_RenderClear(renderer);
+
+    if (rotationCache != nullptr)
+    {
+        rotationCache->nextFrame();
+    }
+
+    updateCamera(alpha);
+
+    {
+        PROFILE_SCOPE(profiler, Profiler::Layers);
+
+        if (tiles != nullptr)
+        {
+            tiles->render(*camera);
+        }
+        else
+        {
+            background->render(*camera);
+        }
+    }
+
+    // Draw every entity with a sprite in view
+    spriteSystem->render(*world, *camera, tickDt);
+
+    // Draw the ship between where it was at the start and end of the last tick
+    shipTexture->setDirection(lerp(previousHeading, ship->getHeading(), alpha).normalized());
+    ship->render(alpha, *camera);
+
+    // Draw every queued sprite before the foreground goes over them
+    spriteBatch->flush();
+
+    {
+        PROFILE_SCOPE(profiler, Profiler::Layers);
+        foreground->render(*camera);
+    }
+
+    profiler->drawOverlay(renderer, 8, 8);
+
+    // A low latency frame is ready before it is due, hold it back to keep the cadence
+    if (lowLatency)
+    {
+        waitUntil(frameDeadline);
+    }
+
+    // Render the frame with the above changes
+    PROFILE_SCOPE(profiler, Profiler::Present);
+    SDL_RenderPresent(renderer);
+
+    if (pressSimulated)
+    {
+        profiler->addLatency(SDL_GetTicks() - pressTime);
+        pressSimulated = false;
+    }
 }
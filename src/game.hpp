@@ -2,14 +2,41 @@
 #define GAME_HPP
 
 #include <string>
+#include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include <SDL.h>
 #include <SDL2_gfxPrimitives.h>
 #include "particle.hpp"
+#include "particlesystem.hpp"
 #include "texture.hpp"
+#include "atlas.hpp"
+#include "texturecache.hpp"
+#include "assetloader.hpp"
+#include "profiler.hpp"
+#include "spritebatch.hpp"
+#include "camera.hpp"
 #include "layer.hpp"
+#include "tilelayer.hpp"
 #include "coldet.hpp"
+#include "registry.hpp"
+#include "systems.hpp"
+#include "jobsystem.hpp"
+#include "pool.hpp"
+#include "alloccounter.hpp"
+#include "inputlog.hpp"
+#include "netserver.hpp"
+#include "netclient.hpp"
+#include "rewindbuffer.hpp"
+
+// Words of world state before the particles and per entity index, see saveWorldState
+#define WORLD_STATE_HEADER 15
+#define WORLD_STATE_ENTITY 15
+
+// Zoom a key press changes the camera by, and the closest it zooms in
+#define CAMERA_ZOOM_STEP 1.25f
+#define CAMERA_MAX_ZOOM 4.0f
 
 using std::string;
 
@@ -18,19 +45,139 @@ class Game
 private:
     SDL_Renderer* renderer;
 
+    // Every image is decoded and uploaded once and shared by all its users
+    TextureCache *textureCache;
+    AssetLoader *assetLoader;
+
+    // Images baked by the packer, mapped from next to the executable
+    AssetArchive *archive;
+
+    // Frame timings, shown with F3 and dumped on exit when output paths are set
+    Profiler *profiler;
+    string profileCsvPath, profileTracePath;
+
+    // Sprites are packed into an atlas and drawn in as few calls as possible
+    Atlas *atlas;
+    SpriteBatch *spriteBatch;
+
+    // Renderers that rotate slowly draw sprites from frames rotated once and kept
+    RotationCache *rotationCache = nullptr;
+
+    ParticleSystem *particles;
     Particle *ship;
+    Texture *shipTexture;
+
+    // Particles and textures come from fixed pools so spawning them never allocates
+    Pool<Particle> *particlePool;
+    Pool<Texture> *texturePool;
+    PoolHandle shipHandle, shipTextureHandle;
     ColDet *colDet;
     Layer *background, *foreground;
 
-    float angle = 0;
+    // Large maps are streamed in tiles around the camera instead of the background layer
+    TileLayer *tiles;
+    string tileMapPath;
+    long tileBudget = 0;
+
+    // Everything in the world is drawn through the camera, which skips what it cannot see.
+    // It follows the ship once zoomed in, the screen sized layers scroll with it
+    Camera *camera;
+
+    // Entities made of packed components, moved and drawn by systems
+    Registry *world;
+    MovementSystem *movementSystem;
+    CollisionSystem *collisionSystem;
+    LifetimeSystem *lifetimeSystem;
+    SpriteSystem *spriteSystem;
+
+    // Simulation stages run as job graphs across every core, the main thread pumps events
+    // and renders between ticks and helps run the jobs during them
+    JobSystem *jobs;
+    JobGraph *collisionGraph, *updateGraph;
+    float tickDt = 1;
+
+    // Particles per job when the particle system is split across threads
+    int particleGrain = 4096;
+
+    // Heading of the ship at the start of the tick, for drawing it turned part way
+    Vec2 previousHeading;
+
     bool quit, thrusting, braking, turningRight, turningLeft;
+
+    // Buttons held on the keyboard, the ship is steered by these or by a replayed log one
+    // tick at a time so a session can be recorded and played back exactly
+    Uint8 heldButtons = 0;
+    InputLog *inputLog;
+
+    // Debris particles and entities added to the world, placed by fixed seeds
+    int particleCount = 0, entityCount = 0;
+
+    // Deterministic mode simulates in fixed point so runs on different machines and builds
+    // stay bit identical. Every hashInterval ticks the state hash is printed to compare them
+    bool deterministic = false;
+    int hashInterval = 0, ticksRun = 0;
+
+    // A server simulates the entities and streams them to clients, a client draws the
+    // entities it is sent instead of simulating its own
+    NetServer *netServer = nullptr;
+    NetClient *netClient = nullptr;
+
+    // The last seconds of the world are kept so holding backspace scrubs back through
+    // them, letting go carries on from the tick shown. Sprites are not part of the state,
+    // the one each entity index last had is kept aside for entities that are put back
+    RewindBuffer *rewind = nullptr;
+    double rewindSeconds = 0;
+    long rewindBudget = 32 * 1024 * 1024;
+    std::vector<Uint32> worldState;
+    std::vector<Texture*> entitySprites;
+    int rewindBack = 0;
+    bool rewinding = false;
     int SCREEN_WIDTH, SCREEN_HEIGHT;
     const Uint8* currentKeyStates = SDL_GetKeyboardState( NULL );
 
+    // Fixed timestep, the simulation advances in ticks of 1 / tickRate seconds however
+    // fast frames are rendered. Frames longer than maxFrameTime are clamped so a stall
+    // cannot queue up more ticks than the machine can catch up on
+    int tickRate = 60;
+    double maxFrameTime = 0.25;
+
+    // Low latency mode paces frames itself instead of blocking in a vsynced present. It
+    // sleeps until presentSlack seconds before each frame is due and only then reads input
+    // and simulates, then holds the finished frame back to present on its deadline
+    bool lowLatency = false;
+    double framePeriod = 1.0 / 60, presentSlack = 0.004;
+    Uint64 frameDeadline = 0;
+
+    // The first steering key press not yet on screen, timed from when SDL saw it to the
+    // present of the first frame simulated with it
+    Uint32 pressTime = 0;
+    bool pressPending = false, pressSimulated = false;
+
+    // Layer scrolling accumulates fractions of a pixel when a tick is not 1 / 60 seconds
+    float backgroundScroll = 0, foregroundScroll = 0;
+
+    void loadAssets();
+    void createLayers();
     void createShip();
+    void createEntities(int count);
+    void createDebris(int count);
+    void createJobGraphs();
+    void steerShip(float dt);
+    void scrollLayers(float dt);
     void getEvents();
+    bool sampleInput();
+    void finishInputLog();
+    Uint64 getChecksum();
+    void reportTick();
+    void saveWorldState(std::vector<Uint32>& state);
+    void restoreWorldState(const std::vector<Uint32>& state);
+    bool rewindTick();
+    void updateNetClient();
+    void updateCamera(float alpha);
     void getCollisions();
-    void render();
+    void update(float dt);
+    void render(float alpha);
+    void waitUntil(Uint64 counter);
 
     #ifdef _WIN32
       const string DS = "\\";
@@ -40,8 +187,25 @@ private:
 
 public:
     Game(SDL_Renderer* renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT);
+    ~Game();
 
     void runGame();
+    bool runHeadless(int ticks);
+    void runServer(int ticks);
+    void runClient(int ticks);
+    void setPopulation(int particleCount, int entityCount);
+    bool setInputLog(const string& recordPath, const string& replayPath);
+    void setDeterministic(bool deterministic, int hashInterval);
+    bool setServer(int port, float interestRadius, int snapshotInterval, bool printStats);
+    bool setClient(const string& host, int port);
+    void setTickRate(int tickRate);
+    void setThreadCount(int threadCount);
+    void setMaxFrameTime(double maxFrameTime);
+    void setLowLatency(int refreshRate, double presentSlack);
+    void setProfileOutput(const string& csvPath, const string& tracePath);
+    void setTileMap(const string& path, long budget);
+    void setRotationCache(int steps, long budget);
+    void setRewind(double seconds, long budget);
 };
 
 
@@ -0,0 +1,276 @@
+#include "inputlog.hpp"
+
+#include <cstring>
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a log that is neither recording nor replaying
+
+ */
+InputLog::InputLog()
+{
+    memset(&header, 0, sizeof(header));
+    memset(&trailer, 0, sizeof(trailer));
+    current.buttons = 0;
+    current.ticks = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the log, a recording that was never finished is closed without a trailer
+
+ */
+InputLog::~InputLog()
+{
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts recording to a file, writing the scenario the recording is played in
+
+ @param path           Path of the log to write
+ @param tickRate       Simulation ticks per second
+ @param particleCount  Number of debris particles in the world
+ @param entityCount    Number of asteroid and bullet entities in the world
+ @param flags          InputLogFlag values the simulation is run with
+ @returns              False if the file could not be written
+ */
+bool InputLog::record(const std::string& path, int tickRate, int particleCount, int entityCount, Uint32 flags)
+{
+    file = fopen(path.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        printf("Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+
+    memcpy(header.magic, INPUT_LOG_MAGIC, 4);
+    header.version = INPUT_LOG_VERSION;
+    header.tickRate = tickRate;
+    header.particleCount = particleCount;
+    header.entityCount = entityCount;
+    header.flags = flags;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        printf("Failed to write %s\n", path.c_str());
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads a recorded log to play back
+
+ @param path  Path of the log
+ @returns     False if there is no log there or it is not one this version can read
+ */
+bool InputLog::replay(const std::string& path)
+{
+    FILE* input = fopen(path.c_str(), "rb");
+
+    if (input == nullptr)
+    {
+        printf("Failed to open %s\n", path.c_str());
+        return false;
+    }
+
+    if (fread(&header, sizeof(header), 1, input) != 1 || memcmp(header.magic, INPUT_LOG_MAGIC, 4) != 0 ||
+        header.version != INPUT_LOG_VERSION || header.tickRate == 0)
+    {
+        printf("%s is not an input log this version can read\n", path.c_str());
+        fclose(input);
+        return false;
+    }
+
+    runs.clear();
+    Uint32 ticks = 0;
+    int buttons;
+
+    while ((buttons = fgetc(input)) != EOF && buttons != INPUT_LOG_END)
+    {
+        Run run = {(Uint8)buttons, 0};
+        int byte, shift = 0;
+
+        do
+        {
+            byte = fgetc(input);
+            run.ticks |= (Uint32)(byte & 0x7F) << shift;
+            shift += 7;
+        }
+        while (byte != EOF && (byte & 0x80) && shift < 32);
+
+        if (byte == EOF)
+        {
+            break;
+        }
+
+        runs.push_back(run);
+        ticks += run.ticks;
+    }
+
+    complete = buttons == INPUT_LOG_END && fread(&trailer, sizeof(trailer), 1, input) == 1 && trailer.ticks == ticks;
+    fclose(input);
+
+    if (!complete)
+    {
+        printf("%s was not finished, replaying without a checksum\n", path.c_str());
+        trailer.ticks = ticks;
+        trailer.checksum = 0;
+    }
+
+    runIndex = 0;
+    runTick = 0;
+    replaying = true;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Writes the run of ticks that just ended
+
+ */
+void InputLog::writeRun()
+{
+    if (current.ticks == 0)
+    {
+        return;
+    }
+
+    Uint8 bytes[6];
+    int length = 0;
+    Uint32 ticks = current.ticks;
+
+    bytes[length++] = current.buttons;
+
+    do
+    {
+        bytes[length] = ticks & 0x7F;
+        ticks >>= 7;
+        bytes[length++] |= ticks > 0 ? 0x80 : 0;
+    }
+    while (ticks > 0);
+
+    fwrite(bytes, 1, length, file);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Records the buttons held for the next tick. Nothing is written until they change, so a
+ long stretch of the same input takes a few bytes
+
+ @param buttons   InputButton flags held during the tick
+ */
+void InputLog::write(Uint8 buttons)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    if (buttons != current.buttons)
+    {
+        writeRun();
+        current.buttons = buttons;
+        current.ticks = 0;
+    }
+
+    current.ticks++;
+    trailer.ticks++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the buttons recorded for the next tick
+
+ @param buttons   Set to the InputButton flags held during the tick
+ @returns         False once every recorded tick has been played
+ */
+bool InputLog::read(Uint8& buttons)
+{
+    while (runIndex < (int)runs.size() && runTick >= runs[runIndex].ticks)
+    {
+        runIndex++;
+        runTick = 0;
+    }
+
+    if (runIndex >= (int)runs.size())
+    {
+        return false;
+    }
+
+    buttons = runs[runIndex].buttons;
+    runTick++;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Ends a recording, writing the last run and the state the simulation ended in. Nothing
+ is written when replaying
+
+ @param checksum  Checksum of the simulation state after the last tick
+ */
+void InputLog::finish(Uint64 checksum)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    writeRun();
+    current.ticks = 0;
+    trailer.checksum = checksum;
+
+    fputc(INPUT_LOG_END, file);
+    fwrite(&trailer, sizeof(trailer), 1, file);
+
+    if (fclose(file) != 0)
+    {
+        printf("Failed to write the input log\n");
+    }
+
+    file = nullptr;
+    complete = true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets what the log is doing
+
+ */
+bool InputLog::isRecording() const { return file != nullptr; }
+bool InputLog::isReplaying() const { return replaying; }
+bool InputLog::hasChecksum() const { return complete; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the scenario and results of the recording
+
+ */
+int InputLog::getTickRate() const { return header.tickRate; }
+int InputLog::getParticleCount() const { return header.particleCount; }
+int InputLog::getEntityCount() const { return header.entityCount; }
+Uint32 InputLog::getFlags() const { return header.flags; }
+int InputLog::getTickCount() const { return trailer.ticks; }
+Uint64 InputLog::getChecksum() const { return trailer.checksum; }
@@ -0,0 +1,122 @@
+#ifndef inputlog_hpp
+#define inputlog_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+/**
+ Log layout, every field little endian:
+
+     InputLogHeader
+     runs of ticks with the same buttons held, each a buttons byte and a run length
+     INPUT_LOG_END, then InputLogTrailer
+
+ Run lengths are stored 7 bits per byte, low bits first, with the top bit set on every
+ byte but the last. A log cut short by a crash has no trailer, its runs still replay but
+ there is no checksum to compare against
+ */
+#define INPUT_LOG_MAGIC "SGIN"
+#define INPUT_LOG_VERSION 1
+#define INPUT_LOG_END 0xFF
+
+enum InputButton
+{
+    INPUT_THRUST = 1,
+    INPUT_BRAKE = 2,
+    INPUT_TURN_LEFT = 4,
+    INPUT_TURN_RIGHT = 8
+};
+
+
+// How the recorded simulation was run, logs from before these were added have none set
+enum InputLogFlag
+{
+    INPUT_LOG_DETERMINISTIC = 1
+};
+
+
+// Everything besides the input that decides how the simulation plays out
+struct InputLogHeader
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 tickRate;
+    Uint32 particleCount;
+    Uint32 entityCount;
+    Uint32 flags;
+};
+
+
+struct InputLogTrailer
+{
+    Uint32 ticks;
+    Uint32 reserved;
+
+    // Checksum of the simulation state after the last tick
+    Uint64 checksum;
+};
+
+static_assert(sizeof(InputLogHeader) == 24, "InputLogHeader must match the file layout");
+static_assert(sizeof(InputLogTrailer) == 16, "InputLogTrailer must match the file layout");
+
+
+/**
+ Records the buttons held on every simulation tick to a file, or plays a recorded file
+ back a tick at a time. With the same scenario and the same buttons on the same ticks
+ the simulation ends in exactly the same state
+ */
+class InputLog
+{
+private:
+    struct Run
+    {
+        Uint8 buttons;
+        Uint32 ticks;
+    };
+
+    InputLogHeader header;
+    InputLogTrailer trailer;
+    bool complete = false;
+
+    // Recording streams each run to the file as soon as the buttons change
+    FILE *file = nullptr;
+    Run current;
+
+    // Replaying reads every run up front and walks through them
+    std::vector<Run> runs;
+    int runIndex = 0;
+    Uint32 runTick = 0;
+    bool replaying = false;
+
+    InputLog(const InputLog&);
+    InputLog& operator=(const InputLog&);
+
+    void writeRun();
+
+public:
+    InputLog();
+    ~InputLog();
+
+    bool record(const std::string& path, int tickRate, int particleCount, int entityCount, Uint32 flags);
+    bool replay(const std::string& path);
+    void finish(Uint64 checksum);
+
+    void write(Uint8 buttons);
+    bool read(Uint8& buttons);
+
+    bool isRecording() const;
+    bool isReplaying() const;
+    bool hasChecksum() const;
+
+    int getTickRate() const;
+    int getParticleCount() const;
+    int getEntityCount() const;
+    Uint32 getFlags() const;
+    int getTickCount() const;
+    Uint64 getChecksum() const;
+};
+
+
+#endif /* inputlog_hpp */
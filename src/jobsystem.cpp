@@ -0,0 +1,467 @@
+#include "jobsystem.hpp"
+
+// Jobs each deque can hold before pushes run inline, enough for every chunk of a tick
+#define JOB_DEQUE_CAPACITY 4096
+
+// Times an idle worker looks for work again before it goes to sleep
+#define JOB_SPIN_COUNT 64
+
+// The job system and deque the current thread works for, unset on non-worker threads
+static thread_local JobSystem* currentSystem = nullptr;
+static thread_local int currentDeque = 0;
+
+
+/** --------------------------------------------------------------------------------------
+ Pushes a job onto the back of the deque
+
+ @param job  Job to push
+ @returns    False if the deque is full
+ */
+bool JobSystem::Deque::push(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (count == (int)jobs.size())
+    {
+        return false;
+    }
+
+    jobs[(front + count) % jobs.size()] = job;
+    count++;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Takes the job most recently pushed, the owner of the deque takes from here so the data it
+ just touched is likely still in cache
+
+ @param job  Set to the job taken
+ @returns    False if the deque is empty
+ */
+bool JobSystem::Deque::popBack(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    count--;
+    job = jobs[(front + count) % jobs.size()];
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Takes the oldest job, other threads steal from here so they take the opposite end of the
+ range to the owner
+
+ @param job  Set to the job taken
+ @returns    False if the deque is empty
+ */
+bool JobSystem::Deque::popFront(Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    job = jobs[front];
+    front = (front + 1) % jobs.size();
+    count--;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a job system with a number of worker threads
+
+ @param workerCount  Number of worker threads, 0 runs everything on the calling thread
+ */
+JobSystem::JobSystem(int workerCount)
+    : queued(0), sleeping(0)
+{
+    for (int i = 0; i <= workerCount; i++)
+    {
+        deques.push_back(std::unique_ptr<Deque>(new Deque(JOB_DEQUE_CAPACITY)));
+    }
+
+    for (int i = 0; i < workerCount; i++)
+    {
+        workers.push_back(std::thread(&JobSystem::work, this, i + 1));
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a job system with a worker for every hardware thread but the calling one,
+ which helps out whenever it waits for jobs
+
+ */
+JobSystem::JobSystem()
+    : JobSystem(SDL_GetCPUCount() > 1 ? SDL_GetCPUCount() - 1 : 0)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the job system, waking and joining every worker. Nothing may be running
+
+ */
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of threads that run jobs, the workers and the thread that waits
+
+ @returns Number of threads
+ */
+int JobSystem::getThreadCount() const { return workers.size() + 1; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the deque the calling thread pushes to and takes from first
+
+ @returns Index of the deque
+ */
+int JobSystem::getDequeIndex() const
+{
+    return currentSystem == this ? currentDeque : 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Worker thread loop, runs jobs until the job system is destroyed. A worker that finds no
+ work for a while sleeps until a job is queued
+
+ @param deque  Index of the deque the worker owns
+ */
+void JobSystem::work(int deque)
+{
+    currentSystem = this;
+    currentDeque = deque;
+
+    while (true)
+    {
+        bool ran = false;
+
+        for (int spin = 0; spin < JOB_SPIN_COUNT && !ran; spin++)
+        {
+            ran = runNextJob(deque);
+
+            if (!ran)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        if (ran)
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+
+        sleeping++;
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        sleeping--;
+
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Runs one job, from the back of a thread's own deque or else stolen from the front of any
+ other deque
+
+ @param deque  Index of the calling thread's deque
+ @returns      False if there was no job anywhere
+ */
+bool JobSystem::runNextJob(int deque)
+{
+    const int count = deques.size();
+    Job job;
+
+    if (deques[deque]->popBack(job))
+    {
+        queued--;
+        runJob(job);
+        return true;
+    }
+
+    for (int i = 1; i < count; i++)
+    {
+        if (deques[(deque + i) % count]->popFront(job))
+        {
+            queued--;
+            runJob(job);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Runs a job and finishes its task if it was the last chunk
+
+ @param job  Job to run
+ */
+void JobSystem::runJob(const Job& job)
+{
+    JobTask* task = job.task;
+
+    task->run(task->context, job.begin, job.end);
+
+    if (--task->pendingChunks == 0)
+    {
+        finish(task);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Splits a task whose dependencies have all finished into chunks and queues them on the
+ calling thread's deque, waking sleeping workers to steal them
+
+ @param task  Task to queue
+ */
+void JobSystem::schedule(JobTask* task)
+{
+    if (task->countFunction)
+    {
+        task->count = task->countFunction();
+    }
+
+    const int chunks = task->count > 0 ? (task->count + task->grain - 1) / task->grain : 0;
+
+    if (chunks == 0)
+    {
+        finish(task);
+        return;
+    }
+
+    task->pendingChunks = chunks;
+
+    Deque& deque = *deques[getDequeIndex()];
+    int pushed = 0;
+
+    for (int chunk = 0; chunk < chunks; chunk++)
+    {
+        Job job = {task, chunk * task->grain, std::min(task->count, (chunk + 1) * task->grain)};
+
+        if (deque.push(job))
+        {
+            queued++;
+            pushed++;
+        }
+        else
+        {
+            runJob(job);
+        }
+    }
+
+    // Sleepers check queued under the lock, so one that missed the increment is woken
+    if (pushed > 0 && sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+
+        if (pushed > 1)
+        {
+            wake.notify_all();
+        }
+        else
+        {
+            wake.notify_one();
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Marks a task as finished, queueing any task that was only waiting on it. The task may be
+ destroyed by its waiter as soon as the finished counter drops, so it is the last thing
+ touched
+
+ @param task  Task whose last chunk has run
+ */
+void JobSystem::finish(JobTask* task)
+{
+    for (JobTask* dependent : task->dependents)
+    {
+        if (--dependent->pendingDependencies == 0)
+        {
+            schedule(dependent);
+        }
+    }
+
+    if (task->finished != nullptr)
+    {
+        task->finished->fetch_sub(1);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Runs jobs on the calling thread until a counter reaches zero
+
+ @param counter  Counter of unfinished tasks to wait on
+ */
+void JobSystem::waitFor(std::atomic<int>& counter)
+{
+    const int deque = getDequeIndex();
+
+    while (counter.load() > 0)
+    {
+        if (!runNextJob(deque))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Runs every task of a graph, each one once all the tasks before it have finished, and
+ waits for the whole graph. The calling thread runs jobs too
+
+ @param graph  Graph to run
+ */
+void JobSystem::run(JobGraph& graph)
+{
+    if (graph.nodes.empty())
+    {
+        return;
+    }
+
+    graph.pending = graph.nodes.size();
+
+    // Reset every node before queueing any, a root can finish and release its dependents
+    // before the rest of the roots are queued
+    for (auto& node : graph.nodes)
+    {
+        node->task.pendingDependencies = node->task.dependencyCount;
+        node->task.finished = &graph.pending;
+    }
+
+    for (auto& node : graph.nodes)
+    {
+        if (node->task.dependencyCount == 0)
+        {
+            schedule(&node->task);
+        }
+    }
+
+    waitFor(graph.pending);
+}
+
+
+
+/** ======================================================================================
+ Constructs an empty job graph
+
+ */
+JobGraph::JobGraph()
+    : pending(0)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds a task that runs a function once
+
+ @param body  Function to run
+ @returns     Id of the task, for ordering it with precede
+ */
+int JobGraph::add(std::function<void()> body)
+{
+    return add([]() { return 1; }, 1, [body](int, int) { body(); });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds a task that runs a function over a range split into chunks
+
+ @param count  Called when the task is queued to get the number of items in the range
+ @param grain  Most items per chunk
+ @param body   Called as body(begin, end) for each chunk
+ @returns      Id of the task, for ordering it with precede
+ */
+int JobGraph::add(std::function<int()> count, int grain, std::function<void(int, int)> body)
+{
+    Node* node = new Node();
+
+    node->body = body;
+    node->task.countFunction = count;
+    node->task.grain = grain > 0 ? grain : 1;
+    node->task.context = node;
+    node->task.run = [](void* context, int begin, int end) { static_cast<Node*>(context)->body(begin, end); };
+
+    nodes.push_back(std::unique_ptr<Node>(node));
+
+    return nodes.size() - 1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Makes one task wait for another to finish before it starts
+
+ @param first  Id of the task that runs first
+ @param then   Id of the task that waits for it
+ */
+void JobGraph::precede(int first, int then)
+{
+    nodes[first]->task.dependents.push_back(&nodes[then]->task);
+    nodes[then]->task.dependencyCount++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of tasks in the graph
+
+ @returns Number of tasks
+ */
+int JobGraph::size() const { return nodes.size(); }
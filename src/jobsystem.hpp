@@ -0,0 +1,175 @@
+#ifndef jobsystem_hpp
+#define jobsystem_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <SDL.h>
+
+
+/**
+ A range of work split into chunks of grain items, each chunk is one job. Tasks can wait
+ on other tasks, a task is only split up and queued once every task it depends on has
+ finished
+ */
+struct JobTask
+{
+    void (*run)(void* context, int begin, int end);
+    void* context;
+    int count, grain;
+
+    // Worked out when the task is queued if set, for ranges whose size is only known once
+    // the tasks before them have run
+    std::function<int()> countFunction;
+
+    std::atomic<int> pendingChunks;
+    std::atomic<int> pendingDependencies;
+    int dependencyCount;
+    std::vector<JobTask*> dependents;
+
+    // Decremented once the task has finished, by whoever is waiting on it or its graph
+    std::atomic<int>* finished;
+
+    JobTask()
+        : run(nullptr), context(nullptr), count(0), grain(1), pendingChunks(0), pendingDependencies(0),
+          dependencyCount(0), finished(nullptr) {}
+
+private:
+    JobTask(const JobTask&);
+    JobTask& operator=(const JobTask&);
+};
+
+
+/**
+ A set of tasks and the order they have to run in. Tasks with no path between them run
+ at the same time. The graph is built once and run as often as needed, running it does not
+ allocate
+ */
+class JobGraph
+{
+private:
+    friend class JobSystem;
+
+    struct Node
+    {
+        JobTask task;
+        std::function<void(int, int)> body;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::atomic<int> pending;
+
+    JobGraph(const JobGraph&);
+    JobGraph& operator=(const JobGraph&);
+
+public:
+    JobGraph();
+
+    int add(std::function<void()> body);
+    int add(std::function<int()> count, int grain, std::function<void(int, int)> body);
+    void precede(int first, int then);
+    int size() const;
+};
+
+
+/**
+ Runs tasks on a worker per hardware thread. Every worker owns a deque of jobs, it takes
+ jobs from the back of its own deque and, when that is empty, steals from the front of
+ another worker's. Threads that are not workers, such as the main thread, queue into a
+ deque of their own and help run jobs while they wait, so they are never idle either
+ */
+class JobSystem
+{
+private:
+    struct Job
+    {
+        JobTask* task;
+        int begin, end;
+    };
+
+    // Fixed capacity ring buffer, a push to a full deque is run straight away instead
+    struct Deque
+    {
+        std::mutex mutex;
+        std::vector<Job> jobs;
+        int front = 0, count = 0;
+
+        explicit Deque(int capacity) : jobs(capacity) {}
+
+        bool push(const Job& job);
+        bool popBack(Job& job);
+        bool popFront(Job& job);
+    };
+
+    // Deque 0 is shared by every thread that is not a worker, worker i owns deque i + 1
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::vector<std::thread> workers;
+
+    // Jobs sitting in any deque, and workers asleep waiting for one
+    std::atomic<int> queued, sleeping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    int getDequeIndex() const;
+    bool runNextJob(int deque);
+    void runJob(const Job& job);
+    void schedule(JobTask* task);
+    void finish(JobTask* task);
+    void waitFor(std::atomic<int>& counter);
+    void work(int deque);
+
+public:
+    JobSystem(int workerCount);
+    JobSystem();
+    ~JobSystem();
+
+    int getThreadCount() const;
+    void run(JobGraph& graph);
+
+    /**
+     Runs a function over a range split into chunks across every thread and waits for all
+     of them. The calling thread runs chunks too. Small ranges are run on the calling
+     thread alone
+
+     @param count  Number of items in the range
+     @param grain  Most items per chunk, enough that a chunk outweighs queueing it
+     @param body   Called as body(begin, end) for each chunk
+     */
+    template <typename Function>
+    void parallelFor(int count, int grain, const Function& body)
+    {
+        if (count <= grain || workers.empty())
+        {
+            if (count > 0)
+            {
+                body(0, count);
+            }
+
+            return;
+        }
+
+        std::atomic<int> finished(1);
+
+        JobTask task;
+        task.run = [](void* context, int begin, int end) { (*static_cast<const Function*>(context))(begin, end); };
+        task.context = const_cast<Function*>(&body);
+        task.count = count;
+        task.grain = grain;
+        task.finished = &finished;
+
+        schedule(&task);
+        waitFor(finished);
+    }
+};
+
+
+#endif /* jobsystem_hpp */
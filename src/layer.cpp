@@ -1,15 +1,101 @@
 #include "layer.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include "compositekernel.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Draws a screen sized image wrapped around at an offset, so the part pushed off one edge
+ comes back in on the opposite edge. The screen is split where the image wraps and each
+ piece copies only the part of the image it shows, so every screen pixel is drawn once and
+ nothing off screen is submitted. That is up to four copies when offset on both axes
+
+ @param renderer      Renderer to draw with
+ @param texture       Image to draw, stretched to the screen
+ @param textureWidth  Width of the image in pixels
+ @param textureHeight Height of the image in pixels
+ @param SCREEN_WIDTH  Width of the screen
+ @param SCREEN_HEIGHT Height of the screen
+ @param offsetX       How far the image is shifted right, any value
+ @param offsetY       How far the image is shifted down, any value
+ */
+static void renderWrapped(SDL_Renderer *renderer, SDL_Texture *texture, int textureWidth, int textureHeight,
+                          int SCREEN_WIDTH, int SCREEN_HEIGHT, int offsetX, int offsetY)
+{
+    const int x = ((offsetX % SCREEN_WIDTH) + SCREEN_WIDTH) % SCREEN_WIDTH;
+    const int y = ((offsetY % SCREEN_HEIGHT) + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+
+    // Spans of the screen as {screen start, image start, length}, the left / top span
+    // shows the end of the image that wrapped around
+    const int columns[2][3] = {{0, SCREEN_WIDTH - x, x}, {x, 0, SCREEN_WIDTH - x}};
+    const int rows[2][3] = {{0, SCREEN_HEIGHT - y, y}, {y, 0, SCREEN_HEIGHT - y}};
+
+    for (const auto& row : rows)
+    {
+        for (const auto& column : columns)
+        {
+            if (column[2] == 0 || row[2] == 0)
+            {
+                continue;
+            }
+
+            // Images need not be the size of the screen, scale the span into the image
+            const int sourceX = column[1] * textureWidth / SCREEN_WIDTH;
+            const int sourceY = row[1] * textureHeight / SCREEN_HEIGHT;
+
+            SDL_Rect source = {sourceX, sourceY,
+                               (column[1] + column[2]) * textureWidth / SCREEN_WIDTH - sourceX,
+                               (row[1] + row[2]) * textureHeight / SCREEN_HEIGHT - sourceY};
+            SDL_Rect destination = {column[0], row[0], column[2], row[2]};
+
+            SDL_RenderCopy(renderer, texture, &source, &destination);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Loads an image for CPU side use, from the archive if it is there and from its file if not
+
+ @param textureCache  Texture cache whose archive to look in
+ @param path          Path of the image file
+ @returns             The surface for the caller to free, nullptr if it could not be loaded
+ */
+static SDL_Surface* loadSurface(TextureCache *textureCache, const std::string& path)
+{
+    AssetArchive* archive = textureCache->getArchive();
+    const ArchiveEntry* entry = archive != nullptr ? archive->find(path) : nullptr;
+
+    if (entry != nullptr)
+    {
+        return archive->createSurface(entry);
+    }
+
+    SDL_Surface* surface = IMG_Load(path.c_str());
+
+    if (surface == nullptr)
+    {
+        printf("Failed to load %s: %s\n", path.c_str(), IMG_GetError());
+    }
+
+    return surface;
+}
+
+
+
 /** --------------------------------------------------------------------------------------
  Constructs a layer which acts as a container for an arbitrary number of textured inner
  layers
 
- @param renderer      Renderer to send the texture to
+ @param textureCache  Texture cache the layer images are loaded through, its renderer is
+                      the one the layer is sent to
  @param SCREEN_WIDTH  The total width of the screen
  @param SCREEN_HEIGHT The total height of the screen
  */
-Layer::Layer(SDL_Renderer *renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT)
-    : renderer(renderer), SCREEN_WIDTH(SCREEN_WIDTH), SCREEN_HEIGHT(SCREEN_HEIGHT)
+Layer::Layer(TextureCache *textureCache, int SCREEN_WIDTH, int SCREEN_HEIGHT)
+    : renderer(textureCache->getRenderer()), textureCache(textureCache),
+      SCREEN_WIDTH(SCREEN_WIDTH), SCREEN_HEIGHT(SCREEN_HEIGHT)
 {
 }
 
@@ -23,22 +109,20 @@ Layer::Layer(SDL_Renderer *renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT)
 
 void Layer::addLayer(const char* file)
 {
-    // Create output rectangle, 2 rectangles per layer, that each have the same texture
-    // Second fills screen entirely as first is reset and first fills screen entirely as
-    // second is reset and so on.
-    SDL_Rect textureRectA = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
-    SDL_Rect textureRectB = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    // Get the texture through the cache so an image used by several layers is only
+    // decoded once. Headless games have no renderer, the inner layer then only tracks
+    // its offsets
+    innerLayers.push_back(InnerLayer(textureCache->load(file)));
+    paths.push_back(file);
 
-    // Create SDL surface from image
-    SDL_Surface* surface = IMG_Load(file);
+    compositeDirty = true;
 
-    // Create hardware optimised SDL texture from the surface
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-
-    // Free the surface after texture is made
-    SDL_FreeSurface(surface);
-
-    innerLayers.push_back(InnerLayer(texture, textureRectA, textureRectB));
+    // Made again on the next render with the new inner layer's pixels
+    if (framebuffer != nullptr)
+    {
+        SDL_DestroyTexture(framebuffer);
+        framebuffer = nullptr;
+    }
 }
 
 
@@ -49,10 +133,17 @@ void Layer::addLayer(const char* file)
  */
 Layer::~Layer()
 {
-    //for(InnerLayer& innerLayer : innerLayers)
-    //{
-    //    innerLayer.~InnerLayer();
-    //}
+    // Inner layers hold shared handles to their textures, which are destroyed by the
+    // texture cache once no layer or texture uses them any more
+    if (composite != nullptr)
+    {
+        SDL_DestroyTexture(composite);
+    }
+
+    if (framebuffer != nullptr)
+    {
+        SDL_DestroyTexture(framebuffer);
+    }
 }
 
 
@@ -63,11 +154,17 @@ void Layer::offsetInnerLayer(int innerLayerNo, int xOffset, int yOffset)
     {
         if (xOffset != 0)
         {
-            innerLayers.at(innerLayerNo - 1).setXoffset(xOffset, SCREEN_WIDTH, SCREEN_HEIGHT);
+            innerLayers.at(innerLayerNo - 1).setXoffset(xOffset, SCREEN_WIDTH, SCREEN_HEIGHT, renderCount);
         }
         if (yOffset != 0)
         {
-          innerLayers.at(innerLayerNo - 1).setYoffset(yOffset, SCREEN_WIDTH, SCREEN_HEIGHT);
+          innerLayers.at(innerLayerNo - 1).setYoffset(yOffset, SCREEN_WIDTH, SCREEN_HEIGHT, renderCount);
+        }
+
+        // The composite still shows this inner layer where it was
+        if (innerLayerNo <= compositedCount)
+        {
+            compositeDirty = true;
         }
     }
 }
@@ -75,14 +172,349 @@ void Layer::offsetInnerLayer(int innerLayerNo, int xOffset, int yOffset)
 
 
 /** --------------------------------------------------------------------------------------
- Render the layer with an arbitrary amount of inner layers
+ Scrolls the whole layer, every inner layer moves together. Only the source rects change,
+ a composited layer is not redrawn into its render target
+
+ @param xOffset   Amount to scroll right, negative scrolls left
+ @param yOffset   Amount to scroll down, negative scrolls up
+ */
+void Layer::scroll(int xOffset, int yOffset)
+{
+    scrollX = (scrollX + xOffset) % SCREEN_WIDTH;
+    scrollY = (scrollY + yOffset) % SCREEN_HEIGHT;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Turns compositing of the still inner layers into one render target on or off. Layers
+ fall back to drawing every inner layer if the renderer has no render targets
+
+ @param composited    True to composite
+ */
+void Layer::setComposited(bool composited)
+{
+    this->composited = composited;
+    compositeDirty = true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Turns compositing every inner layer on the CPU on or off, for renderers without
+ acceleration, which are slow to blend whole screen images. It takes over from the render
+ target composite for layers with more than one inner layer. The job system must outlive
+ the layer
+
+ @param jobs  Job system to split the rows across, nullptr to draw with the renderer
+ */
+void Layer::setSoftwareComposited(JobSystem *jobs)
+{
+    this->jobs = jobs;
+    compositeDirty = true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets how far the layer moves with the camera, so layers further away move less
+
+ @param parallax  Screen pixels the layer moves per world unit the camera moves
+ */
+void Layer::setParallax(float parallax)
+{
+    this->parallax = parallax;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Marks the composite as lost so it is redrawn on the next render, for example when the
+ renderer reports its render targets were reset
+
+ */
+void Layer::invalidate()
+{
+    compositeDirty = true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of times the composite has been redrawn
+
+ @returns Number of times the still inner layers were drawn into the render target
+ */
+int Layer::getCompositeCount() const { return compositeCount; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how far an inner layer is offset, to offset it back there later
+
+ @param innerLayerNo  Number of the inner layer, starting at 1
+ @returns             Offset of the inner layer, 0, 0 if there is no such inner layer
+ */
+SDL_Point Layer::getInnerLayerOffset(int innerLayerNo) const
+{
+    if (innerLayerNo < 1 || innerLayerNo > (int)innerLayers.size())
+    {
+        SDL_Point none = {0, 0};
+        return none;
+    }
+
+    return innerLayers[innerLayerNo - 1].getOffset();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how far the whole layer is scrolled
+
+ @returns Scroll of the layer, wrapped to within one screen
+ */
+SDL_Point Layer::getScroll() const
+{
+    SDL_Point point = {scrollX, scrollY};
+    return point;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates the render target the still inner layers are composited into. The layers are
+ blended into a transparent target, which leaves it holding premultiplied alpha, so it is
+ drawn with a premultiplied blend mode
+
+ @returns False if the renderer cannot render to a texture
+ */
+bool Layer::createComposite()
+{
+    if (composite != nullptr)
+    {
+        return true;
+    }
+
+    if (!SDL_RenderTargetSupported(renderer))
+    {
+        printf("Renderer has no render targets, layers are not composited\n");
+        composited = false;
+        return false;
+    }
+
+    composite = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                  SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    if (composite == nullptr)
+    {
+        printf("Failed to create layer composite: %s\n", SDL_GetError());
+        composited = false;
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(composite, SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD));
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws the bottom inner layers into the composite at their own offsets
+
+ @param count   Number of inner layers from the bottom to composite
+ */
+void Layer::updateComposite(int count)
+{
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    Uint8 r, g, b, a;
+
+    SDL_SetRenderTarget(renderer, composite);
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+    for (int i = 0; i < count; i++)
+    {
+        innerLayers[i].render(renderer, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0);
+    }
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+
+    compositedCount = count;
+    compositeDirty = false;
+    compositeCount++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Makes the CPU copies of the inner layer images and the streaming texture they are
+ composited into. When the bottom inner layer is opaque so is the result, and it is drawn
+ without blending
+
+ @returns False if the texture could not be created
  */
-void Layer::render()
+bool Layer::createFramebuffer()
 {
-  for(const InnerLayer& innerLayer : innerLayers)
+    if (framebuffer != nullptr)
+    {
+        return true;
+    }
+
+    framebuffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                    SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    if (framebuffer == nullptr)
+    {
+        printf("Failed to create layer framebuffer: %s\n", SDL_GetError());
+        jobs = nullptr;
+        return false;
+    }
+
+    for (size_t i = 0; i < innerLayers.size(); i++)
+    {
+        SDL_Surface* surface = loadSurface(textureCache, paths[i]);
+
+        innerLayers[i].setPixels(surface, SCREEN_WIDTH, SCREEN_HEIGHT);
+        SDL_FreeSurface(surface);
+    }
+
+    SDL_SetTextureBlendMode(framebuffer, innerLayers[0].isOpaque() ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+
+    printf("Compositing %d layers on the CPU (%s)\n", (int)innerLayers.size(), CompositeKernel::getPathName());
+
+    compositeDirty = true;
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Blends every inner layer at its offset into the streaming texture, rows split across the
+ job system. The rows are blended in the locked texture itself, which for the software
+ renderer is plain memory
+
+ */
+void Layer::updateFramebuffer()
+{
+    void* pixels;
+    int pitch;
+
+    if (SDL_LockTexture(framebuffer, nullptr, &pixels, &pitch) != 0)
+    {
+        printf("Failed to lock layer framebuffer: %s\n", SDL_GetError());
+        return;
+    }
+
+    Uint8* rows = static_cast<Uint8*>(pixels);
+    const bool opaque = innerLayers[0].isOpaque();
+
+    jobs->parallelFor(SCREEN_HEIGHT, LAYER_ROWS_PER_JOB, [this, rows, pitch, opaque](int begin, int end)
+    {
+        for (int y = begin; y < end; y++)
+        {
+            Uint32* row = reinterpret_cast<Uint32*>(rows + y * pitch);
+
+            for (size_t i = 0; i < innerLayers.size(); i++)
+            {
+                innerLayers[i].composite(row, y, SCREEN_WIDTH, SCREEN_HEIGHT, scrollX, scrollY, i == 0);
+            }
+
+            // The renderer blends plain alpha
+            if (!opaque)
+            {
+                CompositeKernel::unpremultiply(row, SCREEN_WIDTH);
+            }
+        }
+    });
+
+    SDL_UnlockTexture(framebuffer);
+
+    framebufferScrollX = scrollX;
+    framebufferScrollY = scrollY;
+    compositeDirty = false;
+    compositeCount++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Render the layer with an arbitrary amount of inner layers. When composited, the inner
+ layers at the bottom that did not move since the last frame come from the composite,
+ which is only redrawn when that set of layers changes. The layer is scrolled against the
+ camera's position by its parallax, and being far away it is not zoomed
+
+ @param camera  Camera to draw through
+ */
+void Layer::render(const Camera& camera)
+{
+  if (renderer == nullptr)
+  {
+      return;
+  }
+
+  // Moving the camera only changes where the images are wrapped, nothing is redrawn
+  const Vec2 position = camera.getPosition() * parallax;
+  const int cameraX = -(int)floorf(position.x + 0.5f);
+  const int cameraY = -(int)floorf(position.y + 0.5f);
+
+  // Blended on the CPU and drawn in one copy, only blended again once something moved
+  if (jobs != nullptr && innerLayers.size() >= 2 && createFramebuffer())
+  {
+      bool moved = compositeDirty || scrollX != framebufferScrollX || scrollY != framebufferScrollY;
+
+      for (const InnerLayer& innerLayer : innerLayers)
+      {
+          moved = moved || innerLayer.getMovedAt() >= renderCount;
+      }
+
+      if (moved)
+      {
+          updateFramebuffer();
+      }
+
+      renderWrapped(renderer, framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT,
+                    cameraX, cameraY);
+
+      renderCount++;
+      return;
+  }
+
+  int first = 0;
+
+  if (composited)
   {
-      innerLayer.render(renderer);
+      int still = 0;
+
+      while (still < (int)innerLayers.size() && innerLayers[still].getMovedAt() < renderCount)
+      {
+          still++;
+      }
+
+      // A single layer costs the same drawn directly as drawn from the composite
+      if (still >= 2 && createComposite())
+      {
+          if (compositeDirty || still != compositedCount)
+          {
+              updateComposite(still);
+          }
+
+          renderWrapped(renderer, composite, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT,
+                        scrollX + cameraX, scrollY + cameraY);
+          first = still;
+      }
   }
+
+  for (int i = first; i < (int)innerLayers.size(); i++)
+  {
+      innerLayers[i].render(renderer, SCREEN_WIDTH, SCREEN_HEIGHT, scrollX + cameraX, scrollY + cameraY);
+  }
+
+  renderCount++;
 }
 
 
@@ -90,113 +522,181 @@ void Layer::render()
 /** ======================================================================================
  Constructs a new inner layer
 
- @param texture     Texture to use for the new inner layer
- @param textureRectA Primary texture rect which contains the texture
- @param textureRectB Secondary texture rect, follows the primary texture rect when it is
-                     offset and fills what would otherwise be empty space with the texture
+ @param texture     Texture to use for the new inner layer, stretched to the screen
  */
-InnerLayer::InnerLayer(SDL_Texture* texture, SDL_Rect textureRectA, SDL_Rect textureRectB)
-    : texture(texture), textureRectA(textureRectA), textureRectB(textureRectB)
+InnerLayer::InnerLayer(std::shared_ptr<SDL_Texture> texture)
+    : texture(texture)
 {
+    if (texture != nullptr)
+    {
+        SDL_QueryTexture(texture.get(), nullptr, nullptr, &textureWidth, &textureHeight);
+    }
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Offsets the inner layer on the horizontal x axis
+ Offsets the inner layer on the horizontal x axis, the image wraps around so whatever
+ goes off one side comes back in on the other
 
- @param yOffset         Horizontal offset to apply to the inner layer
+ @param xOffset         Horizontal offset to apply to the inner layer
  @param SCREEN_WIDTH    Width of the screen
  @param SCREEN_HEIGHT   Height of the screen
+ @param renderCount     Number of times the layer has rendered, to tell when it moved
  */
-void InnerLayer::setXoffset(int xOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT)
+void InnerLayer::setXoffset(int xOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT, int renderCount)
 {
-    // Move the primary texture rect of this inner layer by the specified amount, either
-    // negatively (left) or positively (right)
-    textureRectA.x += xOffset;
+    offsetX = (offsetX + xOffset) % SCREEN_WIDTH;
+    movedAt = renderCount;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Offsets the inner layer on the vertical y axis, the image wraps around so whatever goes
+ off the top or bottom comes back in on the other
+
+ @param yOffset         Vertical offset to apply to the inner layer
+ @param SCREEN_WIDTH    Width of the screen
+ @param SCREEN_HEIGHT   Height of the screen
+ @param renderCount     Number of times the layer has rendered, to tell when it moved
+ */
+void InnerLayer::setYoffset(int yOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT, int renderCount)
+{
+    offsetY = (offsetY + yOffset) % SCREEN_HEIGHT;
+    movedAt = renderCount;
+}
 
-    // If the inner layer is being moved by a negative value (to the left)
-    if (xOffset < 0)
+
+
+/** --------------------------------------------------------------------------------------
+ Keeps a copy of the image for compositing on the CPU, stretched to the screen like the
+ renderer draws it and with its colors premultiplied by alpha
+
+ @param surface         Image, nullptr leaves the inner layer see through
+ @param SCREEN_WIDTH    Width of the screen
+ @param SCREEN_HEIGHT   Height of the screen
+ */
+void InnerLayer::setPixels(SDL_Surface* surface, int SCREEN_WIDTH, int SCREEN_HEIGHT)
+{
+    pixels.assign(SCREEN_WIDTH * SCREEN_HEIGHT, 0);
+    opaque = false;
+
+    SDL_Surface* converted = surface != nullptr ? SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0) : nullptr;
+
+    if (converted == nullptr)
     {
-        // After negative (to left) offset is done, test to see if the right edge of the
-        // primary texture srect is off the screen
-        if (textureRectA.x + SCREEN_WIDTH < 0)
-        {
-            // If it is off the screen then add the width of the screen to the value,
-            // essentially resetting its position
-            textureRectA.x += SCREEN_WIDTH;
-        }
-        // We're using a negative value (moving inner layer left) so the second texture
-        // rect needs to come in from the right
-        textureRectB.x = (textureRectA.x + SCREEN_WIDTH);
-    }
-    // Otherwise the inner layer is being moved by a positive value (to the right)
-    else
-    {
-        // After positive (to right) offset is done, test to see if the left edge of the
-        // primary texture rect is off the screen
-        if (textureRectA.x > SCREEN_WIDTH)
-        {
-            // If it is off the screen then subtract the width of the screen from the
-            // value, essentially resetting its position
-            textureRectA.x -= SCREEN_WIDTH;
-        }
-        // We're using a positive value (moving inner layer right) so the second texture
-        // rect needs to come in from the left
-        textureRectB.x = (textureRectA.x - SCREEN_WIDTH);
+        return;
     }
+
+    SDL_Surface* screen = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), SCREEN_WIDTH, SCREEN_HEIGHT, 32,
+                                                             SCREEN_WIDTH * 4, SDL_PIXELFORMAT_ARGB8888);
+
+    // Copy alpha as it is instead of blending onto the empty pixels
+    SDL_SetSurfaceBlendMode(converted, SDL_BLENDMODE_NONE);
+    SDL_BlitScaled(converted, nullptr, screen, nullptr);
+
+    SDL_FreeSurface(screen);
+    SDL_FreeSurface(converted);
+
+    opaque = std::all_of(pixels.begin(), pixels.end(), [](Uint32 pixel) { return (pixel >> 24) == 255; });
+
+    CompositeKernel::premultiply(pixels.data(), pixels.size());
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Offsets the inner layer on the vertical y axis
+ Blends one row of the inner layer into a row of the screen, wrapped at its offset plus
+ the scroll of its layer the same way render draws it
 
- @param yOffset         Horizontal offset to apply to the inner layer
+ @param row             Row of premultiplied pixels to blend into
+ @param y               Row of the screen
  @param SCREEN_WIDTH    Width of the screen
  @param SCREEN_HEIGHT   Height of the screen
+ @param scrollX         Horizontal scroll of the whole layer
+ @param scrollY         Vertical scroll of the whole layer
+ @param bottom          True to copy the row in place of what is there instead of blending
  */
-void InnerLayer::setYoffset(int yOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT)
+void InnerLayer::composite(Uint32* row, int y, int SCREEN_WIDTH, int SCREEN_HEIGHT, int scrollX, int scrollY,
+                           bool bottom) const
 {
-    textureRectA.y += yOffset;
-
-    if (yOffset < 0)
+    if (pixels.empty())
     {
-        if (textureRectA.y + SCREEN_HEIGHT < 0)
+        if (bottom)
         {
-            textureRectA.y += SCREEN_HEIGHT;
+            memset(row, 0, SCREEN_WIDTH * sizeof(Uint32));
         }
-        textureRectB.y = (textureRectA.y + SCREEN_HEIGHT);
+
+        return;
+    }
+
+    const int x = (((offsetX + scrollX) % SCREEN_WIDTH) + SCREEN_WIDTH) % SCREEN_WIDTH;
+    const int sourceY = (((y - offsetY - scrollY) % SCREEN_HEIGHT) + SCREEN_HEIGHT) % SCREEN_HEIGHT;
+    const Uint32* source = pixels.data() + sourceY * SCREEN_WIDTH;
+
+    // The left of the screen shows the end of the image row that wrapped around
+    if (bottom)
+    {
+        memcpy(row, source + SCREEN_WIDTH - x, x * sizeof(Uint32));
+        memcpy(row + x, source, (SCREEN_WIDTH - x) * sizeof(Uint32));
     }
     else
     {
-        if (textureRectA.y - SCREEN_HEIGHT > 0)
-        {
-            textureRectA.y -= SCREEN_HEIGHT;
-        }
-        textureRectB.y = (textureRectA.y - SCREEN_HEIGHT);
+        CompositeKernel::blend(row, source + SCREEN_WIDTH - x, x);
+        CompositeKernel::blend(row + x, source, SCREEN_WIDTH - x);
     }
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Render the layer with one, two, three or four textures.
+ Gets whether every pixel of the CPU copy of the image is opaque
+
+ */
+bool InnerLayer::isOpaque() const { return opaque; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets when the inner layer was last offset
+
+ @returns Render count of the layer at the time, -1 if it never moved
+ */
+int InnerLayer::getMovedAt() const { return movedAt; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how far the inner layer is offset
+
+ @returns Offset of the image, wrapped to within one screen
  */
-void InnerLayer::render(SDL_Renderer *renderer) const
+SDL_Point InnerLayer::getOffset() const
 {
-    SDL_RenderCopy(renderer, texture, nullptr, &textureRectA);
-    SDL_RenderCopy(renderer, texture, nullptr, &textureRectB);
+    SDL_Point point = {offsetX, offsetY};
+    return point;
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Deconstructs an inner layer
+ Render the inner layer wrapped at its offset plus the scroll of its layer, with one, two,
+ three or four copies depending on where it wraps
 
+ @param renderer        Renderer to draw with
+ @param SCREEN_WIDTH    Width of the screen
+ @param SCREEN_HEIGHT   Height of the screen
+ @param scrollX         Horizontal scroll of the whole layer
+ @param scrollY         Vertical scroll of the whole layer
  */
-InnerLayer::~InnerLayer()
+void InnerLayer::render(SDL_Renderer *renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT, int scrollX, int scrollY) const
 {
-    //SDL_DestroyTexture(texture);
-    //texture = nullptr;
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    renderWrapped(renderer, texture.get(), textureWidth, textureHeight, SCREEN_WIDTH, SCREEN_HEIGHT,
+                  offsetX + scrollX, offsetY + scrollY);
 }
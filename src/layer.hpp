@@ -1,25 +1,47 @@
 #ifndef layer_hpp
 #define layer_hpp
 
+#include <stdio.h>
 #include <vector>
 #include <SDL.h>
 #include <SDL_image.h>
 #include <string>
+#include <memory>
+#include "texturecache.hpp"
+#include "jobsystem.hpp"
+#include "camera.hpp"
+
+// Rows of the screen per job when layers are composited on the CPU
+#define LAYER_ROWS_PER_JOB 16
 
 
 class InnerLayer
 {
 private:
-    SDL_Texture *texture;
-    SDL_Rect textureRectA, textureRectB;
+    std::shared_ptr<SDL_Texture> texture;
+    int textureWidth = 0, textureHeight = 0;
+
+    // How far the image is scrolled right and down, wrapped to within one screen
+    int offsetX = 0, offsetY = 0;
+
+    // Render count of the layer when this inner layer was last offset
+    int movedAt = -1;
+
+    // Screen sized copy of the image with premultiplied alpha, for compositing on the CPU
+    std::vector<Uint32> pixels;
+    bool opaque = false;
 
 public:
-    InnerLayer(SDL_Texture* texture, SDL_Rect textureRectA, SDL_Rect textureRectB);
-    ~InnerLayer();
+    InnerLayer(std::shared_ptr<SDL_Texture> texture);
 
-    void render(SDL_Renderer *renderer) const;
-    void setXoffset(int SCREEN_WIDTH, int SCREEN_HEIGHT, int xOffset);
-    void setYoffset(int SCREEN_WIDTH, int SCREEN_HEIGHT, int yOffset);
+    void render(SDL_Renderer *renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT, int scrollX, int scrollY) const;
+    void setPixels(SDL_Surface* surface, int SCREEN_WIDTH, int SCREEN_HEIGHT);
+    void composite(Uint32* row, int y, int SCREEN_WIDTH, int SCREEN_HEIGHT, int scrollX, int scrollY, bool bottom) const;
+    bool isOpaque() const;
+    void setXoffset(int xOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT, int renderCount);
+    void setYoffset(int yOffset, int SCREEN_WIDTH, int SCREEN_HEIGHT, int renderCount);
+    int getMovedAt() const;
+    SDL_Point getOffset() const;
 };
 
 
@@ -27,16 +49,52 @@ class Layer
 {
 private:
     SDL_Renderer *renderer;
+    TextureCache *textureCache;
     int SCREEN_WIDTH, SCREEN_HEIGHT;
     std::vector<InnerLayer> innerLayers;
+    std::vector<std::string> paths;
+
+    // Whole layer scroll, applied to every inner layer and the composite when drawing
+    int scrollX = 0, scrollY = 0;
+
+    // How far the layer moves for each world unit the camera moves, less than 1 behind the
+    // world and more than 1 in front of it
+    float parallax = 1;
+
+    // Inner layers at the bottom that have not moved since the last frame are drawn into
+    // one render target texture once and that is drawn instead, until one of them moves
+    bool composited = false;
+    SDL_Texture *composite = nullptr;
+    int compositedCount = 0;
+    bool compositeDirty = true;
+    int renderCount = 0, compositeCount = 0;
+
+    // Renderers without acceleration blend every inner layer on the CPU instead, split into
+    // row ranges across the job system, and upload the result to one streaming texture
+    JobSystem *jobs = nullptr;
+    SDL_Texture *framebuffer = nullptr;
+    int framebufferScrollX = 0, framebufferScrollY = 0;
+
+    bool createComposite();
+    void updateComposite(int count);
+    bool createFramebuffer();
+    void updateFramebuffer();
 
 public:
-    Layer(SDL_Renderer *renderer, int SCREEN_WIDTH, int SCREEN_HEIGHT);
+    Layer(TextureCache *textureCache, int SCREEN_WIDTH, int SCREEN_HEIGHT);
     ~Layer();
 
     void offsetInnerLayer(int innerLayerNo, int xOffset, int yOffset);
+    void scroll(int xOffset, int yOffset);
     void addLayer(const char* file);
-    void render();
+    void setComposited(bool composited);
+    void setSoftwareComposited(JobSystem *jobs);
+    void setParallax(float parallax);
+    void invalidate();
+    int getCompositeCount() const;
+    SDL_Point getInnerLayerOffset(int innerLayerNo) const;
+    SDL_Point getScroll() const;
+    void render(const Camera& camera);
 };
 
 
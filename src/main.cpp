@@ -2,7 +2,10 @@
 #define main_hpp
 
 #include <SDL.h>
+#include <cstring>
+#include <cstdlib>
 #include "game.hpp"
+#include "compositekernel.hpp"
 
 #endif
 
@@ -10,6 +13,275 @@ int main( int argc, char* args[] )
 {
     int SCREEN_WIDTH = 1280;
     int SCREEN_HEIGHT = 720;
+    int tickRate = 60;
+    int threadCount = 0;
+
+    bool headless = false;
+    int headlessTicks = 10000;
+    int particleCount = 0;
+    int entityCount = 0;
+    bool checkAllocations = false;
+
+    // Particle and composite kernel path to force, empty for the fastest the CPU has
+    string kernelPath;
+    bool checkKernel = false;
+
+    string profileCsvPath, profileTracePath;
+
+    string tileMapPath;
+    long tileBudgetMb = 64;
+
+    string recordPath, replayPath;
+
+    bool lowLatency = false;
+    double presentSlackMs = 4;
+
+    // Rotation steps of -1 turn the rotation cache on only for the software renderer
+    bool softwareRenderer = false;
+    int rotationSteps = -1;
+    long rotationBudgetMb = 16;
+
+    // Seconds of the world kept to rewind through with backspace, off by default as every
+    // tick then saves and encodes the whole world
+    double rewindSeconds = 0;
+    long rewindBudgetMb = 32;
+
+    bool deterministic = false;
+    int hashInterval = 0;
+
+    int serverPort = 0;
+    string serverHost;
+    int connectPort = 0;
+    float interestRadius = 1000;
+    int snapshotInterval = 3;
+    bool netStats = false;
+
+    // Parse command line options
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--tick-rate") == 0 && i + 1 < argc)
+        {
+            tickRate = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        else if (strcmp(args[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            headlessTicks = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--particles") == 0 && i + 1 < argc)
+        {
+            particleCount = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--entities") == 0 && i + 1 < argc)
+        {
+            entityCount = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--check-allocs") == 0)
+        {
+            checkAllocations = true;
+        }
+        else if (strcmp(args[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            kernelPath = args[++i];
+        }
+        else if (strcmp(args[i], "--check-kernel") == 0)
+        {
+            checkKernel = true;
+        }
+        else if (strcmp(args[i], "--profile-csv") == 0 && i + 1 < argc)
+        {
+            profileCsvPath = args[++i];
+        }
+        else if (strcmp(args[i], "--profile-trace") == 0 && i + 1 < argc)
+        {
+            profileTracePath = args[++i];
+        }
+        else if (strcmp(args[i], "--tile-map") == 0 && i + 1 < argc)
+        {
+            tileMapPath = args[++i];
+        }
+        else if (strcmp(args[i], "--tile-budget") == 0 && i + 1 < argc)
+        {
+            tileBudgetMb = atol(args[++i]);
+        }
+        else if (strcmp(args[i], "--low-latency") == 0)
+        {
+            lowLatency = true;
+        }
+        else if (strcmp(args[i], "--present-slack") == 0 && i + 1 < argc)
+        {
+            presentSlackMs = atof(args[++i]);
+        }
+        else if (strcmp(args[i], "--software") == 0)
+        {
+            softwareRenderer = true;
+        }
+        else if (strcmp(args[i], "--rotation-steps") == 0 && i + 1 < argc)
+        {
+            rotationSteps = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--rotation-budget") == 0 && i + 1 < argc)
+        {
+            rotationBudgetMb = atol(args[++i]);
+        }
+        else if (strcmp(args[i], "--rewind-seconds") == 0 && i + 1 < argc)
+        {
+            rewindSeconds = atof(args[++i]);
+        }
+        else if (strcmp(args[i], "--rewind-budget") == 0 && i + 1 < argc)
+        {
+            rewindBudgetMb = atol(args[++i]);
+        }
+        else if (strcmp(args[i], "--record") == 0 && i + 1 < argc)
+        {
+            recordPath = args[++i];
+        }
+        else if (strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = args[++i];
+        }
+        else if (strcmp(args[i], "--deterministic") == 0)
+        {
+            deterministic = true;
+        }
+        else if (strcmp(args[i], "--hash-every") == 0 && i + 1 < argc)
+        {
+            hashInterval = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--server") == 0 && i + 1 < argc)
+        {
+            serverPort = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--connect") == 0 && i + 1 < argc)
+        {
+            // host:port
+            serverHost = args[++i];
+            size_t colon = serverHost.rfind(':');
+
+            if (colon != string::npos)
+            {
+                connectPort = atoi(serverHost.c_str() + colon + 1);
+                serverHost.erase(colon);
+            }
+        }
+        else if (strcmp(args[i], "--interest") == 0 && i + 1 < argc)
+        {
+            interestRadius = atof(args[++i]);
+        }
+        else if (strcmp(args[i], "--snapshot-interval") == 0 && i + 1 < argc)
+        {
+            snapshotInterval = atoi(args[++i]);
+        }
+        else if (strcmp(args[i], "--net-stats") == 0)
+        {
+            netStats = true;
+        }
+    }
+
+    if (kernelPath == "scalar")
+    {
+        ParticleKernel::setPath(ParticleKernel::Scalar);
+        CompositeKernel::setPath(CompositeKernel::Scalar);
+    }
+    else if (kernelPath == "sse2")
+    {
+        ParticleKernel::setPath(ParticleKernel::SSE2);
+        CompositeKernel::setPath(CompositeKernel::SSE2);
+    }
+    else if (kernelPath == "avx2")
+    {
+        ParticleKernel::setPath(ParticleKernel::AVX2);
+        CompositeKernel::setPath(CompositeKernel::AVX2);
+    }
+    else if (!kernelPath.empty())
+    {
+        printf("Unknown kernel %s, expected scalar, sse2 or avx2\n", kernelPath.c_str());
+        return 1;
+    }
+
+    // Headless mode simulates with no window or renderer, so it runs on machines without
+    // a display or GPU. Only the timer is needed, the dummy video driver is set in case
+    // anything asks for video anyway. A server never has a window
+    if (headless || serverPort > 0)
+    {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+
+        if (SDL_Init(SDL_INIT_TIMER) == -1) {
+
+            printf( "Failed to initialize SDL: %s\n", SDL_GetError() );
+            return -1;
+        }
+
+        // With --check-kernel every path the CPU has is compared with the scalar one first,
+        // for use in CI
+        if (checkKernel && !ParticleKernel::checkPaths(100003, 100))
+        {
+            printf("Particle kernel paths differ from the scalar path by more than %g\n", KERNEL_EPSILON);
+            SDL_Quit();
+            return 1;
+        }
+
+        if (checkKernel && !CompositeKernel::checkPaths(1280 * 720 + 1))
+        {
+            printf("Composite kernel paths differ from the scalar path\n");
+            SDL_Quit();
+            return 1;
+        }
+
+        Game* game = new Game(nullptr, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+        game->setTickRate(tickRate);
+        game->setThreadCount(threadCount);
+        game->setPopulation(particleCount, entityCount);
+        game->setDeterministic(deterministic, hashInterval);
+
+        if (!game->setInputLog(recordPath, replayPath))
+        {
+            delete game;
+            SDL_Quit();
+            return 1;
+        }
+
+        if (serverPort > 0 || !serverHost.empty())
+        {
+            bool connected = serverPort > 0 ? game->setServer(serverPort, interestRadius, snapshotInterval, netStats)
+                                            : game->setClient(serverHost, connectPort);
+
+            if (connected && serverPort > 0)
+            {
+                game->runServer(headlessTicks);
+            }
+            else if (connected)
+            {
+                game->runClient(headlessTicks);
+            }
+
+            delete game;
+            SDL_Quit();
+            return connected ? 0 : 1;
+        }
+
+        bool steady = game->runHeadless(headlessTicks);
+
+        delete game;
+        SDL_Quit();
+
+        // With --check-allocs a run that allocates once warmed up fails, for use in CI
+        if (checkAllocations && !steady)
+        {
+            printf("Steady state ticks allocated memory\n");
+            return 1;
+        }
+
+        return 0;
+    }
 
     if (SDL_Init(SDL_INIT_EVERYTHING) == -1) {
 
@@ -25,7 +297,22 @@ int main( int argc, char* args[] )
         return -1;
     }
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    // Low latency mode paces frames itself, a vsynced present would block on top of that
+    Uint32 rendererFlags = softwareRenderer ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+
+    if (!lowLatency)
+    {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, rendererFlags);
+
+    // Machines without a GPU fall back to drawing in software
+    if (renderer == NULL && !softwareRenderer) {
+
+        printf( "Failed to create accelerated renderer, drawing in software: %s\n", SDL_GetError());
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
 
     if (renderer == NULL) {
 
@@ -43,5 +330,46 @@ int main( int argc, char* args[] )
 
     Game* game = new Game(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
 
-    game->runGame();
+    game->setTickRate(tickRate);
+    game->setThreadCount(threadCount);
+    game->setProfileOutput(profileCsvPath, profileTracePath);
+    game->setTileMap(tileMapPath, tileBudgetMb * 1024 * 1024);
+    game->setPopulation(particleCount, entityCount);
+    game->setDeterministic(deterministic, hashInterval);
+
+    // The software renderer rotates every pixel of a sprite each time it is drawn
+    SDL_RendererInfo rendererInfo;
+
+    if (rotationSteps < 0)
+    {
+        rotationSteps = SDL_GetRendererInfo(renderer, &rendererInfo) == 0 && (rendererInfo.flags & SDL_RENDERER_SOFTWARE) ? 64 : 0;
+    }
+
+    game->setRotationCache(rotationSteps, rotationBudgetMb * 1024 * 1024);
+    game->setRewind(rewindSeconds, rewindBudgetMb * 1024 * 1024);
+
+    if (lowLatency)
+    {
+        SDL_DisplayMode mode;
+        int refreshRate = 60;
+
+        if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+        {
+            refreshRate = mode.refresh_rate;
+        }
+
+        game->setLowLatency(refreshRate, presentSlackMs / 1000);
+    }
+
+    // A replay sets the tick rate, population and mode it was recorded with
+    if (game->setInputLog(recordPath, replayPath) && (serverHost.empty() || game->setClient(serverHost, connectPort)))
+    {
+        game->runGame();
+    }
+
+    delete game;
+
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
 }
@@ -0,0 +1,267 @@
+#ifndef math2d_hpp
+#define math2d_hpp
+
+#include <cmath>
+
+/**
+ Largest absolute error of fastSinCos against sinf / cosf for angles within a few thousand
+ radians of 0, further out the range reduction loses precision like any float angle
+ */
+#define FAST_TRIG_EPSILON 1e-6f
+
+
+/**
+ Gets the sine and cosine of an angle with polynomials instead of two libm calls. The
+ angle is reduced to within PI / 4 of a multiple of PI / 2, where the Taylor series to x^7
+ for sine and x^8 for cosine are within FAST_TRIG_EPSILON, then swapped and negated for
+ the quadrant
+
+ @param radians  Angle in radians
+ @param sine     Set to the sine of the angle
+ @param cosine   Set to the cosine of the angle
+ */
+inline void fastSinCos(float radians, float& sine, float& cosine)
+{
+    const float quadrant = floorf(radians * 0.636619772f + 0.5f);
+
+    // PI / 2 split in two so the reduction keeps the low bits of the angle
+    const float r = (radians - quadrant * 1.5703125f) - quadrant * 4.83826794897e-4f;
+    const float r2 = r * r;
+
+    const float s = r + r * r2 * (-1.0f / 6 + r2 * (1.0f / 120 + r2 * (-1.0f / 5040)));
+    const float c = 1 + r2 * (-0.5f + r2 * (1.0f / 24 + r2 * (-1.0f / 720 + r2 * (1.0f / 40320))));
+
+    switch ((int)quadrant & 3)
+    {
+        case 0:  sine = s;  cosine = c;  break;
+        case 1:  sine = c;  cosine = -s; break;
+        case 2:  sine = -s; cosine = -c; break;
+        default: sine = -c; cosine = s;  break;
+    }
+}
+
+
+/**
+ Two component value vector. Everything is inline and passed by value so the compiler can
+ keep the components in registers inside hot loops. Lengths and directions are worked out
+ with a square root at most, angles only come in through fromAngle / fromAngleFast and
+ out through angle
+ */
+struct Vec2
+{
+    float x, y;
+
+    constexpr Vec2() : x(0), y(0) {}
+    constexpr Vec2(float x, float y) : x(x), y(y) {}
+
+    /**
+     Makes a unit vector pointing along an angle
+
+     @param radians  Angle in radians, 0 is right and PI / 2 is down
+     @returns        Vector of length 1 at that angle
+     */
+    static Vec2 fromAngle(float radians) { return Vec2(cosf(radians), sinf(radians)); }
+
+    /**
+     Makes a unit vector pointing along an angle with fastSinCos, within FAST_TRIG_EPSILON
+     of fromAngle
+
+     @param radians  Angle in radians, 0 is right and PI / 2 is down
+     @returns        Vector of length 1 at that angle
+     */
+    static Vec2 fromAngleFast(float radians)
+    {
+        Vec2 v;
+        fastSinCos(radians, v.y, v.x);
+        return v;
+    }
+
+    constexpr Vec2 operator+(const Vec2& v) const { return Vec2(x + v.x, y + v.y); }
+    constexpr Vec2 operator-(const Vec2& v) const { return Vec2(x - v.x, y - v.y); }
+    constexpr Vec2 operator*(float s) const { return Vec2(x * s, y * s); }
+    constexpr Vec2 operator/(float s) const { return Vec2(x / s, y / s); }
+    constexpr Vec2 operator-() const { return Vec2(-x, -y); }
+
+    Vec2& operator+=(const Vec2& v) { x += v.x; y += v.y; return *this; }
+    Vec2& operator-=(const Vec2& v) { x -= v.x; y -= v.y; return *this; }
+    Vec2& operator*=(float s) { x *= s; y *= s; return *this; }
+    Vec2& operator/=(float s) { x /= s; y /= s; return *this; }
+
+    constexpr bool operator==(const Vec2& v) const { return x == v.x && y == v.y; }
+    constexpr bool operator!=(const Vec2& v) const { return x != v.x || y != v.y; }
+
+    constexpr float dot(const Vec2& v) const { return x * v.x + y * v.y; }
+    constexpr float cross(const Vec2& v) const { return x * v.y - y * v.x; }
+    constexpr float lengthSquared() const { return x * x + y * y; }
+    float length() const { return sqrtf(x * x + y * y); }
+
+    /**
+     Gets the angle of the vector, the only place an angle is worked out of a vector
+
+     @returns  Angle in radians between -PI and PI
+     */
+    float angle() const { return atan2f(y, x); }
+
+    /**
+     Gets the vector turned a quarter turn, clockwise on screen where y points down
+
+     @returns  Perpendicular vector of the same length
+     */
+    constexpr Vec2 perpendicular() const { return Vec2(-y, x); }
+
+    /**
+     Gets the vector rotated by the angle of a unit vector, which is complex multiplication.
+     Turning by the same amount every tick only needs the rotation worked out once
+
+     @param rotation  Unit vector at the angle to rotate by, (cos, sin) of that angle
+     @returns         Rotated vector, clockwise on screen for positive angles
+     */
+    constexpr Vec2 rotated(const Vec2& rotation) const
+    {
+        return Vec2(x * rotation.x - y * rotation.y, x * rotation.y + y * rotation.x);
+    }
+
+    /**
+     Gets a nearly unit vector pulled back to a length of 1 with one Newton step on its
+     squared length, no square root. Keeps a direction that is rotated over and over from
+     drifting, it is only accurate for vectors already close to unit length
+
+     @returns  Vector in the same direction with a length much closer to 1
+     */
+    constexpr Vec2 renormalized() const
+    {
+        return *this * ((3 - (x * x + y * y)) * 0.5f);
+    }
+
+    /**
+     Gets the vector scaled to a length of 1
+
+     @returns  Unit vector in the same direction, or the zero vector if this has no length
+     */
+    Vec2 normalized() const
+    {
+        const float squared = lengthSquared();
+        return squared > 0 ? *this * (1 / sqrtf(squared)) : Vec2();
+    }
+
+    /**
+     Gets the vector scaled to a length, keeping its direction
+
+     @param length  Length of the new vector
+     @returns       Vector of that length, or the zero vector if this has no length
+     */
+    Vec2 withLength(float length) const
+    {
+        const float squared = lengthSquared();
+        return squared > 0 ? *this * (length / sqrtf(squared)) : Vec2();
+    }
+};
+
+
+constexpr Vec2 operator*(float s, const Vec2& v) { return Vec2(v.x * s, v.y * s); }
+
+inline float distanceSquared(const Vec2& a, const Vec2& b) { return (b - a).lengthSquared(); }
+
+constexpr Vec2 lerp(const Vec2& a, const Vec2& b, float alpha)
+{
+    return Vec2(a.x + (b.x - a.x) * alpha, a.y + (b.y - a.y) * alpha);
+}
+
+
+/**
+ 2D affine transform, a 2x2 rotation / scale matrix in the first two columns and a
+ translation in the third
+
+     | a  b  tx |
+     | c  d  ty |
+
+ Points are transformed with the translation, vectors without it. Transforms combine with
+ operator*, the right hand one is applied first
+ */
+struct Mat2x3
+{
+    float a, b, tx;
+    float c, d, ty;
+
+    constexpr Mat2x3() : a(1), b(0), tx(0), c(0), d(1), ty(0) {}
+    constexpr Mat2x3(float a, float b, float tx, float c, float d, float ty)
+        : a(a), b(b), tx(tx), c(c), d(d), ty(ty) {}
+
+    static constexpr Mat2x3 identity() { return Mat2x3(); }
+    static constexpr Mat2x3 translation(const Vec2& t) { return Mat2x3(1, 0, t.x, 0, 1, t.y); }
+    static constexpr Mat2x3 scale(float sx, float sy) { return Mat2x3(sx, 0, 0, 0, sy, 0); }
+
+    /**
+     Makes a rotation from the cosine and sine of its angle, so callers that already have a
+     direction vector never go through an angle
+
+     @param cosine  Cosine of the angle, the x of a unit direction
+     @param sine    Sine of the angle, the y of a unit direction
+     @returns       Rotation, clockwise on screen for positive angles
+     */
+    static constexpr Mat2x3 rotation(float cosine, float sine) { return Mat2x3(cosine, -sine, 0, sine, cosine, 0); }
+    static Mat2x3 rotation(float radians) { return rotation(cosf(radians), sinf(radians)); }
+
+    /**
+     Makes a rotation about a pivot point followed by a move of the pivot to a position
+
+     @param position  Where the pivot ends up
+     @param cosine    Cosine of the angle of rotation
+     @param sine      Sine of the angle of rotation
+     @returns         Transform from pivot relative coordinates to world coordinates
+     */
+    static constexpr Mat2x3 rotationAbout(const Vec2& position, float cosine, float sine)
+    {
+        return Mat2x3(cosine, -sine, position.x, sine, cosine, position.y);
+    }
+
+    constexpr Mat2x3 operator*(const Mat2x3& m) const
+    {
+        return Mat2x3(a * m.a + b * m.c, a * m.b + b * m.d, a * m.tx + b * m.ty + tx,
+                      c * m.a + d * m.c, c * m.b + d * m.d, c * m.tx + d * m.ty + ty);
+    }
+
+    constexpr Vec2 transformPoint(const Vec2& p) const { return Vec2(a * p.x + b * p.y + tx, c * p.x + d * p.y + ty); }
+    constexpr Vec2 transformVector(const Vec2& v) const { return Vec2(a * v.x + b * v.y, c * v.x + d * v.y); }
+    constexpr Vec2 getTranslation() const { return Vec2(tx, ty); }
+
+    /**
+     Transforms an array of points, the loop has no dependencies between points so it
+     vectorises
+
+     @param in     Points to transform
+     @param out    Transformed points, may be the same array as in
+     @param count  Number of points
+     */
+    void transformPoints(const Vec2* in, Vec2* out, int count) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const Vec2 p = in[i];
+            out[i].x = a * p.x + b * p.y + tx;
+            out[i].y = c * p.x + d * p.y + ty;
+        }
+    }
+
+    /**
+     Transforms points held as separate x and y arrays in place, as the particle system
+     stores them
+
+     @param x      Horizontal positions
+     @param y      Vertical positions
+     @param count  Number of points
+     */
+    void transformPoints(float* x, float* y, int count) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const float px = x[i];
+            const float py = y[i];
+            x[i] = a * px + b * py + tx;
+            y[i] = c * px + d * py + ty;
+        }
+    }
+};
+
+
+#endif /* math2d_hpp */
@@ -0,0 +1,388 @@
+#include "netclient.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a client that is not yet connected
+
+ */
+NetClient::NetClient()
+{
+    pending.tick = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Opens a socket to receive snapshots from a server on. Nothing is sent until the first
+ update, which announces the client to the server
+
+ @param host  Host name or address of the server
+ @param port  UDP port the server listens on
+ @returns     False if the host could not be found or no socket could be opened
+ */
+bool NetClient::connect(const std::string& host, Uint16 port)
+{
+    if (!socket.open(0) || !UdpSocket::resolve(host, port, server))
+    {
+        return false;
+    }
+
+    printf("Connecting to %s:%d\n", host.c_str(), port);
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Tells the server the newest complete snapshot and where the client is looking
+
+ @param now  Local time in seconds
+ */
+void NetClient::sendAck(double now)
+{
+    const Uint32 values[3] = {latestTick, (Uint32)viewX, (Uint32)viewY};
+    Uint8 data[NET_ACK_SIZE];
+
+    data[0] = NET_ACK;
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int b = 0; b < 4; b++)
+        {
+            data[1 + i * 4 + b] = values[i] >> (b * 8);
+        }
+    }
+
+    socket.send(server, data, sizeof(data));
+    lastAck = now;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Forgets every snapshot of the previous session, so one from a restarted server counting
+ its ticks from the start again is taken
+
+ */
+void NetClient::resetSession()
+{
+    for (Snapshot& snapshot : history)
+    {
+        snapshot.tick = 0;
+        snapshot.entities.clear();
+    }
+
+    latestTick = 0;
+    pending.tick = 0;
+    pendingFragments = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds a datagram to the snapshot it belongs to. Datagrams of a snapshot older than the
+ newest complete one are stale and dropped, and one from a newer snapshot abandons the
+ snapshot being put together. A snapshot over a second older than the newest is from a
+ restarted server and starts a new session
+
+ @param data    Datagram
+ @param length  Length of the datagram
+ @param now     Local time in seconds
+ */
+void NetClient::receivePacket(const Uint8* data, int length, double now)
+{
+    SnapshotHeader header;
+
+    if (!decodeSnapshotHeader(data, length, header))
+    {
+        return;
+    }
+
+    if (header.tick + tickRate < std::max(latestTick, pending.tick))
+    {
+        resetSession();
+    }
+
+    if (header.tick <= latestTick || header.tick < pending.tick)
+    {
+        return;
+    }
+
+    if (header.tick != pending.tick)
+    {
+        if (pending.tick != 0)
+        {
+            snapshotsDropped++;
+        }
+
+        pending = header;
+        pendingFragments = 0;
+    }
+
+    const Uint64 bit = 1ULL << header.fragment;
+
+    if ((pendingFragments & bit) || header.fragmentCount != pending.fragmentCount)
+    {
+        return;
+    }
+
+    fragmentChanges[header.fragment].clear();
+
+    if (!decodeSnapshot(data, length, fragmentChanges[header.fragment]))
+    {
+        return;
+    }
+
+    pendingFragments |= bit;
+
+    if (pendingFragments == (pending.fragmentCount == 64 ? ~0ULL : (1ULL << pending.fragmentCount) - 1))
+    {
+        completeSnapshot(now);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Applies the changes from every datagram of the pending snapshot to its baseline, files
+ the result in the history and acknowledges it
+
+ @param now  Local time in seconds
+ */
+void NetClient::completeSnapshot(double now)
+{
+    const Uint32 tick = pending.tick;
+    pending.tick = 0;
+
+    tickRate = pending.tickRate;
+    interval = pending.interval;
+
+    changes.clear();
+
+    for (int i = 0; i < pending.fragmentCount; i++)
+    {
+        changes.insert(changes.end(), fragmentChanges[i].begin(), fragmentChanges[i].end());
+    }
+
+    const Snapshot* baseline = nullptr;
+
+    if (pending.baselineTick != 0)
+    {
+        baseline = &history[(pending.baselineTick / interval) % NET_HISTORY];
+
+        // The server deltas against what was acknowledged, which is always still here
+        // unless the client has fallen far behind
+        if (baseline->tick != pending.baselineTick)
+        {
+            snapshotsDropped++;
+            return;
+        }
+    }
+
+    // Built aside, the baseline may sit in the slot the result goes in
+    if (!applySnapshot(baseline, changes, assembled))
+    {
+        snapshotsDropped++;
+        return;
+    }
+
+    Snapshot& slot = history[(tick / interval) % NET_HISTORY];
+    slot.entities.swap(assembled.entities);
+    slot.tick = tick;
+
+    latestTick = tick;
+    snapshotsReceived++;
+
+    // Follow the server's clock, smoothed so one late snapshot does not jerk everything
+    // back. A jump of over a second is a new session and is taken as it is
+    const double offset = tick - now * tickRate;
+
+    if (!synced || fabs(offset - clockOffset) > tickRate)
+    {
+        clockOffset = offset;
+        synced = true;
+    }
+    else
+    {
+        clockOffset += (offset - clockOffset) * 0.05;
+    }
+
+    sendAck(now);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads every waiting datagram from the server and keeps the server informed of the view,
+ call once per frame
+
+ @param now   Local time in seconds
+ @param view  Center of the client's view in the world, entities near it are sent
+ */
+void NetClient::update(double now, const Vec2& view)
+{
+    if (!socket.isOpen())
+    {
+        return;
+    }
+
+    viewX = lroundf(view.x * SNAPSHOT_POSITION_SCALE);
+    viewY = lroundf(view.y * SNAPSHOT_POSITION_SCALE);
+
+    Uint8 data[SNAPSHOT_MAX_PACKET];
+    NetAddress from;
+    int length;
+
+    while ((length = socket.receive(data, sizeof(data), from)) > 0)
+    {
+        if (from == server)
+        {
+            bytesReceived += length;
+            receivePacket(data, length, now);
+        }
+    }
+
+    if (lastAck < 0 || now - lastAck >= NET_KEEPALIVE)
+    {
+        sendAck(now);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Mirrors the server's entities into a registry as they were two snapshots ago, positions
+ and angles blended between the snapshots either side. When snapshots stop coming
+ entities carry on along their velocity for a moment. Entities the server no longer sends
+ are destroyed
+
+ @param registry  Registry to mirror into
+ @param sprite    Texture for entities the server draws with a sprite
+ @param now       Local time in seconds
+ */
+void NetClient::apply(Registry& registry, Texture* sprite, double now)
+{
+    if (!synced)
+    {
+        return;
+    }
+
+    const double renderTick = now * tickRate + clockOffset - 2 * interval;
+
+    // Newest snapshot at or before the render tick and the oldest after it
+    const Snapshot* from = nullptr;
+    const Snapshot* to = nullptr;
+
+    for (const Snapshot& snapshot : history)
+    {
+        if (snapshot.tick == 0)
+        {
+            continue;
+        }
+
+        if (snapshot.tick <= renderTick)
+        {
+            if (from == nullptr || snapshot.tick > from->tick) from = &snapshot;
+        }
+        else if (to == nullptr || snapshot.tick < to->tick)
+        {
+            to = &snapshot;
+        }
+    }
+
+    if (from == nullptr && to == nullptr)
+    {
+        return;
+    }
+
+    const Snapshot& shown = to != nullptr ? *to : *from;
+    float blend = 1;
+    float frames = 0;
+
+    if (from != nullptr && to != nullptr)
+    {
+        blend = (renderTick - from->tick) / (to->tick - from->tick);
+    }
+    else if (to == nullptr)
+    {
+        // Velocities are per 60hz frame
+        frames = std::min(renderTick - from->tick, NET_MAX_EXTRAPOLATION * tickRate) * 60 / tickRate;
+    }
+
+    applyCount++;
+
+    for (const SnapshotEntity& entity : shown.entities)
+    {
+        Vec2 position(entity.x / SNAPSHOT_POSITION_SCALE, entity.y / SNAPSHOT_POSITION_SCALE);
+        const Vec2 velocity(entity.velocityX / SNAPSHOT_VELOCITY_SCALE, entity.velocityY / SNAPSHOT_VELOCITY_SCALE);
+
+        float angle = entity.angle;
+
+        if (blend < 1)
+        {
+            const SnapshotEntity* previous = from->find(entity.id);
+
+            if (previous != nullptr)
+            {
+                position = lerp(Vec2(previous->x / SNAPSHOT_POSITION_SCALE, previous->y / SNAPSHOT_POSITION_SCALE),
+                                position, blend);
+
+                // Turn the short way round, across the wrap from 65535 to 0 if need be
+                angle = previous->angle + (Sint16)(Uint16)(entity.angle - previous->angle) * blend;
+            }
+        }
+
+        position += velocity * frames;
+
+        auto found = mirrors.find(entity.id);
+
+        if (found == mirrors.end() || !registry.isAlive(found->second.entity))
+        {
+            Mirror mirror;
+            mirror.seen = applyCount;
+            mirror.entity = registry.create(TRANSFORM | ((entity.flags & SNAPSHOT_SPRITE) ? SPRITE : 0));
+
+            if (entity.flags & SNAPSHOT_SPRITE)
+            {
+                registry.get<Sprite>(mirror.entity)->texture = sprite;
+            }
+
+            found = mirrors.insert(std::make_pair(entity.id, mirror)).first;
+        }
+
+        found->second.seen = applyCount;
+
+        Transform* transform = registry.get<Transform>(found->second.entity);
+        transform->x = position.x;
+        transform->y = position.y;
+        transform->angle = angle * (2 * (float)M_PI / 65536);
+    }
+
+    for (auto i = mirrors.begin(); i != mirrors.end(); )
+    {
+        if (i->second.seen != applyCount)
+        {
+            registry.destroy(i->second.entity);
+            i = mirrors.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints how many snapshots arrived and their average size
+
+ */
+void NetClient::printStats() const
+{
+    printf("net: snapshots %d dropped %d bytes/snapshot %.0f entities %d\n", snapshotsReceived, snapshotsDropped,
+           snapshotsReceived > 0 ? (double)bytesReceived / snapshotsReceived : 0, (int)mirrors.size());
+}
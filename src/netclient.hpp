@@ -0,0 +1,86 @@
+#ifndef netclient_hpp
+#define netclient_hpp
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <SDL.h>
+#include "netsocket.hpp"
+#include "netserver.hpp"
+#include "snapshot.hpp"
+#include "registry.hpp"
+#include "texture.hpp"
+#include "math2d.hpp"
+
+// Seconds between acknowledgements when no snapshot arrives, so the server keeps the client
+#define NET_KEEPALIVE 0.1
+
+// Longest a client carries entities along their velocity past the newest snapshot
+#define NET_MAX_EXTRAPOLATION 0.25
+
+
+/**
+ Receiving end of a game played over UDP. Snapshots are put together from their datagrams,
+ acknowledged, and kept so entities can be drawn interpolated between the two either side
+ of a point a couple of snapshots in the past, which hides the gaps between snapshots and
+ the odd late or lost one. The interpolated entities are mirrored into a registry to draw
+ */
+class NetClient
+{
+private:
+    struct Mirror
+    {
+        Entity entity;
+        Uint32 seen;
+    };
+
+    UdpSocket socket;
+    NetAddress server;
+
+    // Complete snapshots by (tick / interval) % NET_HISTORY, and the newest of them
+    Snapshot history[NET_HISTORY];
+    Uint32 latestTick = 0;
+    int tickRate = 60, interval = 3;
+
+    // Snapshot being put together from its datagrams
+    SnapshotHeader pending;
+    Uint64 pendingFragments = 0;
+    std::vector<SnapshotChange> fragmentChanges[SNAPSHOT_MAX_FRAGMENTS];
+    std::vector<SnapshotChange> changes;
+    Snapshot assembled;
+
+    // Server tick minus local seconds times the tick rate, smoothed
+    double clockOffset = 0;
+    bool synced = false;
+
+    Sint32 viewX = 0, viewY = 0;
+    double lastAck = -1;
+
+    // Registry entities standing in for the server's, by snapshot id
+    std::unordered_map<Uint32, Mirror> mirrors;
+    Uint32 applyCount = 0;
+
+    // Totals for the stats printed on exit
+    Uint64 bytesReceived = 0;
+    int snapshotsReceived = 0, snapshotsDropped = 0;
+
+    NetClient(const NetClient&);
+    NetClient& operator=(const NetClient&);
+
+    void resetSession();
+    void receivePacket(const Uint8* data, int length, double now);
+    void completeSnapshot(double now);
+    void sendAck(double now);
+
+public:
+    NetClient();
+
+    bool connect(const std::string& host, Uint16 port);
+    void update(double now, const Vec2& view);
+    void apply(Registry& registry, Texture* sprite, double now);
+
+    void printStats() const;
+};
+
+
+#endif /* netclient_hpp */
@@ -0,0 +1,341 @@
+#include "netserver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "fixed.hpp"
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a server that is not yet listening
+
+ */
+NetServer::NetServer()
+    : interestRadius(0)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the server, forgetting every client
+
+ */
+NetServer::~NetServer()
+{
+    for (Client* client : clients)
+    {
+        delete client;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts listening for clients
+
+ @param port            UDP port to listen on
+ @param tickRate        Simulation ticks per second, sent to clients to time interpolation
+ @param interval        Ticks between snapshots
+ @param interestRadius  Clients are only sent entities this close to the center of their
+                        view
+ @param printStats      Print bandwidth and encoding time once a second
+ @returns               False if the port could not be opened
+ */
+bool NetServer::open(Uint16 port, int tickRate, int interval, float interestRadius, bool printStats)
+{
+    this->tickRate = tickRate;
+    this->interval = std::max(1, std::min(interval, 255));
+    this->interestRadius = (Sint64)(interestRadius * SNAPSHOT_POSITION_SCALE);
+    this->printStats = printStats;
+
+    if (!socket.open(port))
+    {
+        return false;
+    }
+
+    printf("Serving on UDP port %d, a snapshot every %d ticks\n", port, this->interval);
+    statsStart = SDL_GetPerformanceCounter();
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds the client sending from an address
+
+ @param address  Address of the client
+ @returns        The client, nullptr if nothing has been heard from the address
+ */
+NetServer::Client* NetServer::findClient(const NetAddress& address)
+{
+    for (Client* client : clients)
+    {
+        if (client->address == address)
+        {
+            return client;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads every waiting acknowledgement, adding clients heard from for the first time, and
+ drops clients that have gone quiet
+
+ */
+void NetServer::receive()
+{
+    Uint8 data[SNAPSHOT_MAX_PACKET];
+    NetAddress from;
+    int length;
+
+    while ((length = socket.receive(data, sizeof(data), from)) > 0)
+    {
+        if (length != NET_ACK_SIZE || data[0] != NET_ACK)
+        {
+            continue;
+        }
+
+        Client* client = findClient(from);
+
+        if (client == nullptr)
+        {
+            client = new Client();
+            client->address = from;
+            client->ackTick = 0;
+            clients.push_back(client);
+
+            printf("Client %u.%u.%u.%u:%d connected\n", from.host >> 24, (from.host >> 16) & 0xFF,
+                   (from.host >> 8) & 0xFF, from.host & 0xFF, from.port);
+        }
+
+        Uint32 values[3];
+
+        for (int i = 0; i < 3; i++)
+        {
+            const Uint8* bytes = data + 1 + i * 4;
+            values[i] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+        }
+
+        // Acknowledgements can arrive out of order, only ever move forward
+        if (values[0] > client->ackTick)
+        {
+            client->ackTick = values[0];
+        }
+
+        client->viewX = (Sint32)values[1];
+        client->viewY = (Sint32)values[2];
+        client->lastHeard = SDL_GetTicks();
+    }
+
+    const Uint32 now = SDL_GetTicks();
+
+    for (size_t i = 0; i < clients.size(); )
+    {
+        if (now - clients[i]->lastHeard > NET_TIMEOUT_MS)
+        {
+            printf("Client timed out\n");
+            delete clients[i];
+            clients.erase(clients.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Quantizes every moving entity into the world snapshot, sorted by id
+
+ @param registry  Registry holding the entities
+ @param tick      Tick the snapshot is of
+ */
+void NetServer::gatherWorld(Registry& registry, Uint32 tick)
+{
+    world.tick = tick;
+    world.entities.clear();
+
+    registry.each(TRANSFORM | VELOCITY, [this](Archetype& archetype)
+    {
+        const Transform* transforms = archetype.transforms.data();
+        const Velocity* velocities = archetype.velocities.data();
+        const Uint8 flags = (archetype.mask & SPRITE) ? SNAPSHOT_SPRITE : 0;
+        const int count = archetype.size();
+
+        for (int i = 0; i < count; i++)
+        {
+            SnapshotEntity entity;
+            entity.id = SnapshotEntity::makeId(archetype.entities[i].index, archetype.entities[i].generation);
+            entity.x = lroundf(transforms[i].x * SNAPSHOT_POSITION_SCALE);
+            entity.y = lroundf(transforms[i].y * SNAPSHOT_POSITION_SCALE);
+            entity.velocityX = lroundf(velocities[i].x * SNAPSHOT_VELOCITY_SCALE);
+            entity.velocityY = lroundf(velocities[i].y * SNAPSHOT_VELOCITY_SCALE);
+            entity.angle = fixedAngleFromRadians(transforms[i].angle);
+            entity.flags = flags;
+
+            world.entities.push_back(entity);
+        }
+    });
+
+    std::sort(world.entities.begin(), world.entities.end(),
+              [](const SnapshotEntity& a, const SnapshotEntity& b) { return a.id < b.id; });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Picks the entities a client is interested in, those within the interest radius of its
+ view. When there are more than NET_MAX_ENTITIES only the nearest are kept
+
+ @param client   Client to pick for
+ @param visible  Set to the entities picked, sorted by id
+ */
+void NetServer::selectVisible(const Client& client, Snapshot& visible)
+{
+    const Sint64 radiusSquared = interestRadius * interestRadius;
+    const Sint64 viewX = client.viewX, viewY = client.viewY;
+
+    auto distanceSquared = [viewX, viewY](const SnapshotEntity& entity)
+    {
+        const Sint64 dx = entity.x - viewX, dy = entity.y - viewY;
+        return dx * dx + dy * dy;
+    };
+
+    visible.tick = world.tick;
+    visible.entities.clear();
+
+    for (const SnapshotEntity& entity : world.entities)
+    {
+        if (distanceSquared(entity) <= radiusSquared)
+        {
+            visible.entities.push_back(entity);
+        }
+    }
+
+    if (visible.entities.size() > NET_MAX_ENTITIES)
+    {
+        std::nth_element(visible.entities.begin(), visible.entities.begin() + NET_MAX_ENTITIES, visible.entities.end(),
+                         [&distanceSquared](const SnapshotEntity& a, const SnapshotEntity& b)
+                         {
+                             return distanceSquared(a) < distanceSquared(b);
+                         });
+
+        visible.entities.resize(NET_MAX_ENTITIES);
+
+        std::sort(visible.entities.begin(), visible.entities.end(),
+                  [](const SnapshotEntity& a, const SnapshotEntity& b) { return a.id < b.id; });
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sends every client a snapshot of the tick that just ran, on snapshot ticks. Each is a
+ delta against the newest snapshot the client acknowledged that is still in its history,
+ or whole if there is none
+
+ @param registry  Registry holding the entities
+ @param tick      Tick that just ran, from 1
+ */
+void NetServer::send(Registry& registry, Uint32 tick)
+{
+    if (!socket.isOpen() || tick % interval != 0)
+    {
+        reportStats();
+        return;
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    gatherWorld(registry, tick);
+
+    for (Client* client : clients)
+    {
+        Snapshot& visible = client->sent[(tick / interval) % NET_HISTORY];
+        selectVisible(*client, visible);
+
+        const Snapshot& acked = client->sent[(client->ackTick / interval) % NET_HISTORY];
+        const Snapshot* baseline = client->ackTick != 0 && acked.tick == client->ackTick ? &acked : nullptr;
+
+        SnapshotHeader header;
+        header.fragment = 0;
+        header.fragmentCount = 0;
+        header.tickRate = tickRate;
+        header.interval = interval;
+        header.tick = tick;
+        header.baselineTick = baseline != nullptr ? baseline->tick : 0;
+
+        int packetCount;
+
+        if (!encodeSnapshot(visible, baseline, header, packets, packetCount))
+        {
+            // Never sent, so it cannot become a baseline
+            visible.tick = 0;
+            continue;
+        }
+
+        for (int i = 0; i < packetCount; i++)
+        {
+            socket.send(client->address, packets[i].data(), packets[i].size());
+            bytesSent += packets[i].size();
+        }
+
+        entitiesSent += visible.entities.size();
+    }
+
+    encodeTime += SDL_GetPerformanceCounter() - start;
+    clientTicks += clients.size() * interval;
+
+    reportStats();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Counts a tick and prints the bandwidth and time spent per client once a second, when
+ stats are on
+
+ */
+void NetServer::reportStats()
+{
+    ticks++;
+
+    if (!printStats)
+    {
+        return;
+    }
+
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+
+    if (SDL_GetPerformanceCounter() - statsStart < frequency)
+    {
+        return;
+    }
+
+    const double perClientTick = clientTicks > 0 ? 1.0 / clientTicks : 0;
+    const Uint64 snapshots = clientTicks / interval;
+
+    printf("net: clients %d entities %d visible %.0f bytes/client/tick %.1f kbit/s/client %.1f encode us/tick %.1f\n",
+           (int)clients.size(), (int)world.entities.size(), snapshots > 0 ? (double)entitiesSent / snapshots : 0,
+           bytesSent * perClientTick, bytesSent * perClientTick * tickRate * 8 / 1000,
+           ticks > 0 ? encodeTime * 1e6 / frequency / ticks : 0);
+
+    statsStart = SDL_GetPerformanceCounter();
+    encodeTime = bytesSent = clientTicks = entitiesSent = 0;
+    ticks = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of clients being sent snapshots
+
+ */
+int NetServer::getClientCount() const { return clients.size(); }
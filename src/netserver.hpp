@@ -0,0 +1,83 @@
+#ifndef netserver_hpp
+#define netserver_hpp
+
+#include <vector>
+#include <SDL.h>
+#include "netsocket.hpp"
+#include "snapshot.hpp"
+#include "registry.hpp"
+
+// Snapshots kept per client to delta against, older acknowledgements are sent whole
+#define NET_HISTORY 32
+
+// Most entities sent to one client, the nearest are kept so a snapshot always fits in
+// SNAPSHOT_MAX_FRAGMENTS datagrams
+#define NET_MAX_ENTITIES 2000
+
+// Clients not heard from for this long are dropped
+#define NET_TIMEOUT_MS 5000
+
+// Bytes of a client's acknowledgement: type, tick and the center of its view
+#define NET_ACK_SIZE 13
+
+
+/**
+ Authoritative end of a game played over UDP. Every few ticks each client is sent a
+ snapshot of the entities within its interest radius, quantized and delta compressed
+ against the last snapshot it acknowledged. Clients announce themselves by sending
+ acknowledgements, there is no other handshake
+ */
+class NetServer
+{
+private:
+    struct Client
+    {
+        NetAddress address;
+        Uint32 lastHeard;
+
+        // Newest complete snapshot the client has, 0 for none, and the center of its view
+        // in snapshot units
+        Uint32 ackTick;
+        Sint32 viewX, viewY;
+
+        // What was sent on recent snapshot ticks, by (tick / interval) % NET_HISTORY
+        Snapshot sent[NET_HISTORY];
+    };
+
+    UdpSocket socket;
+    std::vector<Client*> clients;
+
+    int tickRate = 60, interval = 3;
+    Sint64 interestRadius;
+
+    // Every entity on the current tick, and scratch space for the datagrams
+    Snapshot world;
+    std::vector<std::vector<Uint8>> packets;
+
+    // Totals since the stats were last printed
+    bool printStats = false;
+    Uint64 statsStart = 0, encodeTime = 0;
+    Uint64 bytesSent = 0, clientTicks = 0, entitiesSent = 0;
+    int ticks = 0;
+
+    NetServer(const NetServer&);
+    NetServer& operator=(const NetServer&);
+
+    Client* findClient(const NetAddress& address);
+    void gatherWorld(Registry& registry, Uint32 tick);
+    void selectVisible(const Client& client, Snapshot& visible);
+    void reportStats();
+
+public:
+    NetServer();
+    ~NetServer();
+
+    bool open(Uint16 port, int tickRate, int interval, float interestRadius, bool printStats);
+    void receive();
+    void send(Registry& registry, Uint32 tick);
+
+    int getClientCount() const;
+};
+
+
+#endif /* netserver_hpp */
@@ -0,0 +1,202 @@
+#include "netsocket.hpp"
+
+#include <stdio.h>
+#include <cstring>
+
+#ifdef _WIN32
+  #include <ws2tcpip.h>
+  typedef int socklen_t;
+  #define INVALID_HANDLE INVALID_SOCKET
+#else
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+  #include <netdb.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define INVALID_HANDLE -1
+#endif
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a socket that is not yet open
+
+ */
+UdpSocket::UdpSocket()
+    : handle(INVALID_HANDLE)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the socket, closing it if it is open
+
+ */
+UdpSocket::~UdpSocket()
+{
+    close();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Opens the socket on a local port and makes it non blocking
+
+ @param port  Port to listen on, 0 for any free port
+ @returns     False if the socket could not be opened or bound
+ */
+bool UdpSocket::open(Uint16 port)
+{
+#ifdef _WIN32
+    WSADATA data;
+
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+    {
+        printf("Failed to start Winsock\n");
+        return false;
+    }
+#endif
+
+    handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    if (handle == INVALID_HANDLE)
+    {
+        printf("Failed to create a UDP socket\n");
+        return false;
+    }
+
+    opened = true;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(handle, (const sockaddr*)&address, sizeof(address)) != 0)
+    {
+        printf("Failed to bind UDP port %d\n", port);
+        close();
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(handle, FIONBIO, &nonBlocking);
+#else
+    fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Closes the socket
+
+ */
+void UdpSocket::close()
+{
+    if (!opened)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    closesocket(handle);
+    WSACleanup();
+#else
+    ::close(handle);
+#endif
+
+    handle = INVALID_HANDLE;
+    opened = false;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets whether the socket is open
+
+ */
+bool UdpSocket::isOpen() const { return opened; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sends a datagram
+
+ @param address  Address to send to
+ @param data     Bytes to send
+ @param length   Number of bytes, at most what fits in one datagram
+ @returns        False if the datagram could not be sent
+ */
+bool UdpSocket::send(const NetAddress& address, const void* data, int length)
+{
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(address.host);
+    to.sin_port = htons(address.port);
+
+    return sendto(handle, (const char*)data, length, 0, (const sockaddr*)&to, sizeof(to)) == length;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Receives a waiting datagram, without blocking
+
+ @param buffer  Buffer to receive into
+ @param size    Size of the buffer, longer datagrams are cut short
+ @param from    Set to the address the datagram came from
+ @returns       Number of bytes received, 0 or less when nothing is waiting
+ */
+int UdpSocket::receive(void* buffer, int size, NetAddress& from)
+{
+    sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+
+    int length = recvfrom(handle, (char*)buffer, size, 0, (sockaddr*)&address, &addressLength);
+
+    if (length > 0)
+    {
+        from.host = ntohl(address.sin_addr.s_addr);
+        from.port = ntohs(address.sin_port);
+    }
+
+    return length;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Looks up the IPv4 address of a host name or dotted address
+
+ @param host     Host to look up
+ @param port     Port to put in the address
+ @param address  Set to the address found
+ @returns        False if the host could not be found
+ */
+bool UdpSocket::resolve(const std::string& host, Uint16 port, NetAddress& address)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result = nullptr;
+
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+    {
+        printf("Failed to find host %s\n", host.c_str());
+        return false;
+    }
+
+    address.host = ntohl(((const sockaddr_in*)result->ai_addr)->sin_addr.s_addr);
+    address.port = port;
+
+    freeaddrinfo(result);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef netsocket_hpp
+#define netsocket_hpp
+
+#include <string>
+#include <SDL.h>
+
+#ifdef _WIN32
+  #include <winsock2.h>
+  typedef SOCKET SocketHandle;
+#else
+  typedef int SocketHandle;
+#endif
+
+
+/**
+ IPv4 address and port, both in host byte order
+ */
+struct NetAddress
+{
+    Uint32 host;
+    Uint16 port;
+
+    bool operator==(const NetAddress& other) const { return host == other.host && port == other.port; }
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+
+/**
+ Non blocking UDP socket. Datagrams may be lost, duplicated or arrive out of order, what
+ is sent over it has to cope with that
+ */
+class UdpSocket
+{
+private:
+    SocketHandle handle;
+    bool opened = false;
+
+    UdpSocket(const UdpSocket&);
+    UdpSocket& operator=(const UdpSocket&);
+
+public:
+    UdpSocket();
+    ~UdpSocket();
+
+    bool open(Uint16 port);
+    void close();
+    bool isOpen() const;
+
+    bool send(const NetAddress& address, const void* data, int length);
+    int receive(void* buffer, int size, NetAddress& from);
+
+    static bool resolve(const std::string& host, Uint16 port, NetAddress& address);
+};
+
+
+#endif /* netsocket_hpp */
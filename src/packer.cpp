@@ -0,0 +1,290 @@
+#include <SDL.h>
+#include <SDL_image.h>
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "assetarchive.hpp"
+
+#ifdef ASSETARCHIVE_LZ4
+  #include <lz4.h>
+#endif
+
+/**
+ Build time tool that bakes images into an asset archive, see assetarchive.hpp. Each image
+ is decoded once here and stored as raw pixels in one format, so the game never decodes a
+ PNG when it starts
+
+     SDL2_Game_Packer [--lz4] [--format argb8888|abgr8888|rgba8888|bgra8888] output root file...
+
+ Files are given relative to root, which is the directory the game loads images from, and
+ are looked up by that relative path
+ */
+
+
+struct PackedImage
+{
+    ArchiveEntry entry;
+    std::vector<Uint8> bytes;
+};
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the pixel format named on the command line
+
+ @param name  Name of the format
+ @returns     The SDL pixel format, SDL_PIXELFORMAT_UNKNOWN if it is not one of the four
+ */
+static Uint32 parseFormat(const char* name)
+{
+    if (strcmp(name, "argb8888") == 0) return SDL_PIXELFORMAT_ARGB8888;
+    if (strcmp(name, "abgr8888") == 0) return SDL_PIXELFORMAT_ABGR8888;
+    if (strcmp(name, "rgba8888") == 0) return SDL_PIXELFORMAT_RGBA8888;
+    if (strcmp(name, "bgra8888") == 0) return SDL_PIXELFORMAT_BGRA8888;
+
+    return SDL_PIXELFORMAT_UNKNOWN;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Decodes an image and converts it into tightly packed rows of the archive's pixel format
+
+ @param root      Directory the file path is relative to
+ @param file      Path of the image, also its name in the archive
+ @param format    Pixel format to store
+ @param lz4       True to compress the pixels if that makes them smaller
+ @param image     Filled with the entry and its stored bytes
+ @returns         False if the image could not be packed
+ */
+static bool packImage(const std::string& root, const std::string& file, Uint32 format, bool lz4, PackedImage& image)
+{
+    std::string name = file;
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    if (name.size() >= ARCHIVE_NAME_LENGTH)
+    {
+        printf("Name too long for the archive: %s\n", name.c_str());
+        return false;
+    }
+
+    const std::string path = root + "/" + file;
+    SDL_Surface* loaded = IMG_Load(path.c_str());
+
+    if (loaded == nullptr)
+    {
+        printf("Failed to load %s: %s\n", path.c_str(), IMG_GetError());
+        return false;
+    }
+
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, format, 0);
+    SDL_FreeSurface(loaded);
+
+    if (surface == nullptr)
+    {
+        printf("Failed to convert %s: %s\n", path.c_str(), SDL_GetError());
+        return false;
+    }
+
+    const int rowBytes = surface->w * SDL_BYTESPERPIXEL(format);
+    std::vector<Uint8> pixels(rowBytes * surface->h);
+
+    for (int y = 0; y < surface->h; y++)
+    {
+        memcpy(&pixels[y * rowBytes], (const Uint8*)surface->pixels + y * surface->pitch, rowBytes);
+    }
+
+    memset(&image.entry, 0, sizeof(ArchiveEntry));
+    strcpy(image.entry.name, name.c_str());
+    image.entry.format = format;
+    image.entry.width = surface->w;
+    image.entry.height = surface->h;
+    image.entry.pitch = rowBytes;
+    image.entry.size = pixels.size();
+    image.entry.compression = ARCHIVE_UNCOMPRESSED;
+
+    SDL_FreeSurface(surface);
+
+#ifdef ASSETARCHIVE_LZ4
+    if (lz4)
+    {
+        std::vector<Uint8> compressed(LZ4_compressBound(pixels.size()));
+        const int written = LZ4_compress_default((const char*)pixels.data(), (char*)compressed.data(),
+                                                 pixels.size(), compressed.size());
+
+        // Keep the raw pixels when compressing does not help, they load with no copy
+        if (written > 0 && written < (int)pixels.size())
+        {
+            compressed.resize(written);
+            image.entry.compression = ARCHIVE_LZ4;
+            image.entry.storedSize = written;
+            image.bytes.swap(compressed);
+            return true;
+        }
+    }
+#else
+    if (lz4)
+    {
+        printf("Built without LZ4, %s is stored uncompressed\n", name.c_str());
+    }
+#endif
+
+    image.entry.storedSize = pixels.size();
+    image.bytes.swap(pixels);
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Writes the header, the index sorted by name and the pixel data of each image
+
+ @param output  Path of the archive to write
+ @param images  Packed images, sorted by name
+ @returns       False if the file could not be written
+ */
+static bool writeArchive(const std::string& output, std::vector<PackedImage>& images)
+{
+    ArchiveHeader header;
+    memcpy(header.magic, ARCHIVE_MAGIC, 4);
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = images.size();
+    header.reserved = 0;
+
+    // Lay the pixel data out after the index, each image on an aligned offset
+    Uint64 offset = sizeof(ArchiveHeader) + images.size() * sizeof(ArchiveEntry);
+
+    for (PackedImage& image : images)
+    {
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+        image.entry.offset = offset;
+        offset += image.bytes.size();
+    }
+
+    FILE* file = fopen(output.c_str(), "wb");
+
+    if (file == nullptr)
+    {
+        printf("Failed to open %s for writing\n", output.c_str());
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (const PackedImage& image : images)
+    {
+        written = written && fwrite(&image.entry, sizeof(ArchiveEntry), 1, file) == 1;
+    }
+
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+
+    for (const PackedImage& image : images)
+    {
+        const long position = ftell(file);
+        const long gap = (long)image.entry.offset - position;
+
+        written = written && gap >= 0 && fwrite(padding, 1, gap, file) == (size_t)gap;
+        written = written && fwrite(image.bytes.data(), 1, image.bytes.size(), file) == image.bytes.size();
+    }
+
+    written = fclose(file) == 0 && written;
+
+    if (!written)
+    {
+        printf("Failed to write %s\n", output.c_str());
+    }
+
+    return written;
+}
+
+
+
+int main(int argc, char* args[])
+{
+    bool lz4 = false;
+    Uint32 format = SDL_PIXELFORMAT_ARGB8888;
+    int first = 1;
+
+    // Options come before the output path
+    while (first < argc && strncmp(args[first], "--", 2) == 0)
+    {
+        if (strcmp(args[first], "--lz4") == 0)
+        {
+            lz4 = true;
+            first++;
+        }
+        else if (strcmp(args[first], "--format") == 0 && first + 1 < argc)
+        {
+            format = parseFormat(args[first + 1]);
+            first += 2;
+
+            if (format == SDL_PIXELFORMAT_UNKNOWN)
+            {
+                printf("Unknown format %s\n", args[first - 1]);
+                return 1;
+            }
+        }
+        else
+        {
+            printf("Unknown option %s\n", args[first]);
+            return 1;
+        }
+    }
+
+    if (argc - first < 3)
+    {
+        printf("Usage: %s [--lz4] [--format argb8888|abgr8888|rgba8888|bgra8888] output root file...\n", args[0]);
+        return 1;
+    }
+
+    const std::string output = args[first];
+    const std::string root = args[first + 1];
+
+    IMG_Init(IMG_INIT_PNG);
+
+    std::vector<PackedImage> images(argc - first - 2);
+    Uint64 rawBytes = 0, storedBytes = 0;
+
+    for (int i = first + 2; i < argc; i++)
+    {
+        PackedImage& image = images[i - first - 2];
+
+        if (!packImage(root, args[i], format, lz4, image))
+        {
+            return 1;
+        }
+
+        rawBytes += image.entry.size;
+        storedBytes += image.entry.storedSize;
+    }
+
+    // The game finds images with a binary search on the name
+    std::sort(images.begin(), images.end(), [](const PackedImage& a, const PackedImage& b)
+    {
+        return strcmp(a.entry.name, b.entry.name) < 0;
+    });
+
+    for (size_t i = 1; i < images.size(); i++)
+    {
+        if (strcmp(images[i - 1].entry.name, images[i].entry.name) == 0)
+        {
+            printf("%s is given twice\n", images[i].entry.name);
+            return 1;
+        }
+    }
+
+    if (!writeArchive(output, images))
+    {
+        return 1;
+    }
+
+    printf("Packed %d images into %s, %llu kb of pixels stored in %llu kb\n", (int)images.size(), output.c_str(),
+           (unsigned long long)rawBytes / 1024, (unsigned long long)storedBytes / 1024);
+
+    IMG_Quit();
+
+    return 0;
+}
@@ -1,7 +1,7 @@
 #include "particle.hpp"
 
 /** --------------------------------------------------------------------------------------
- Constructs a vector based particle without a texture
+ Constructs a vector based particle without a texture in the shared particle system
 
  @param x        Position of the vector on the x axis
  @param y        Position of the vector on the y axis
@@ -11,16 +11,15 @@
  @param gravity  Gravity applied to particle (0.1 - 1 recommended)
  */
 Particle::Particle(int x, int y, float speed, float heading, float friction, float gravity)
-    : x(x), y(y), friction(friction), gravity(gravity)
+    : Particle(getSharedSystem(), x, y, speed, heading, friction, gravity, nullptr)
 {
-    velocityX = cos(heading) * speed;
-    velocityY = sin(heading) * speed;
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Constructs a vector based particle with with a bound texture
+ Constructs a vector based particle with with a bound texture in the shared particle
+ system
 
  @param x          Position of the vector on the x axis
  @param y          Position of the vector on the y axi]s
@@ -31,19 +30,88 @@ Particle::Particle(int x, int y, float speed, float heading, float friction, flo
  @param texture    Texture to bind to this particle
  */
 Particle::Particle(int x, int y, float speed, float heading, float friction, float gravity, Texture* texture)
-    : Particle (x, y, speed, heading, friction, gravity)
+    : Particle(getSharedSystem(), x, y, speed, heading, friction, gravity, texture)
 {
-    this-> texture = texture;
 }
 
 
 
+/** --------------------------------------------------------------------------------------
+ Constructs a vector based particle with a bound texture. The particle is a handle, its
+ state lives in the given particle system and is updated along with every other particle
+ in that system
+
+ @param system     Particle system that stores the state of this particle
+ @param x          Position of the vector on the x axis
+ @param y          Position of the vector on the y axis
+ @param speed      Speed the vector moves, used to calculate length (magnitude)
+ @param heading    Direction of vector, used to calculate angle
+ @param friction   Amount of friction acting on this particle (0.8 - 1 recommended)
+ @param gravity    Gravity applied to particle (0.1 - 1 recommended)
+ @param texture    Texture to bind to this particle, may be nullptr
+ */
+Particle::Particle(ParticleSystem* system, int x, int y, float speed, float heading, float friction, float gravity, Texture* texture)
+    : system(system), texture(texture), heading(Vec2::fromAngleFast(heading))
+{
+    id = system->add(x, y, speed, heading, friction, gravity);
+
+    if (system->isDeterministic())
+    {
+        fixedHeading = FixedVec2::fromAngle(fixedAngleFromRadians(heading));
+        this->heading = fixedHeading.toVec2();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the particle handle and removes its state from the particle system
+
+ */
+Particle::~Particle()
+{
+    system->remove(id);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the particle system used by particles constructed without one
+
+ @returns The shared particle system
+ */
+ParticleSystem* Particle::getSharedSystem()
+{
+    static ParticleSystem shared;
+    return &shared;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the particle system this particle lives in
+
+ @returns The particle system that stores this particle
+ */
+ParticleSystem* Particle::getSystem() { return system; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the id of this particle within its particle system
+
+ @returns The id of the particle
+ */
+int Particle::getId() { return id; }
+
+
+
 /** --------------------------------------------------------------------------------------
  Sets the position of the particle on the horiontal x axis
 
  @param x   New position of the particle on the horizontal x axis
  */
-void Particle::setPositionX(float x) { this->x = x; }
+void Particle::setPositionX(float x) { system->setPositionX(id, x); }
 
 
 
@@ -52,7 +120,7 @@ void Particle::setPositionX(float x) { this->x = x; }
 
  @param y   New position of the particle on the vertical y axis
  */
-void Particle::setPositionY(float y) { this->y = y; }
+void Particle::setPositionY(float y) { system->setPositionY(id, y); }
 
 
 
@@ -61,7 +129,7 @@ void Particle::setPositionY(float y) { this->y = y; }
 
  @param velocityX  New velocity of the particle on the horizontal x axis
  */
-void Particle::setVelocityX(float velocityX) { this->velocityX = velocityX; }
+void Particle::setVelocityX(float velocityX) { system->setVelocityX(id, velocityX); }
 
 
 
@@ -70,7 +138,7 @@ void Particle::setVelocityX(float velocityX) { this->velocityX = velocityX; }
 
  @param velocityY  New velocity of the particle on the vertical y axis
  */
-void Particle::setVelocityY(float velocityY) { this->velocityY = velocityY; }
+void Particle::setVelocityY(float velocityY) { system->setVelocityY(id, velocityY); }
 
 
 
@@ -79,7 +147,7 @@ void Particle::setVelocityY(float velocityY) { this->velocityY = velocityY; }
 
  @returns The position of the particle on either the horizontal axis
  */
-float Particle::getPositionX() { return x; }
+float Particle::getPositionX() { return system->getPositionX(id); }
 
 
 
@@ -88,7 +156,7 @@ float Particle::getPositionX() { return x; }
 
  @returns The position of the particle on the vertical y axis
  */
-float Particle::getPositionY() { return y; }
+float Particle::getPositionY() { return system->getPositionY(id); }
 
 
 
@@ -97,7 +165,7 @@ float Particle::getPositionY() { return y; }
 
  @returns The velocity of the particle on the horizontal x axis
  */
-float Particle::getVelocityX() { return velocityX; }
+float Particle::getVelocityX() { return system->getVelocityX(id); }
 
 
 
@@ -106,41 +174,190 @@ float Particle::getVelocityX() { return velocityX; }
 
  @returns The velocity of the particle on the vertical y axis
  */
-float Particle::getVelocityY() { return velocityY; }
+float Particle::getVelocityY() { return system->getVelocityY(id); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets and sets the position and velocity of the particle as vectors
+ */
+Vec2 Particle::getPosition() { return system->getPosition(id); }
+Vec2 Particle::getVelocity() { return system->getVelocity(id); }
+void Particle::setPosition(const Vec2& position) { system->setPosition(id, position); }
+void Particle::setVelocity(const Vec2& velocity) { system->setVelocity(id, velocity); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets a new heading for the particle from an angle and points its velocity along it
+
+ @param degreeOffset Heading in radians, 0 is right and PI / 2 is down
+ */
+void Particle::setHeading(float degreeOffset)
+{
+    if (system->isDeterministic())
+    {
+        fixedHeading = FixedVec2::fromAngle(fixedAngleFromRadians(degreeOffset));
+        heading = fixedHeading.toVec2();
+        steer();
+        return;
+    }
+
+    setHeading(Vec2::fromAngleFast(degreeOffset));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets a new heading for the particle and points its velocity along it
+
+ @param direction  Unit vector to point the particle along
+ */
+void Particle::setHeading(const Vec2& direction)
+{
+    heading = direction;
+
+    if (system->isDeterministic())
+    {
+        fixedHeading = FixedVec2::fromVec2(direction).normalized();
+        heading = fixedHeading.toVec2();
+    }
+
+    steer();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the direction the particle is pointing
+
+ @returns Unit vector the particle points along
+ */
+Vec2 Particle::getHeading() { return heading; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the direction the particle is pointing in fixed point, only valid when its system is
+ deterministic
+
+ @returns Unit vector the particle points along
+ */
+FixedVec2 Particle::getFixedHeading() { return fixedHeading; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Puts back a heading read earlier with getHeading and getFixedHeading, exactly as it was
+ and without steering the velocity along it
+
+ @param heading       Unit vector the particle pointed along
+ @param fixedHeading  The same in fixed point, only used when the system is deterministic
+ */
+void Particle::restoreHeading(const Vec2& heading, const FixedVec2& fixedHeading)
+{
+    this->heading = heading;
+    this->fixedHeading = fixedHeading;
+}
 
 
 
 /** --------------------------------------------------------------------------------------
- Sets a new heading for the particle by applying an offset in degrees
+ Turns the heading of the particle by an angle, the velocity follows on the next steer
 
- @param degreeOffset Amount of offset to apply to the heading in degrees
+ @param radians  Angle to turn by, positive turns clockwise on screen
  */
- void Particle::setHeading(float degreeOffset)
+void Particle::turn(float radians)
 {
-    texture->setAngleByDegrees(degreeOffset);
+    if (system->isDeterministic())
+    {
+        fixedHeading = fixedHeading.rotated(FixedVec2::fromAngle(fixedAngleFromRadians(radians))).normalized();
+        heading = fixedHeading.toVec2();
+        return;
+    }
 
-    float speed = sqrt(velocityX * velocityX + velocityY * velocityY);
-    velocityX = cosf(degreeOffset) * speed;
-    velocityY = sinf(degreeOffset) * speed;
+    turn(Vec2::fromAngleFast(radians));
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Accelerates the particles by an amount of speed, reasonable speed values are 0 to 0.5
- where 0 will eventually stop the particle assuming it has some degree of fricition set
+ Turns the heading of the particle by the angle of a unit vector. Many particles turning at
+ the same rate can share one rotation and turn without any trigonometry. The heading is
+ renormalised as it goes so rounding does not shrink or grow it over many turns
+
+ @param rotation  Unit vector at the angle to turn by, see Vec2::rotated
+ */
+void Particle::turn(const Vec2& rotation)
+{
+    if (system->isDeterministic())
+    {
+        fixedHeading = fixedHeading.rotated(FixedVec2::fromVec2(rotation)).normalized();
+        heading = fixedHeading.toVec2();
+        return;
+    }
+
+    heading = heading.rotated(rotation).renormalized();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Points the velocity of the particle along its heading, keeping its speed, and turns any
+ bound texture to match. A particle at rest has nothing to point
+
+ */
+void Particle::steer()
+{
+    if (texture != nullptr)
+    {
+        texture->setDirection(heading);
+    }
+
+    if (system->isDeterministic())
+    {
+        const FixedVec2 velocity = system->getFixedVelocity(id);
+
+        if (velocity.lengthSquaredRaw() > 0)
+        {
+            system->setFixedVelocity(id, fixedHeading * velocity.length());
+        }
+
+        return;
+    }
+
+    Vec2 velocity = system->getVelocity(id);
+    float speedSquared = velocity.lengthSquared();
+
+    if (speedSquared > 0)
+    {
+        system->setVelocity(id, heading * sqrtf(speedSquared));
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Accelerates the particle along its heading by an amount of speed, reasonable speed values
+ are 0 to 0.5 where 0 will eventually stop the particle assuming it has some degree of
+ fricition set
 
  @param speed  Speed by which to accelerate the particle
  */
- void Particle::accelerate(float speed)
+void Particle::accelerate(float speed)
 {
-    float heading = atan2f(velocityY, velocityX);
+    if (speed == 0)
+    {
+        return;
+    }
 
-    float accelerationX = cosf(heading) * speed;
-    float accelerationY = sinf(heading) * speed;
+    if (system->isDeterministic())
+    {
+        system->setFixedVelocity(id, system->getFixedVelocity(id) + fixedHeading * Fixed::fromFloat(speed));
+        return;
+    }
 
-    velocityX += accelerationX;
-    velocityY += accelerationY;
+    system->setVelocity(id, system->getVelocity(id) + heading * speed);
 }
 
 
@@ -154,10 +371,15 @@ float Particle::getVelocityY() { return velocityY; }
  */
  void Particle::decelerate(float force)
 {
+    if (system->isDeterministic())
+    {
+        system->setFixedVelocity(id, system->getFixedVelocity(id) * (Fixed::fromInt(1) - Fixed::fromFloat(force)));
+        return;
+    }
+
     float additionalFriction = 1 - force;
 
-    velocityX *= additionalFriction;
-    velocityY *= additionalFriction;
+    system->setVelocity(id, system->getVelocity(id) * additionalFriction);
 }
 
 
@@ -169,28 +391,61 @@ float Particle::getVelocityY() { return velocityY; }
  */
  void Particle::accelerate()
 {
-    velocityX += thrustX;
-    velocityY += thrustY;
+    if (system->isDeterministic())
+    {
+        system->setFixedVelocity(id, system->getFixedVelocity(id) + FixedVec2::fromVec2(thrust));
+        return;
+    }
+
+    system->setVelocity(id, system->getVelocity(id) + thrust);
 }
 
 
 
 /** --------------------------------------------------------------------------------------
  Updates the particle based on any amendments to the particles characteristics and renders
- then renders any associated texture the particle uses
+ then renders any associated texture the particle uses. Particles that live in a system
+ which is updated as a batch should only call render()
 
+ @param camera Camera to draw the texture through
  */
-void Particle::update()
+void Particle::update(const Camera& camera)
 {
-    velocityX *= friction;
-    velocityY *= friction;
-    velocityY += gravity;
-    x += velocityX;
-    y += velocityY;
+    system->update(id, 1);
 
+    render(camera);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Renders any associated texture the particle uses at the particles current position
+
+ @param camera Camera to draw the texture through
+ */
+void Particle::render(const Camera& camera)
+{
+    if (texture != nullptr)
+    {
+        texture->setLocation(system->getPosition(id));
+        texture->render(camera);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Renders any associated texture the particle uses at a position interpolated between the
+ start and end of the last simulation step
+
+ @param alpha  How far between the two positions to render, 0 is the start and 1 the end
+ @param camera Camera to draw the texture through
+ */
+void Particle::render(float alpha, const Camera& camera)
+{
     if (texture != nullptr)
     {
-        texture->setLocation(x, y);
-        texture->render();
+        texture->setLocation(system->getInterpolated(id, alpha));
+        texture->render(camera);
     }
 }
@@ -2,21 +2,40 @@
 #define particle_hpp
 #include <cmath>
 #include <stdio.h>
-#include "vector.hpp"
+#include "math2d.hpp"
 #include "texture.hpp"
+#include "particlesystem.hpp"
 
 
 class Particle {
 
 private:
+    ParticleSystem* system;
     Texture* texture;
+    int id;
 
-    float x, y, speed, friction, gravity, velocityX, velocityY, thrustX, thrustY;
+    Vec2 thrust;
+
+    // Unit vector the particle points along, turned by rotating it rather than by keeping
+    // an angle so no sin / cos is needed per update
+    Vec2 heading;
+
+    // The heading in fixed point when the system is deterministic, heading is then a copy
+    // of it for drawing
+    FixedVec2 fixedHeading;
+
+    Particle(const Particle&);
+    Particle& operator=(const Particle&);
 
 public:
-    Particle();
     Particle(int x, int y, float speed, float heading, float friction, float gravity);
     Particle(int x, int y, float speed, float heading, float friction, float gravity, Texture* texture);
+    Particle(ParticleSystem* system, int x, int y, float speed, float heading, float friction, float gravity, Texture* texture);
+    ~Particle();
+
+    static ParticleSystem* getSharedSystem();
+    ParticleSystem* getSystem();
+    int getId();
 
     float getPositionX();
     float getPositionY();
@@ -28,13 +47,27 @@ public:
     void setVelocityX(float velocityX);
     void setVelocityY(float velocityY);
 
+    Vec2 getPosition();
+    Vec2 getVelocity();
+    void setPosition(const Vec2& position);
+    void setVelocity(const Vec2& velocity);
+
     void setHeading(float degreeOffset);
+    void setHeading(const Vec2& direction);
+    Vec2 getHeading();
+    FixedVec2 getFixedHeading();
+    void restoreHeading(const Vec2& heading, const FixedVec2& fixedHeading);
+    void turn(float radians);
+    void turn(const Vec2& rotation);
+    void steer();
     void accelerate(float speed);
     void accelerate();
 
     void decelerate(float braking);
 
-    void update();
+    void update(const Camera& camera);
+    void render(const Camera& camera);
+    void render(float alpha, const Camera& camera);
 
 };
 
@@ -0,0 +1,650 @@
+#include "particlekernel.hpp"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define KERNEL_X86
+  #include <immintrin.h>
+#endif
+
+// GCC and Clang compile the AVX2 path for its own function only, so the rest of the game
+// still runs on CPUs without AVX2. MSVC accepts AVX2 intrinsics without any flag
+#if defined(KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+  #define KERNEL_TARGET_SSE2 __attribute__((target("sse2")))
+  #define KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+  #define KERNEL_HAVE_AVX2
+#elif defined(KERNEL_X86) && defined(_MSC_VER)
+  #define KERNEL_TARGET_SSE2
+  #define KERNEL_TARGET_AVX2
+  #define KERNEL_HAVE_AVX2
+#endif
+
+
+namespace
+{
+
+/** --------------------------------------------------------------------------------------
+ Scalar reference path, the same maths as Particle::update and ColDet::bounceScreen /
+ ColDet::wrapScreen applied to one particle at a time
+ */
+inline void integrateScalar(const ParticleArrays& p, int i, float dt)
+{
+    p.velocityX[i] *= p.friction[i];
+    p.velocityY[i] *= p.friction[i];
+    p.velocityY[i] += p.gravity[i] * dt;
+    p.x[i] += p.velocityX[i] * dt;
+    p.y[i] += p.velocityY[i] * dt;
+}
+
+
+inline void bounceScalar(const ParticleArrays& p, int i, float width, float height)
+{
+    const float midPoint = p.radius[i];
+
+    if (p.x[i] - midPoint < 0)
+    {
+        p.x[i] = 0 + midPoint;
+        p.velocityX[i] *= -1;
+    }
+    else if (p.x[i] + midPoint > width)
+    {
+        p.x[i] = width - midPoint;
+        p.velocityX[i] *= -1;
+    }
+
+    if (p.y[i] - midPoint < 0)
+    {
+        p.y[i] = 0 + midPoint;
+        p.velocityY[i] *= -1;
+    }
+    else if (p.y[i] + midPoint > height)
+    {
+        p.y[i] = height - midPoint;
+        p.velocityY[i] *= -1;
+    }
+}
+
+
+inline void wrapScalar(const ParticleArrays& p, int i, float width, float height)
+{
+    const float midPoint = p.radius[i];
+
+    if (p.x[i] < (0 - midPoint))
+    {
+        p.x[i] = width + midPoint;
+    }
+    else if (p.x[i] > width + midPoint)
+    {
+        p.x[i] = 0 - midPoint;
+    }
+    else if (p.y[i] < (0 - midPoint))
+    {
+        p.y[i] = height + midPoint;
+    }
+    else if (p.y[i] > height + midPoint)
+    {
+        p.y[i] = 0 - midPoint;
+    }
+}
+
+
+/** --------------------------------------------------------------------------------------
+ Deterministic path, the scalar maths in fixed point. Integer arithmetic gives the same
+ bits on every machine, so there is no SIMD path to keep in step with it. Each particle's
+ float copy is refreshed once it is done
+ */
+void runFixed(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end, bool integrate,
+              Fixed dt, ScreenCollision collision, Fixed width, Fixed height)
+{
+    const Fixed zero;
+
+    for (int i = begin; i < end; i++)
+    {
+        if (integrate)
+        {
+            f.velocityX[i] *= f.friction[i];
+            f.velocityY[i] *= f.friction[i];
+            f.velocityY[i] += Fixed::fromFloat(p.gravity[i]) * dt;
+            f.x[i] += f.velocityX[i] * dt;
+            f.y[i] += f.velocityY[i] * dt;
+        }
+
+        const Fixed midPoint = Fixed::fromFloat(p.radius[i]);
+
+        if (collision == ScreenCollision::Bounce)
+        {
+            if (f.x[i] - midPoint < zero)
+            {
+                f.x[i] = midPoint;
+                f.velocityX[i] = -f.velocityX[i];
+            }
+            else if (f.x[i] + midPoint > width)
+            {
+                f.x[i] = width - midPoint;
+                f.velocityX[i] = -f.velocityX[i];
+            }
+
+            if (f.y[i] - midPoint < zero)
+            {
+                f.y[i] = midPoint;
+                f.velocityY[i] = -f.velocityY[i];
+            }
+            else if (f.y[i] + midPoint > height)
+            {
+                f.y[i] = height - midPoint;
+                f.velocityY[i] = -f.velocityY[i];
+            }
+        }
+        else if (collision == ScreenCollision::Wrap)
+        {
+            if (f.x[i] < -midPoint)
+            {
+                f.x[i] = width + midPoint;
+            }
+            else if (f.x[i] > width + midPoint)
+            {
+                f.x[i] = -midPoint;
+            }
+            else if (f.y[i] < -midPoint)
+            {
+                f.y[i] = height + midPoint;
+            }
+            else if (f.y[i] > height + midPoint)
+            {
+                f.y[i] = -midPoint;
+            }
+        }
+
+        p.x[i] = f.x[i].toFloat();
+        p.y[i] = f.y[i].toFloat();
+        p.velocityX[i] = f.velocityX[i].toFloat();
+        p.velocityY[i] = f.velocityY[i].toFloat();
+    }
+}
+
+
+void runScalar(const ParticleArrays& p, int begin, int end, bool integrate, float dt,
+               ScreenCollision collision, float width, float height)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (integrate)
+        {
+            integrateScalar(p, i, dt);
+        }
+
+        if (collision == ScreenCollision::Bounce)
+        {
+            bounceScalar(p, i, width, height);
+        }
+        else if (collision == ScreenCollision::Wrap)
+        {
+            wrapScalar(p, i, width, height);
+        }
+    }
+}
+
+
+#ifdef KERNEL_X86
+
+/** --------------------------------------------------------------------------------------
+ SSE2 path, four particles per iteration. Branches become masks, a masked value is picked
+ with and / andnot / or and velocity is negated by flipping its sign bit, which is exactly
+ what multiplying by -1 does
+ */
+KERNEL_TARGET_SSE2
+inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+
+KERNEL_TARGET_SSE2
+void runSSE2(const ParticleArrays& p, int begin, int end, bool integrate, float dt,
+             ScreenCollision collision, float width, float height)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 dt4 = _mm_set1_ps(dt);
+    const __m128 w = _mm_set1_ps(width);
+    const __m128 h = _mm_set1_ps(height);
+
+    int i = begin;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(p.x + i);
+        __m128 y = _mm_loadu_ps(p.y + i);
+        __m128 vx = _mm_loadu_ps(p.velocityX + i);
+        __m128 vy = _mm_loadu_ps(p.velocityY + i);
+
+        if (integrate)
+        {
+            __m128 f = _mm_loadu_ps(p.friction + i);
+            __m128 g = _mm_loadu_ps(p.gravity + i);
+
+            vx = _mm_mul_ps(vx, f);
+            vy = _mm_mul_ps(vy, f);
+            vy = _mm_add_ps(vy, _mm_mul_ps(g, dt4));
+            x = _mm_add_ps(x, _mm_mul_ps(vx, dt4));
+            y = _mm_add_ps(y, _mm_mul_ps(vy, dt4));
+        }
+
+        if (collision == ScreenCollision::Bounce)
+        {
+            __m128 m = _mm_loadu_ps(p.radius + i);
+
+            __m128 left = _mm_cmplt_ps(_mm_sub_ps(x, m), zero);
+            __m128 right = _mm_andnot_ps(left, _mm_cmpgt_ps(_mm_add_ps(x, m), w));
+            x = select4(left, _mm_add_ps(zero, m), x);
+            x = select4(right, _mm_sub_ps(w, m), x);
+            vx = _mm_xor_ps(vx, _mm_and_ps(_mm_or_ps(left, right), sign));
+
+            __m128 top = _mm_cmplt_ps(_mm_sub_ps(y, m), zero);
+            __m128 bottom = _mm_andnot_ps(top, _mm_cmpgt_ps(_mm_add_ps(y, m), h));
+            y = select4(top, _mm_add_ps(zero, m), y);
+            y = select4(bottom, _mm_sub_ps(h, m), y);
+            vy = _mm_xor_ps(vy, _mm_and_ps(_mm_or_ps(top, bottom), sign));
+        }
+        else if (collision == ScreenCollision::Wrap)
+        {
+            __m128 m = _mm_loadu_ps(p.radius + i);
+            __m128 negative = _mm_sub_ps(zero, m);
+
+            // Only the first edge that matches wraps, as in ColDet::wrapScreen
+            __m128 left = _mm_cmplt_ps(x, negative);
+            __m128 done = left;
+            __m128 right = _mm_andnot_ps(done, _mm_cmpgt_ps(x, _mm_add_ps(w, m)));
+            done = _mm_or_ps(done, right);
+            __m128 top = _mm_andnot_ps(done, _mm_cmplt_ps(y, negative));
+            done = _mm_or_ps(done, top);
+            __m128 bottom = _mm_andnot_ps(done, _mm_cmpgt_ps(y, _mm_add_ps(h, m)));
+
+            x = select4(left, _mm_add_ps(w, m), x);
+            x = select4(right, negative, x);
+            y = select4(top, _mm_add_ps(h, m), y);
+            y = select4(bottom, negative, y);
+        }
+
+        _mm_storeu_ps(p.x + i, x);
+        _mm_storeu_ps(p.y + i, y);
+        _mm_storeu_ps(p.velocityX + i, vx);
+        _mm_storeu_ps(p.velocityY + i, vy);
+    }
+
+    runScalar(p, i, end, integrate, dt, collision, width, height);
+}
+
+
+#ifdef KERNEL_HAVE_AVX2
+
+/** --------------------------------------------------------------------------------------
+ AVX2 path, eight particles per iteration, otherwise identical to the SSE2 path
+ */
+KERNEL_TARGET_AVX2
+void runAVX2(const ParticleArrays& p, int begin, int end, bool integrate, float dt,
+             ScreenCollision collision, float width, float height)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 dt8 = _mm256_set1_ps(dt);
+    const __m256 w = _mm256_set1_ps(width);
+    const __m256 h = _mm256_set1_ps(height);
+
+    int i = begin;
+
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(p.x + i);
+        __m256 y = _mm256_loadu_ps(p.y + i);
+        __m256 vx = _mm256_loadu_ps(p.velocityX + i);
+        __m256 vy = _mm256_loadu_ps(p.velocityY + i);
+
+        if (integrate)
+        {
+            __m256 f = _mm256_loadu_ps(p.friction + i);
+            __m256 g = _mm256_loadu_ps(p.gravity + i);
+
+            vx = _mm256_mul_ps(vx, f);
+            vy = _mm256_mul_ps(vy, f);
+            vy = _mm256_add_ps(vy, _mm256_mul_ps(g, dt8));
+            x = _mm256_add_ps(x, _mm256_mul_ps(vx, dt8));
+            y = _mm256_add_ps(y, _mm256_mul_ps(vy, dt8));
+        }
+
+        if (collision == ScreenCollision::Bounce)
+        {
+            __m256 m = _mm256_loadu_ps(p.radius + i);
+
+            __m256 left = _mm256_cmp_ps(_mm256_sub_ps(x, m), zero, _CMP_LT_OQ);
+            __m256 right = _mm256_andnot_ps(left, _mm256_cmp_ps(_mm256_add_ps(x, m), w, _CMP_GT_OQ));
+            x = _mm256_blendv_ps(x, _mm256_add_ps(zero, m), left);
+            x = _mm256_blendv_ps(x, _mm256_sub_ps(w, m), right);
+            vx = _mm256_xor_ps(vx, _mm256_and_ps(_mm256_or_ps(left, right), sign));
+
+            __m256 top = _mm256_cmp_ps(_mm256_sub_ps(y, m), zero, _CMP_LT_OQ);
+            __m256 bottom = _mm256_andnot_ps(top, _mm256_cmp_ps(_mm256_add_ps(y, m), h, _CMP_GT_OQ));
+            y = _mm256_blendv_ps(y, _mm256_add_ps(zero, m), top);
+            y = _mm256_blendv_ps(y, _mm256_sub_ps(h, m), bottom);
+            vy = _mm256_xor_ps(vy, _mm256_and_ps(_mm256_or_ps(top, bottom), sign));
+        }
+        else if (collision == ScreenCollision::Wrap)
+        {
+            __m256 m = _mm256_loadu_ps(p.radius + i);
+            __m256 negative = _mm256_sub_ps(zero, m);
+
+            __m256 left = _mm256_cmp_ps(x, negative, _CMP_LT_OQ);
+            __m256 done = left;
+            __m256 right = _mm256_andnot_ps(done, _mm256_cmp_ps(x, _mm256_add_ps(w, m), _CMP_GT_OQ));
+            done = _mm256_or_ps(done, right);
+            __m256 top = _mm256_andnot_ps(done, _mm256_cmp_ps(y, negative, _CMP_LT_OQ));
+            done = _mm256_or_ps(done, top);
+            __m256 bottom = _mm256_andnot_ps(done, _mm256_cmp_ps(y, _mm256_add_ps(h, m), _CMP_GT_OQ));
+
+            x = _mm256_blendv_ps(x, _mm256_add_ps(w, m), left);
+            x = _mm256_blendv_ps(x, negative, right);
+            y = _mm256_blendv_ps(y, _mm256_add_ps(h, m), top);
+            y = _mm256_blendv_ps(y, negative, bottom);
+        }
+
+        _mm256_storeu_ps(p.x + i, x);
+        _mm256_storeu_ps(p.y + i, y);
+        _mm256_storeu_ps(p.velocityX + i, vx);
+        _mm256_storeu_ps(p.velocityY + i, vy);
+    }
+
+    runScalar(p, i, end, integrate, dt, collision, width, height);
+}
+
+#endif /* KERNEL_HAVE_AVX2 */
+#endif /* KERNEL_X86 */
+
+
+/** --------------------------------------------------------------------------------------
+ Picks the fastest path the CPU and operating system support
+ */
+ParticleKernel::Path detectPath()
+{
+#ifdef KERNEL_HAVE_AVX2
+    if (SDL_HasAVX2())
+    {
+        return ParticleKernel::AVX2;
+    }
+#endif
+#ifdef KERNEL_X86
+    if (SDL_HasSSE2())
+    {
+        return ParticleKernel::SSE2;
+    }
+#endif
+    return ParticleKernel::Scalar;
+}
+
+
+ParticleKernel::Path currentPath = detectPath();
+
+
+void run(const ParticleArrays& p, int begin, int end, bool integrate, float dt,
+         ScreenCollision collision, float width, float height)
+{
+    switch (currentPath)
+    {
+#ifdef KERNEL_HAVE_AVX2
+        case ParticleKernel::AVX2:
+            runAVX2(p, begin, end, integrate, dt, collision, width, height);
+            break;
+#endif
+#ifdef KERNEL_X86
+        case ParticleKernel::SSE2:
+            runSSE2(p, begin, end, integrate, dt, collision, width, height);
+            break;
+#endif
+        default:
+            runScalar(p, begin, end, integrate, dt, collision, width, height);
+            break;
+    }
+}
+
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the path the kernel currently runs on
+
+ @returns The active kernel path
+ */
+ParticleKernel::Path ParticleKernel::getPath() { return currentPath; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Forces the kernel onto a path, to measure or check one path against another. Asking for
+ a path the CPU does not support falls back to the best supported path below it
+
+ @param path  Path to run on
+ */
+void ParticleKernel::setPath(Path path)
+{
+    Path supported = detectPath();
+    currentPath = path < supported ? path : supported;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a human readable name of the active path
+
+ @returns "scalar", "sse2" or "avx2"
+ */
+const char* ParticleKernel::getPathName()
+{
+    switch (currentPath)
+    {
+        case AVX2: return "avx2";
+        case SSE2: return "sse2";
+        default:   return "scalar";
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Runs every path the CPU supports on the same particles, bouncing and wrapping them on
+ the screen edges in turn, and compares each with the scalar path. The count is best left
+ odd so the scalar tail of the vector paths is checked too. The kernel is left on the
+ path it was on
+
+ @param count  Number of particles
+ @param steps  Number of steps to run each path for
+ @returns      True if every path stayed within KERNEL_EPSILON of the scalar path
+ */
+bool ParticleKernel::checkPaths(int count, int steps)
+{
+    const Path previous = currentPath;
+    const Path supported = detectPath();
+
+    // Small linear congruential generator, the same particles on every platform
+    unsigned int seed = 12345;
+    auto random = [&seed](float low, float high) -> float
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return low + (high - low) * ((seed >> 8) / 16777216.0f);
+    };
+
+    // x, y, velocity x, velocity y, friction, gravity and radius one after another
+    std::vector<float> start(count * 7);
+    const float ranges[7][2] = {{0, 1280}, {0, 720}, {-8, 8}, {-8, 8}, {0.95f, 1}, {0, 0.5f}, {1, 32}};
+
+    for (int array = 0; array < 7; array++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            start[array * count + i] = random(ranges[array][0], ranges[array][1]);
+        }
+    }
+
+    std::vector<float> scalar;
+    bool passed = true;
+
+    for (int path = Scalar; path <= supported; path++)
+    {
+        std::vector<float> values(start);
+        float* arrays[7];
+
+        for (int array = 0; array < 7; array++)
+        {
+            arrays[array] = values.data() + array * count;
+        }
+
+        ParticleArrays p = {arrays[0], arrays[1], arrays[2], arrays[3], arrays[4], arrays[5], arrays[6]};
+
+        currentPath = (Path)path;
+
+        for (int step = 0; step < steps; step++)
+        {
+            integrateAndCollide(p, 0, count, 1, step % 2 == 0 ? ScreenCollision::Bounce : ScreenCollision::Wrap,
+                                1280, 720);
+        }
+
+        if (path == Scalar)
+        {
+            scalar.swap(values);
+            continue;
+        }
+
+        // Only positions and velocities are stepped
+        float largest = 0;
+
+        for (int i = 0; i < count * 4; i++)
+        {
+            largest = std::max(largest, fabsf(values[i] - scalar[i]) / std::max(fabsf(scalar[i]), 1.0f));
+        }
+
+        printf("Particle kernel %s: largest difference from scalar %g\n", getPathName(), largest);
+
+        passed = passed && largest <= KERNEL_EPSILON;
+    }
+
+    currentPath = previous;
+    return passed;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Applies friction and gravity to the velocity of each particle and moves it by that
+ velocity. Friction is the per step friction, dt scales gravity and movement
+
+ @param p      Packed particle arrays
+ @param begin  First dense index to update
+ @param end    One past the last dense index to update
+ @param dt     Length of the step in 60hz frames
+ */
+void ParticleKernel::integrate(const ParticleArrays& p, int begin, int end, float dt)
+{
+    run(p, begin, end, true, dt, ScreenCollision::None, 0, 0);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces or wraps each particle on the edges of the screen using its radius as midpoint
+
+ @param p          Packed particle arrays
+ @param begin      First dense index to collide
+ @param end        One past the last dense index to collide
+ @param collision  Whether particles bounce or wrap on the screen edges
+ @param width      Width of the screen
+ @param height     Height of the screen
+ */
+void ParticleKernel::collide(const ParticleArrays& p, int begin, int end, ScreenCollision collision, float width, float height)
+{
+    if (collision != ScreenCollision::None)
+    {
+        run(p, begin, end, false, 1, collision, width, height);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Integrates and then collides each particle in a single pass over the arrays
+
+ @param p          Packed particle arrays
+ @param begin      First dense index to update
+ @param end        One past the last dense index to update
+ @param dt         Length of the step in 60hz frames
+ @param collision  Whether particles bounce or wrap on the screen edges
+ @param width      Width of the screen
+ @param height     Height of the screen
+ */
+void ParticleKernel::integrateAndCollide(const ParticleArrays& p, int begin, int end, float dt,
+                                         ScreenCollision collision, float width, float height)
+{
+    run(p, begin, end, true, dt, collision, width, height);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Integrates particles in fixed point, as integrate does in float, and refreshes their
+ float copies
+
+ @param p      Packed particle arrays, the float copy of the state
+ @param f      Packed fixed point state
+ @param begin  First dense index to update
+ @param end    One past the last dense index to update
+ @param dt     Length of the step in 60hz frames
+ */
+void ParticleKernel::integrate(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end, Fixed dt)
+{
+    runFixed(p, f, begin, end, true, dt, ScreenCollision::None, Fixed(), Fixed());
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Bounces or wraps particles in fixed point, as collide does in float, and refreshes their
+ float copies
+
+ @param p          Packed particle arrays, the float copy of the state
+ @param f          Packed fixed point state
+ @param begin      First dense index to collide
+ @param end        One past the last dense index to collide
+ @param collision  Whether particles bounce or wrap on the screen edges
+ @param width      Width of the screen
+ @param height     Height of the screen
+ */
+void ParticleKernel::collide(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end,
+                             ScreenCollision collision, int width, int height)
+{
+    if (collision != ScreenCollision::None)
+    {
+        runFixed(p, f, begin, end, false, Fixed(), collision, Fixed::fromInt(width), Fixed::fromInt(height));
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Integrates and then collides particles in fixed point in a single pass over the arrays
+
+ @param p          Packed particle arrays, the float copy of the state
+ @param f          Packed fixed point state
+ @param begin      First dense index to update
+ @param end        One past the last dense index to update
+ @param dt         Length of the step in 60hz frames
+ @param collision  Whether particles bounce or wrap on the screen edges
+ @param width      Width of the screen
+ @param height     Height of the screen
+ */
+void ParticleKernel::integrateAndCollide(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end,
+                                         Fixed dt, ScreenCollision collision, int width, int height)
+{
+    runFixed(p, f, begin, end, true, dt, collision, Fixed::fromInt(width), Fixed::fromInt(height));
+}
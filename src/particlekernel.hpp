@@ -0,0 +1,73 @@
+#ifndef particlekernel_hpp
+#define particlekernel_hpp
+
+/**
+ Batch integration and screen collision for packed particle arrays. The work is done by a
+ scalar, an SSE2 or an AVX2 path, the fastest one the CPU supports is picked at runtime.
+ Every path does the same IEEE operations in the same order without fused multiply-add,
+ so results match the scalar path bit for bit in practice. The documented tolerance
+ between paths is KERNEL_EPSILON relative to the magnitude of the value, or absolute for
+ values under 1, and checkPaths holds every supported path to it
+ */
+
+#define KERNEL_EPSILON 1e-6f
+
+#include "fixed.hpp"
+
+
+struct ParticleArrays
+{
+    float *x, *y, *velocityX, *velocityY;
+    const float *friction, *gravity, *radius;
+};
+
+
+/**
+ Fixed point state of the particles in deterministic mode. The float arrays are kept as a
+ copy of it for drawing, gravity and radius are read from the float arrays as they are
+ only ever set, never stepped
+ */
+struct FixedParticleArrays
+{
+    Fixed *x, *y, *velocityX, *velocityY;
+    const Fixed *friction;
+};
+
+
+enum class ScreenCollision
+{
+    None,
+    Bounce,
+    Wrap
+};
+
+
+class ParticleKernel
+{
+public:
+    enum Path
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    static Path getPath();
+    static void setPath(Path path);
+    static const char* getPathName();
+    static bool checkPaths(int count, int steps);
+
+    static void integrate(const ParticleArrays& p, int begin, int end, float dt);
+    static void collide(const ParticleArrays& p, int begin, int end, ScreenCollision collision, float width, float height);
+    static void integrateAndCollide(const ParticleArrays& p, int begin, int end, float dt,
+                                    ScreenCollision collision, float width, float height);
+
+    static void integrate(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end, Fixed dt);
+    static void collide(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end,
+                        ScreenCollision collision, int width, int height);
+    static void integrateAndCollide(const ParticleArrays& p, const FixedParticleArrays& f, int begin, int end,
+                                    Fixed dt, ScreenCollision collision, int width, int height);
+};
+
+
+#endif /* particlekernel_hpp */
@@ -0,0 +1,646 @@
+#include "particlesystem.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty particle system
+
+ */
+ParticleSystem::ParticleSystem()
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty particle system with room for a number of particles, so adding up to
+ that many particles does not reallocate the underlying arrays
+
+ @param capacity  Number of particles to reserve space for
+ */
+ParticleSystem::ParticleSystem(int capacity)
+{
+    reserve(capacity);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reserves space for a number of particles in every array of the system
+
+ @param capacity  Number of particles to reserve space for
+ */
+void ParticleSystem::reserve(int capacity)
+{
+    x.reserve(capacity);
+    y.reserve(capacity);
+    previousX.reserve(capacity);
+    previousY.reserve(capacity);
+    velocityX.reserve(capacity);
+    velocityY.reserve(capacity);
+    friction.reserve(capacity);
+    gravity.reserve(capacity);
+    frictionStep.reserve(capacity);
+    radius.reserve(capacity);
+    ids.reserve(capacity);
+    indices.reserve(capacity);
+
+    if (deterministic)
+    {
+        fixedX.reserve(capacity);
+        fixedY.reserve(capacity);
+        fixedVelocityX.reserve(capacity);
+        fixedVelocityY.reserve(capacity);
+        fixedFrictionStep.reserve(capacity);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Switches the system between float and fixed point state. In deterministic mode particles
+ move in Q16.16 fixed point with integer arithmetic only, so the same inputs give the same
+ positions on every machine, and the float arrays are copies of the fixed point state.
+ Particles already in the system are carried over
+
+ @param deterministic  True to simulate in fixed point
+ */
+void ParticleSystem::setDeterministic(bool deterministic)
+{
+    if (deterministic == this->deterministic)
+    {
+        return;
+    }
+
+    this->deterministic = deterministic;
+
+    fixedX.clear();
+    fixedY.clear();
+    fixedVelocityX.clear();
+    fixedVelocityY.clear();
+    fixedFrictionStep.clear();
+
+    if (!deterministic)
+    {
+        return;
+    }
+
+    reserve(x.capacity());
+
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        fixedX.push_back(Fixed::fromFloat(x[i]));
+        fixedY.push_back(Fixed::fromFloat(y[i]));
+        fixedVelocityX.push_back(Fixed::fromFloat(velocityX[i]));
+        fixedVelocityY.push_back(Fixed::fromFloat(velocityY[i]));
+        fixedFrictionStep.push_back(Fixed());
+    }
+
+    updateFrictionStep(stepDt);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets whether the system simulates in fixed point
+
+ @returns True in deterministic mode
+ */
+bool ParticleSystem::isDeterministic() const { return deterministic; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds a new particle to the system
+
+ @param x        Position of the particle on the x axis
+ @param y        Position of the particle on the y axis
+ @param speed    Speed the particle moves, used to calculate the initial velocity
+ @param heading  Direction of the particle in radians, used to calculate the velocity
+ @param friction Amount of friction acting on this particle (0.8 - 1 recommended)
+ @param gravity  Gravity applied to particle (0.1 - 1 recommended)
+ @returns        Id of the new particle, stays valid until the particle is removed
+ */
+int ParticleSystem::add(float x, float y, float speed, float heading, float friction, float gravity)
+{
+    int id;
+
+    // Reuse the id of a removed particle if there is one, otherwise make a new one
+    if (!freeIds.empty())
+    {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else
+    {
+        id = indices.size();
+        indices.push_back(-1);
+    }
+
+    indices[id] = ids.size();
+    ids.push_back(id);
+
+    Vec2 velocity;
+
+    if (deterministic)
+    {
+        // Launch along a table angle rather than cosf / sinf, then start the float copy
+        // from the fixed point state so both agree
+        const FixedVec2 fixedVelocity = FixedVec2::fromAngle(fixedAngleFromRadians(heading)) * Fixed::fromFloat(speed);
+
+        fixedX.push_back(Fixed::fromFloat(x));
+        fixedY.push_back(Fixed::fromFloat(y));
+        fixedVelocityX.push_back(fixedVelocity.x);
+        fixedVelocityY.push_back(fixedVelocity.y);
+        fixedFrictionStep.push_back(fixedPow(Fixed::fromFloat(friction), Fixed::fromFloat(stepDt)));
+
+        x = fixedX.back().toFloat();
+        y = fixedY.back().toFloat();
+        velocity = fixedVelocity.toVec2();
+    }
+    else
+    {
+        velocity = Vec2::fromAngle(heading) * speed;
+    }
+
+    this->x.push_back(x);
+    this->y.push_back(y);
+    previousX.push_back(x);
+    previousY.push_back(y);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    this->friction.push_back(friction);
+    this->gravity.push_back(gravity);
+    frictionStep.push_back(stepDt == 1 ? friction : powf(friction, stepDt));
+    radius.push_back(0);
+
+    return id;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Removes a particle from the system. The last particle is moved into the gap so the arrays
+ stay packed, which means dense indices are not stable but ids are
+
+ @param id  Id of the particle to remove
+ */
+void ParticleSystem::remove(int id)
+{
+    if (!isAlive(id))
+    {
+        return;
+    }
+
+    int index = indices[id];
+    int last = ids.size() - 1;
+
+    if (index != last)
+    {
+        x[index] = x[last];
+        y[index] = y[last];
+        previousX[index] = previousX[last];
+        previousY[index] = previousY[last];
+        velocityX[index] = velocityX[last];
+        velocityY[index] = velocityY[last];
+        friction[index] = friction[last];
+        gravity[index] = gravity[last];
+        frictionStep[index] = frictionStep[last];
+        radius[index] = radius[last];
+
+        if (deterministic)
+        {
+            fixedX[index] = fixedX[last];
+            fixedY[index] = fixedY[last];
+            fixedVelocityX[index] = fixedVelocityX[last];
+            fixedVelocityY[index] = fixedVelocityY[last];
+            fixedFrictionStep[index] = fixedFrictionStep[last];
+        }
+
+        ids[index] = ids[last];
+        indices[ids[index]] = index;
+    }
+
+    x.pop_back();
+    y.pop_back();
+    previousX.pop_back();
+    previousY.pop_back();
+    velocityX.pop_back();
+    velocityY.pop_back();
+    friction.pop_back();
+    gravity.pop_back();
+    frictionStep.pop_back();
+    radius.pop_back();
+    ids.pop_back();
+
+    if (deterministic)
+    {
+        fixedX.pop_back();
+        fixedY.pop_back();
+        fixedVelocityX.pop_back();
+        fixedVelocityY.pop_back();
+        fixedFrictionStep.pop_back();
+    }
+
+    indices[id] = -1;
+    freeIds.push_back(id);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Removes every particle from the system, previously handed out ids become invalid
+
+ */
+void ParticleSystem::clear()
+{
+    x.clear();
+    y.clear();
+    previousX.clear();
+    previousY.clear();
+    velocityX.clear();
+    velocityY.clear();
+    friction.clear();
+    gravity.clear();
+    frictionStep.clear();
+    radius.clear();
+    fixedX.clear();
+    fixedY.clear();
+    fixedVelocityX.clear();
+    fixedVelocityY.clear();
+    fixedFrictionStep.clear();
+    ids.clear();
+    indices.clear();
+    freeIds.clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether an id refers to a particle that is still in the system
+
+ @param id  Id of the particle
+ @returns   True if the particle has not been removed
+ */
+bool ParticleSystem::isAlive(int id) const
+{
+    return id >= 0 && id < (int)indices.size() && indices[id] != -1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of live particles, which is also the length of the batch arrays
+
+ @returns The number of particles in the system
+ */
+int ParticleSystem::size() const { return ids.size(); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the id of the particle stored at a dense index
+
+ @param index  Dense index into the batch arrays
+ @returns      Id of the particle at that index
+ */
+int ParticleSystem::getId(int index) const { return ids[index]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the dense index of a particle, only valid until the next particle is removed
+
+ @param id  Id of the particle
+ @returns   Dense index into the batch arrays
+ */
+int ParticleSystem::getIndex(int id) const { return indices[id]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets and sets the position, velocity and characteristics of a particle by id. In
+ deterministic mode set values are rounded to fixed point, so the float copy always
+ matches the state that is simulated
+ */
+float ParticleSystem::getPositionX(int id) const { return x[indices[id]]; }
+float ParticleSystem::getPositionY(int id) const { return y[indices[id]]; }
+
+void ParticleSystem::setPositionX(int id, float x)
+{
+    int i = indices[id];
+
+    if (deterministic)
+    {
+        fixedX[i] = Fixed::fromFloat(x);
+        x = fixedX[i].toFloat();
+    }
+
+    this->x[i] = x;
+}
+
+void ParticleSystem::setPositionY(int id, float y)
+{
+    int i = indices[id];
+
+    if (deterministic)
+    {
+        fixedY[i] = Fixed::fromFloat(y);
+        y = fixedY[i].toFloat();
+    }
+
+    this->y[i] = y;
+}
+
+float ParticleSystem::getVelocityX(int id) const { return velocityX[indices[id]]; }
+float ParticleSystem::getVelocityY(int id) const { return velocityY[indices[id]]; }
+
+void ParticleSystem::setVelocityX(int id, float velocityX)
+{
+    int i = indices[id];
+
+    if (deterministic)
+    {
+        fixedVelocityX[i] = Fixed::fromFloat(velocityX);
+        velocityX = fixedVelocityX[i].toFloat();
+    }
+
+    this->velocityX[i] = velocityX;
+}
+
+void ParticleSystem::setVelocityY(int id, float velocityY)
+{
+    int i = indices[id];
+
+    if (deterministic)
+    {
+        fixedVelocityY[i] = Fixed::fromFloat(velocityY);
+        velocityY = fixedVelocityY[i].toFloat();
+    }
+
+    this->velocityY[i] = velocityY;
+}
+
+Vec2 ParticleSystem::getPosition(int id) const { int i = indices[id]; return Vec2(x[i], y[i]); }
+Vec2 ParticleSystem::getVelocity(int id) const { int i = indices[id]; return Vec2(velocityX[i], velocityY[i]); }
+
+void ParticleSystem::setPosition(int id, const Vec2& position)
+{
+    setPositionX(id, position.x);
+    setPositionY(id, position.y);
+}
+
+void ParticleSystem::setVelocity(int id, const Vec2& velocity)
+{
+    if (deterministic)
+    {
+        setFixedVelocity(id, FixedVec2::fromVec2(velocity));
+        return;
+    }
+
+    int i = indices[id];
+    velocityX[i] = velocity.x;
+    velocityY[i] = velocity.y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets and sets the fixed point position and velocity of a particle by id, only valid in
+ deterministic mode. Setting the velocity also updates its float copy
+ */
+FixedVec2 ParticleSystem::getFixedPosition(int id) const { int i = indices[id]; return FixedVec2(fixedX[i], fixedY[i]); }
+FixedVec2 ParticleSystem::getFixedVelocity(int id) const { int i = indices[id]; return FixedVec2(fixedVelocityX[i], fixedVelocityY[i]); }
+
+void ParticleSystem::setFixedVelocity(int id, const FixedVec2& velocity)
+{
+    int i = indices[id];
+    fixedVelocityX[i] = velocity.x;
+    fixedVelocityY[i] = velocity.y;
+    velocityX[i] = velocity.x.toFloat();
+    velocityY[i] = velocity.y.toFloat();
+}
+
+float ParticleSystem::getFriction(int id) const { return friction[indices[id]]; }
+float ParticleSystem::getGravity(int id) const { return gravity[indices[id]]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets and sets the collision radius of a particle, used as the midpoint when colliding the
+ particle with the edges of the screen. New particles have a radius of 0
+ */
+float ParticleSystem::getRadius(int id) const { return radius[indices[id]]; }
+void ParticleSystem::setRadius(int id, float radius) { this->radius[indices[id]] = radius; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the position of a particle blended between the start and the end of the last
+ simulation step
+
+ @param id     Id of the particle
+ @param alpha  How far between the two positions to blend, 0 is the start and 1 the end
+ @returns      The interpolated position
+ */
+float ParticleSystem::getInterpolatedX(int id, float alpha) const
+{
+    int i = indices[id];
+    return previousX[i] + (x[i] - previousX[i]) * alpha;
+}
+
+float ParticleSystem::getInterpolatedY(int id, float alpha) const
+{
+    int i = indices[id];
+    return previousY[i] + (y[i] - previousY[i]) * alpha;
+}
+
+Vec2 ParticleSystem::getInterpolated(int id, float alpha) const
+{
+    int i = indices[id];
+    return lerp(Vec2(previousX[i], previousY[i]), Vec2(x[i], y[i]), alpha);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Remembers the current position of every particle as the start of the next simulation
+ step, call once per step before anything moves the particles
+
+ */
+void ParticleSystem::savePositions()
+{
+    previousX = x;
+    previousY = y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the packed arrays for use by the batch kernels, the friction array holds the per
+ step friction for the last dt the system was updated with
+
+ @returns Pointers to the packed arrays, invalidated when particles are added or removed
+ */
+ParticleArrays ParticleSystem::getArrays()
+{
+    ParticleArrays arrays = {x.data(), y.data(), velocityX.data(), velocityY.data(),
+                             frictionStep.data(), gravity.data(), radius.data()};
+    return arrays;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the packed fixed point arrays for use by the deterministic kernels, only valid in
+ deterministic mode
+
+ @returns Pointers to the packed arrays, invalidated when particles are added or removed
+ */
+FixedParticleArrays ParticleSystem::getFixedArrays()
+{
+    FixedParticleArrays arrays = {fixedX.data(), fixedY.data(), fixedVelocityX.data(), fixedVelocityY.data(),
+                                  fixedFrictionStep.data()};
+    return arrays;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the packed batch arrays, indexed by dense index from 0 to size() - 1. Pointers are
+ invalidated when particles are added or removed
+ */
+float* ParticleSystem::getPositionsX() { return x.data(); }
+float* ParticleSystem::getPositionsY() { return y.data(); }
+float* ParticleSystem::getVelocitiesX() { return velocityX.data(); }
+float* ParticleSystem::getVelocitiesY() { return velocityY.data(); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Friction is specified per 60hz frame, so when stepping by a different dt the per step
+ friction is friction ^ dt. That is recalculated only when dt changes, which with a fixed
+ step is once, keeping powf out of the batch loop
+
+ @param dt  Length of the step in 60hz frames
+ */
+void ParticleSystem::updateFrictionStep(float dt)
+{
+    stepDt = dt;
+
+    for (size_t i = 0; i < friction.size(); i++)
+    {
+        frictionStep[i] = dt == 1 ? friction[i] : powf(friction[i], dt);
+    }
+
+    if (deterministic)
+    {
+        const Fixed step = Fixed::fromFloat(dt);
+
+        for (size_t i = 0; i < friction.size(); i++)
+        {
+            fixedFrictionStep[i] = fixedPow(Fixed::fromFloat(friction[i]), step);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Updates every particle in the system by applying friction and gravity to its velocity and
+ then moving it by that velocity
+
+ @param dt  Length of the step in 60hz frames, 1 matches the original per frame update
+ */
+void ParticleSystem::update(float dt)
+{
+    update(dt, ScreenCollision::None, 0, 0);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Updates every particle in the system and then bounces or wraps it on the edges of the
+ screen, both in a single pass over the arrays
+
+ @param dt             Length of the step in 60hz frames
+ @param collision      Whether particles bounce or wrap on the screen edges
+ @param SCREEN_WIDTH   Width of the screen
+ @param SCREEN_HEIGHT  Height of the screen
+ */
+void ParticleSystem::update(float dt, ScreenCollision collision, int SCREEN_WIDTH, int SCREEN_HEIGHT)
+{
+    prepareUpdate(dt);
+
+    if (deterministic)
+    {
+        ParticleKernel::integrateAndCollide(getArrays(), getFixedArrays(), 0, size(), Fixed::fromFloat(dt),
+                                            collision, SCREEN_WIDTH, SCREEN_HEIGHT);
+        return;
+    }
+
+    ParticleKernel::integrateAndCollide(getArrays(), 0, size(), dt, collision, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the system ready to be updated in ranges by dt, call once before the ranges run
+
+ @param dt  Length of the step in 60hz frames
+ */
+void ParticleSystem::prepareUpdate(float dt)
+{
+    if (dt != stepDt)
+    {
+        updateFrictionStep(dt);
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Updates the particles in a range of dense indices, as update does for every particle.
+ Ranges that do not overlap can be updated on different threads at the same time
+
+ @param dt     Length of the step in 60hz frames, the same dt passed to prepareUpdate
+ @param begin  First dense index to update
+ @param end    One past the last dense index to update
+ */
+void ParticleSystem::updateRange(float dt, int begin, int end)
+{
+    if (deterministic)
+    {
+        ParticleKernel::integrate(getArrays(), getFixedArrays(), begin, end, Fixed::fromFloat(dt));
+        return;
+    }
+
+    ParticleKernel::integrate(getArrays(), begin, end, dt);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Updates a single particle, used when a particle is stepped on its own rather than as part
+ of the batch
+
+ @param id  Id of the particle to update
+ @param dt  Length of the step in 60hz frames, 1 matches the original per frame update
+ */
+void ParticleSystem::update(int id, float dt)
+{
+    int i = indices[id];
+
+    if (deterministic)
+    {
+        prepareUpdate(dt);
+        ParticleKernel::integrate(getArrays(), getFixedArrays(), i, i + 1, Fixed::fromFloat(dt));
+        return;
+    }
+
+    float f = dt == 1 ? friction[i] : powf(friction[i], dt);
+
+    velocityX[i] *= f;
+    velocityY[i] *= f;
+    velocityY[i] += gravity[i] * dt;
+    x[i] += velocityX[i] * dt;
+    y[i] += velocityY[i] * dt;
+}
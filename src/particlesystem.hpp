@@ -0,0 +1,97 @@
+#ifndef particlesystem_hpp
+#define particlesystem_hpp
+
+#include <cmath>
+#include <vector>
+#include "particlekernel.hpp"
+#include "math2d.hpp"
+
+
+class ParticleSystem
+{
+private:
+    // Particle state is stored as a structure of arrays so the batch update streams
+    // through contiguous floats instead of hopping between heap allocated particles
+    std::vector<float> x, y, velocityX, velocityY, friction, gravity, frictionStep, radius;
+
+    // Positions at the start of the current simulation step, used to interpolate between
+    // steps when rendering faster than the simulation runs
+    std::vector<float> previousX, previousY;
+
+    // Particles are addressed by a stable id, ids map to a dense index and back so the
+    // arrays can stay packed when a particle is removed
+    std::vector<int> ids, indices, freeIds;
+
+    // Fixed point state used in deterministic mode, the float arrays above then only hold a
+    // copy of it for drawing and for code that reads the particles without changing them
+    std::vector<Fixed> fixedX, fixedY, fixedVelocityX, fixedVelocityY, fixedFrictionStep;
+    bool deterministic = false;
+
+    float stepDt = 1;
+
+    void updateFrictionStep(float dt);
+
+public:
+    ParticleSystem();
+    ParticleSystem(int capacity);
+
+    int add(float x, float y, float speed, float heading, float friction, float gravity);
+    void remove(int id);
+    void clear();
+    void reserve(int capacity);
+
+    void setDeterministic(bool deterministic);
+    bool isDeterministic() const;
+
+    bool isAlive(int id) const;
+    int size() const;
+    int getId(int index) const;
+    int getIndex(int id) const;
+
+    float getPositionX(int id) const;
+    float getPositionY(int id) const;
+    void setPositionX(int id, float x);
+    void setPositionY(int id, float y);
+
+    float getVelocityX(int id) const;
+    float getVelocityY(int id) const;
+    void setVelocityX(int id, float velocityX);
+    void setVelocityY(int id, float velocityY);
+
+    Vec2 getPosition(int id) const;
+    Vec2 getVelocity(int id) const;
+    void setPosition(int id, const Vec2& position);
+    void setVelocity(int id, const Vec2& velocity);
+
+    FixedVec2 getFixedPosition(int id) const;
+    FixedVec2 getFixedVelocity(int id) const;
+    void setFixedVelocity(int id, const FixedVec2& velocity);
+
+    float getFriction(int id) const;
+    float getGravity(int id) const;
+    float getRadius(int id) const;
+    void setRadius(int id, float radius);
+
+    float* getPositionsX();
+    float* getPositionsY();
+    float* getVelocitiesX();
+    float* getVelocitiesY();
+
+    float getInterpolatedX(int id, float alpha) const;
+    float getInterpolatedY(int id, float alpha) const;
+    Vec2 getInterpolated(int id, float alpha) const;
+    void savePositions();
+
+    ParticleArrays getArrays();
+    FixedParticleArrays getFixedArrays();
+
+    void update(float dt);
+    void update(float dt, ScreenCollision collision, int SCREEN_WIDTH, int SCREEN_HEIGHT);
+    void update(int id, float dt);
+
+    void prepareUpdate(float dt);
+    void updateRange(float dt, int begin, int end);
+};
+
+
+#endif /* particlesystem_hpp */
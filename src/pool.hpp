@@ -0,0 +1,163 @@
+#ifndef pool_hpp
+#define pool_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+struct PoolHandle
+{
+    int index;
+    int generation;
+
+    bool operator==(const PoolHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+
+/**
+ Fixed capacity storage for objects of one type. All the memory is allocated when the pool
+ is constructed, acquiring and releasing an object only constructs and destructs it in a
+ free slot, so spawning and removing objects never touches the heap. Released slots are
+ reused with a bumped generation so stale handles can be told apart from the object now
+ using the slot
+ */
+template <typename T>
+class Pool
+{
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    std::unique_ptr<Slot[]> slots;
+    std::vector<int> generations;
+    std::vector<char> used;
+    std::vector<int> freeSlots;
+    int capacity;
+    int count = 0;
+
+    Pool(const Pool&);
+    Pool& operator=(const Pool&);
+
+public:
+    /**
+     Constructs a pool with room for a fixed number of objects
+
+     @param capacity  Most objects the pool can hold at once
+     */
+    explicit Pool(int capacity)
+        : slots(new Slot[capacity]), generations(capacity, 0), used(capacity, 0), capacity(capacity)
+    {
+        freeSlots.reserve(capacity);
+
+        // Hand out the lowest slots first
+        for (int i = capacity - 1; i >= 0; i--)
+        {
+            freeSlots.push_back(i);
+        }
+    }
+
+    /**
+     Deconstructs the pool, destructing every object still in it
+     */
+    ~Pool()
+    {
+        for (int i = 0; i < capacity; i++)
+        {
+            if (used[i])
+            {
+                reinterpret_cast<T*>(&slots[i])->~T();
+            }
+        }
+    }
+
+    /**
+     Constructs an object in a free slot
+
+     @param args  Arguments passed to the constructor of T
+     @returns     Handle of the object, with an index of -1 if the pool is full
+     */
+    template <typename... Args>
+    PoolHandle acquire(Args&&... args)
+    {
+        PoolHandle handle = {-1, 0};
+
+        if (freeSlots.empty())
+        {
+            printf("Pool of %d objects is full\n", capacity);
+            return handle;
+        }
+
+        handle.index = freeSlots.back();
+        handle.generation = generations[handle.index];
+        freeSlots.pop_back();
+
+        new (&slots[handle.index]) T(std::forward<Args>(args)...);
+        used[handle.index] = 1;
+        count++;
+
+        return handle;
+    }
+
+    /**
+     Destructs an object and frees its slot
+
+     @param handle  Handle of the object, ignored if it was already released
+     */
+    void release(PoolHandle handle)
+    {
+        if (!isAlive(handle))
+        {
+            return;
+        }
+
+        reinterpret_cast<T*>(&slots[handle.index])->~T();
+        used[handle.index] = 0;
+        generations[handle.index]++;
+        freeSlots.push_back(handle.index);
+        count--;
+    }
+
+    /**
+     Gets an object, the pointer stays valid until the object is released
+
+     @param handle  Handle of the object
+     @returns       The object, nullptr if it was released
+     */
+    T* get(PoolHandle handle)
+    {
+        return isAlive(handle) ? reinterpret_cast<T*>(&slots[handle.index]) : nullptr;
+    }
+
+    /**
+     Checks whether a handle still refers to an object in the pool
+
+     @param handle  Handle of the object
+     @returns       False if the object was released, even if its slot has been reused
+     */
+    bool isAlive(PoolHandle handle) const
+    {
+        return handle.index >= 0 && handle.index < capacity && used[handle.index] &&
+               generations[handle.index] == handle.generation;
+    }
+
+    /**
+     Gets the number of objects in the pool
+
+     @returns The number of objects
+     */
+    int size() const { return count; }
+
+    /**
+     Gets the most objects the pool can hold at once
+
+     @returns The capacity of the pool
+     */
+    int getCapacity() const { return capacity; }
+};
+
+
+#endif /* pool_hpp */
@@ -0,0 +1,502 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+
+// Timed events kept per frame of history, enough for several physics ticks per frame
+#define PROFILER_EVENTS_PER_FRAME 16
+
+// Height in pixels of 1ms in the frame time graph
+#define PROFILER_GRAPH_SCALE 4
+
+// Number of 1ms buckets in the latency histogram
+#define PROFILER_LATENCY_BUCKETS 200
+
+
+static const char* phaseNames[Profiler::PhaseCount] = {
+    "events", "collisions", "physics", "rewind", "layers", "present"
+};
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a profiler keeping a number of frames of history
+
+ @param frameCapacity  Number of frames kept for statistics, graphs and dumps
+ */
+Profiler::Profiler(int frameCapacity)
+    : frames(frameCapacity), events(frameCapacity * PROFILER_EVENTS_PER_FRAME),
+      frequency(SDL_GetPerformanceFrequency()), latencies(PROFILER_LATENCY_BUCKETS)
+{
+    scratch.reserve(frameCapacity);
+    current = FrameSample();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a profiler keeping 10 seconds of history at 60fps
+
+ */
+Profiler::Profiler()
+    : Profiler(600)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Converts performance counter ticks to milliseconds
+
+ @param ticks  Performance counter ticks
+ @returns      The same duration in milliseconds
+ */
+float Profiler::toMs(Uint64 ticks) const
+{
+    return ticks * 1000.0 / frequency;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts timing a new frame
+
+ */
+void Profiler::beginFrame()
+{
+    current = FrameSample();
+    current.start = SDL_GetPerformanceCounter();
+    current.allocationsAtStart = AllocCounter::getAllocations();
+
+    if (firstCounter == 0)
+    {
+        firstCounter = current.start;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finishes timing the current frame and stores it in the history
+
+ */
+void Profiler::endFrame()
+{
+    current.total = toMs(SDL_GetPerformanceCounter() - current.start);
+    current.allocations = AllocCounter::getAllocations() - current.allocationsAtStart;
+
+    frames[frameHead] = current;
+    frameHead = (frameHead + 1) % frames.size();
+    frameCount = std::min(frameCount + 1, (int)frames.size());
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts timing a phase of the current frame
+
+ @param phase  Phase to time
+ */
+void Profiler::begin(Phase phase)
+{
+    phaseStart[phase] = SDL_GetPerformanceCounter();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Stops timing a phase, a phase that runs several times in a frame adds up
+
+ @param phase  Phase to stop timing
+ */
+void Profiler::end(Phase phase)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    current.phases[phase] += toMs(now - phaseStart[phase]);
+
+    Event event = {phase, phaseStart[phase], now};
+    events[eventHead] = event;
+    eventHead = (eventHead + 1) % events.size();
+    eventCount = std::min(eventCount + 1, (int)events.size());
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a frame from the history
+
+ @param age  0 is the most recent frame, 1 the one before and so on
+ @returns    The frame sample
+ */
+const Profiler::FrameSample& Profiler::getFrame(int age) const
+{
+    return frames[(frameHead - 1 - age + frames.size()) % frames.size()];
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the minimum, average and 99th percentile time of a phase over the history
+
+ @param phase  Phase to get the statistics of
+ @returns      Times in milliseconds
+ */
+Profiler::Stats Profiler::getStats(Phase phase)
+{
+    Stats stats = {0, 0, 0};
+
+    if (frameCount == 0)
+    {
+        return stats;
+    }
+
+    scratch.clear();
+
+    for (int i = 0; i < frameCount; i++)
+    {
+        scratch.push_back(phase == PhaseCount ? frames[i].total : frames[i].phases[phase]);
+    }
+
+    float sum = 0;
+
+    for (float sample : scratch)
+    {
+        sum += sample;
+    }
+
+    // Nearest rank percentile, the smallest sample at or above 99% of the samples
+    size_t p99 = (scratch.size() * 99 + 99) / 100 - 1;
+    std::nth_element(scratch.begin(), scratch.begin() + p99, scratch.end());
+
+    stats.p99 = scratch[p99];
+    stats.min = *std::min_element(scratch.begin(), scratch.end());
+    stats.avg = sum / scratch.size();
+
+    return stats;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the minimum, average and 99th percentile time of whole frames over the history
+
+ @returns      Times in milliseconds
+ */
+Profiler::Stats Profiler::getFrameStats()
+{
+    return getStats(PhaseCount);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of heap allocations made during the most recent frame, 0 once nothing is
+ spawned or loaded is the target
+
+ @returns The number of allocations
+ */
+int Profiler::getFrameAllocations() const
+{
+    return frameCount > 0 ? getFrame(0).allocations : 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the name of a phase as used in the overlay and dumps
+
+ @param phase  Phase to name
+ @returns      Name of the phase
+ */
+const char* Profiler::getPhaseName(Phase phase)
+{
+    return phase < PhaseCount ? phaseNames[phase] : "frame";
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds the time from an input event to the present of the first frame showing its effect
+
+ @param ms  Latency in milliseconds
+ */
+void Profiler::addLatency(float ms)
+{
+    const int bucket = std::min(std::max((int)ms, 0), PROFILER_LATENCY_BUCKETS - 1);
+
+    latencies[bucket]++;
+    latencyCount++;
+    latencySum += ms;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the minimum, average and 99th percentile input to present latency of the whole run.
+ The minimum and percentile are to the nearest millisecond
+
+ @returns      Latencies in milliseconds
+ */
+Profiler::Stats Profiler::getLatencyStats() const
+{
+    Stats stats = {0, 0, 0};
+
+    if (latencyCount == 0)
+    {
+        return stats;
+    }
+
+    const int p99 = (latencyCount * 99 + 99) / 100;
+    int seen = 0;
+    bool first = true;
+
+    for (int bucket = 0; bucket < PROFILER_LATENCY_BUCKETS; bucket++)
+    {
+        if (latencies[bucket] > 0 && first)
+        {
+            stats.min = bucket;
+            first = false;
+        }
+
+        seen += latencies[bucket];
+
+        if (seen >= p99)
+        {
+            stats.p99 = bucket;
+            break;
+        }
+    }
+
+    stats.avg = latencySum / latencyCount;
+
+    return stats;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints the input to present latency histogram, one row per millisecond that had any
+ samples
+
+ */
+void Profiler::printLatency() const
+{
+    if (latencyCount == 0)
+    {
+        return;
+    }
+
+    const Stats stats = getLatencyStats();
+    const int most = *std::max_element(latencies.begin(), latencies.end());
+
+    printf("Input to present latency over %d presses, min %.0fms avg %.1fms p99 %.0fms\n",
+           latencyCount, stats.min, stats.avg, stats.p99);
+
+    for (int bucket = 0; bucket < PROFILER_LATENCY_BUCKETS; bucket++)
+    {
+        if (latencies[bucket] == 0)
+        {
+            continue;
+        }
+
+        const int bar = (latencies[bucket] * 50 + most - 1) / most;
+
+        printf("%3d%sms %6d %.*s\n", bucket, bucket == PROFILER_LATENCY_BUCKETS - 1 ? "+" : " ",
+               latencies[bucket], bar, "##################################################");
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Shows or hides the overlay
+
+ */
+void Profiler::toggleOverlay()
+{
+    overlayVisible = !overlayVisible;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws a graph of recent frame times, stacked by phase, with the statistics of each phase
+ underneath. The line marks 16.7ms, a frame at 60fps
+
+ @param renderer  Renderer to draw the overlay with
+ @param x         Left edge of the overlay
+ @param y         Top edge of the overlay
+ */
+void Profiler::drawOverlay(SDL_Renderer *renderer, int x, int y)
+{
+    if (!overlayVisible)
+    {
+        return;
+    }
+
+    static const Uint8 colours[PhaseCount][3] = {
+        {80, 160, 255}, {255, 200, 0}, {0, 220, 120}, {160, 160, 160}, {220, 80, 255}, {255, 80, 80}
+    };
+
+    const int graphWidth = 300;
+    const int graphHeight = 33 * PROFILER_GRAPH_SCALE;
+    const int lineHeight = 10;
+    const int textHeight = (PhaseCount + 3) * lineHeight + 4;
+
+    boxRGBA(renderer, x, y, x + graphWidth, y + graphHeight + textHeight, 0, 0, 0, 180);
+
+    // One column per frame, newest on the right
+    const int bottom = y + graphHeight;
+    const int columns = std::min(frameCount, graphWidth);
+
+    for (int i = 0; i < columns; i++)
+    {
+        const FrameSample& frame = getFrame(i);
+        int column = x + graphWidth - 1 - i;
+        float stacked = 0;
+
+        for (int phase = 0; phase < PhaseCount; phase++)
+        {
+            int from = bottom - stacked * PROFILER_GRAPH_SCALE;
+            stacked += frame.phases[phase];
+            int to = std::max(y, (int)(bottom - stacked * PROFILER_GRAPH_SCALE));
+
+            if (to < from)
+            {
+                lineRGBA(renderer, column, from, column, to, colours[phase][0], colours[phase][1], colours[phase][2], 255);
+            }
+        }
+
+        // Whatever the phases do not cover, such as waiting on vsync, in grey
+        int top = std::max(y, (int)(bottom - frame.total * PROFILER_GRAPH_SCALE));
+        int covered = bottom - stacked * PROFILER_GRAPH_SCALE;
+
+        if (top < covered)
+        {
+            lineRGBA(renderer, column, covered, column, top, 120, 120, 120, 255);
+        }
+    }
+
+    int target = bottom - 16.7 * PROFILER_GRAPH_SCALE;
+    hlineRGBA(renderer, x, x + graphWidth, target, 255, 255, 255, 160);
+
+    char line[64];
+    int textY = bottom + 4;
+
+    Stats frame = getFrameStats();
+    snprintf(line, sizeof(line), "%-10s %5.2f %5.2f %5.2f", "frame", frame.min, frame.avg, frame.p99);
+    stringRGBA(renderer, x + 4, textY, line, 255, 255, 255, 255);
+
+    for (int phase = 0; phase < PhaseCount; phase++)
+    {
+        Stats stats = getStats((Phase)phase);
+        textY += lineHeight;
+
+        snprintf(line, sizeof(line), "%-10s %5.2f %5.2f %5.2f", phaseNames[phase], stats.min, stats.avg, stats.p99);
+        stringRGBA(renderer, x + 4, textY, line, colours[phase][0], colours[phase][1], colours[phase][2], 255);
+    }
+
+    textY += lineHeight;
+    snprintf(line, sizeof(line), "%-10s %5d", "allocs", getFrameAllocations());
+    stringRGBA(renderer, x + 4, textY, line, 255, 255, 255, 255);
+
+    // Key press to present, the whole run so far
+    Stats latency = getLatencyStats();
+    textY += lineHeight;
+
+    snprintf(line, sizeof(line), "%-10s %5.2f %5.2f %5.2f", "latency", latency.min, latency.avg, latency.p99);
+    stringRGBA(renderer, x + 4, textY, line, 255, 255, 255, 255);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Writes the frame history as CSV, one row per frame with the frame time and the time of
+ each phase in milliseconds
+
+ @param path  Path of the file to write
+ @returns     False if the file could not be written
+ */
+bool Profiler::writeCsv(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == nullptr)
+    {
+        printf("Failed to write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "frame,start_ms,frame_ms");
+
+    for (int phase = 0; phase < PhaseCount; phase++)
+    {
+        fprintf(file, ",%s_ms", phaseNames[phase]);
+    }
+
+    fprintf(file, ",allocations\n");
+
+    for (int i = frameCount - 1; i >= 0; i--)
+    {
+        const FrameSample& frame = getFrame(i);
+
+        fprintf(file, "%d,%.3f,%.3f", frameCount - 1 - i, toMs(frame.start - firstCounter), frame.total);
+
+        for (int phase = 0; phase < PhaseCount; phase++)
+        {
+            fprintf(file, ",%.3f", frame.phases[phase]);
+        }
+
+        fprintf(file, ",%d\n", frame.allocations);
+    }
+
+    fclose(file);
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Writes the timed events as Chrome trace JSON, which chrome://tracing and Perfetto open
+
+ @param path  Path of the file to write
+ @returns     False if the file could not be written
+ */
+bool Profiler::writeTrace(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+
+    if (file == nullptr)
+    {
+        printf("Failed to write %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    const double microseconds = 1000000.0 / frequency;
+    bool first = true;
+
+    for (int i = frameCount - 1; i >= 0; i--)
+    {
+        const FrameSample& frame = getFrame(i);
+
+        fprintf(file, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                first ? "" : ",\n", (frame.start - firstCounter) * microseconds, frame.total * 1000.0);
+        first = false;
+    }
+
+    for (int i = 0; i < eventCount; i++)
+    {
+        const Event& event = events[(eventHead - eventCount + i + events.size()) % events.size()];
+
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                first ? "" : ",\n", phaseNames[event.phase], (event.start - firstCounter) * microseconds,
+                (event.end - event.start) * microseconds);
+        first = false;
+    }
+
+    fprintf(file, "\n]}\n");
+
+    fclose(file);
+    return true;
+}
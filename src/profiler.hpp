@@ -0,0 +1,125 @@
+#ifndef profiler_hpp
+#define profiler_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include <SDL2_gfxPrimitives.h>
+#include "alloccounter.hpp"
+
+
+class Profiler
+{
+public:
+    enum Phase
+    {
+        Events,
+        Collisions,
+        Physics,
+        Rewind,
+        Layers,
+        Present,
+        PhaseCount
+    };
+
+    struct Stats
+    {
+        float min, avg, p99;
+    };
+
+private:
+    struct FrameSample
+    {
+        Uint64 start;
+        float total;
+        float phases[PhaseCount];
+
+        // Heap allocations made during the frame, counted from this to the next frame
+        unsigned long long allocationsAtStart;
+        int allocations;
+    };
+
+    struct Event
+    {
+        Phase phase;
+        Uint64 start, end;
+    };
+
+    // Completed frames and timed events, both ring buffers overwriting the oldest entry
+    std::vector<FrameSample> frames;
+    std::vector<Event> events;
+    int frameHead = 0, frameCount = 0;
+    int eventHead = 0, eventCount = 0;
+
+    FrameSample current;
+    Uint64 phaseStart[PhaseCount];
+    Uint64 firstCounter = 0;
+    double frequency;
+
+    bool overlayVisible = false;
+    std::vector<float> scratch;
+
+    // Input to present latencies, counted in 1ms buckets with the last holding everything
+    // longer
+    std::vector<int> latencies;
+    int latencyCount = 0;
+    double latencySum = 0;
+
+    const FrameSample& getFrame(int age) const;
+    float toMs(Uint64 ticks) const;
+
+public:
+    Profiler(int frameCapacity);
+    Profiler();
+
+    void beginFrame();
+    void endFrame();
+    void begin(Phase phase);
+    void end(Phase phase);
+
+    Stats getStats(Phase phase);
+    Stats getFrameStats();
+    int getFrameAllocations() const;
+    static const char* getPhaseName(Phase phase);
+
+    void addLatency(float ms);
+    Stats getLatencyStats() const;
+    void printLatency() const;
+
+    void toggleOverlay();
+    void drawOverlay(SDL_Renderer *renderer, int x, int y);
+
+    bool writeCsv(const std::string& path) const;
+    bool writeTrace(const std::string& path) const;
+};
+
+
+/**
+ Times a phase for as long as it is in scope
+ */
+class ProfileScope
+{
+private:
+    Profiler *profiler;
+    Profiler::Phase phase;
+
+public:
+    ProfileScope(Profiler *profiler, Profiler::Phase phase) : profiler(profiler), phase(phase)
+    {
+        profiler->begin(phase);
+    }
+
+    ~ProfileScope()
+    {
+        profiler->end(phase);
+    }
+};
+
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(profiler, phase) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, phase)
+
+
+#endif /* profiler_hpp */
@@ -0,0 +1,469 @@
+#include "registry.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Gets the archetype for a set of components, creating it the first time it is needed
+
+ @param mask  Mask of the components
+ @returns     The archetype holding entities with exactly those components
+ */
+Archetype* Registry::getArchetype(unsigned int mask)
+{
+    auto found = archetypesByMask.find(mask);
+
+    if (found != archetypesByMask.end())
+    {
+        return found->second;
+    }
+
+    Archetype* archetype = new Archetype();
+    archetype->mask = mask;
+
+    archetypes.push_back(std::unique_ptr<Archetype>(archetype));
+    archetypesByMask[mask] = archetype;
+
+    return archetype;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Appends a row of default constructed components to an archetype
+
+ @param archetype  Archetype to add the row to
+ @param entity     Entity the row belongs to
+ @returns          Index of the new row
+ */
+int Registry::addRow(Archetype* archetype, Entity entity)
+{
+    const unsigned int mask = archetype->mask;
+
+    archetype->entities.push_back(entity);
+
+    if (mask & TRANSFORM) archetype->transforms.push_back(Transform());
+    if (mask & VELOCITY)  archetype->velocities.push_back(Velocity());
+    if (mask & SPRITE)    archetype->sprites.push_back(Sprite());
+    if (mask & COLLIDER)  archetype->colliders.push_back(Collider());
+    if (mask & LIFETIME)  archetype->lifetimes.push_back(Lifetime());
+    if (mask & BODY)      archetype->bodies.push_back(Body());
+
+    return archetype->size() - 1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Removes a row from an archetype by moving its last row into the gap, keeping the arrays
+ packed
+
+ @param archetype  Archetype to remove the row from
+ @param row        Index of the row
+ */
+void Registry::removeRow(Archetype* archetype, int row)
+{
+    const unsigned int mask = archetype->mask;
+    const int last = archetype->size() - 1;
+
+    if (row != last)
+    {
+        archetype->entities[row] = archetype->entities[last];
+        records[archetype->entities[row].index].row = row;
+
+        if (mask & TRANSFORM) archetype->transforms[row] = archetype->transforms[last];
+        if (mask & VELOCITY)  archetype->velocities[row] = archetype->velocities[last];
+        if (mask & SPRITE)    archetype->sprites[row] = archetype->sprites[last];
+        if (mask & COLLIDER)  archetype->colliders[row] = archetype->colliders[last];
+        if (mask & LIFETIME)  archetype->lifetimes[row] = archetype->lifetimes[last];
+        if (mask & BODY)      archetype->bodies[row] = archetype->bodies[last];
+    }
+
+    archetype->entities.pop_back();
+
+    if (mask & TRANSFORM) archetype->transforms.pop_back();
+    if (mask & VELOCITY)  archetype->velocities.pop_back();
+    if (mask & SPRITE)    archetype->sprites.pop_back();
+    if (mask & COLLIDER)  archetype->colliders.pop_back();
+    if (mask & LIFETIME)  archetype->lifetimes.pop_back();
+    if (mask & BODY)      archetype->bodies.pop_back();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Copies the components two archetypes have in common from one row to another
+
+ @param from     Archetype to copy from
+ @param fromRow  Row to copy from
+ @param to       Archetype to copy to
+ @param toRow    Row to copy to
+ */
+void Registry::copyRow(Archetype* from, int fromRow, Archetype* to, int toRow)
+{
+    const unsigned int mask = from->mask & to->mask;
+
+    if (mask & TRANSFORM) to->transforms[toRow] = from->transforms[fromRow];
+    if (mask & VELOCITY)  to->velocities[toRow] = from->velocities[fromRow];
+    if (mask & SPRITE)    to->sprites[toRow] = from->sprites[fromRow];
+    if (mask & COLLIDER)  to->colliders[toRow] = from->colliders[fromRow];
+    if (mask & LIFETIME)  to->lifetimes[toRow] = from->lifetimes[fromRow];
+    if (mask & BODY)      to->bodies[toRow] = from->bodies[fromRow];
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates an entity with a set of default constructed components
+
+ @param mask  Mask of ComponentType values the entity has
+ @returns     Handle of the new entity
+ */
+Entity Registry::create(unsigned int mask)
+{
+    int index;
+
+    if (!freeIndices.empty())
+    {
+        index = freeIndices.back();
+        takeFree(index);
+    }
+    else
+    {
+        index = records.size();
+        addRecord();
+    }
+
+    return place(index, mask);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Creates an entity at a given index instead of the next free one, for putting back an
+ entity that was destroyed, such as when rewinding the world
+
+ @param index  Index for the entity
+ @param mask   Mask of ComponentType values the entity has
+ @returns      Handle of the new entity, not alive if the index is in use
+ */
+Entity Registry::createAt(int index, unsigned int mask)
+{
+    while ((int)records.size() <= index)
+    {
+        addRecord();
+        pushFree(records.size() - 1);
+    }
+
+    if (index < 0 || records[index].archetype != nullptr)
+    {
+        Entity none = {-1, -1};
+        return none;
+    }
+
+    takeFree(index);
+
+    return place(index, mask);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds a record for a new index. The free indices and the destroy queue are grown along
+ with the records, so entities expiring later never allocate
+
+ */
+void Registry::addRecord()
+{
+    Record record = {0, nullptr, -1, -1};
+    records.push_back(record);
+
+    if (freeIndices.capacity() < records.capacity())
+    {
+        freeIndices.reserve(records.capacity());
+        pendingDestroy.reserve(records.capacity());
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds an index no entity uses to the free indices
+
+ @param index  Index to free
+ */
+void Registry::pushFree(int index)
+{
+    records[index].freeSlot = freeIndices.size();
+    freeIndices.push_back(index);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Takes an index out of the free indices, the last free index takes its slot so it does
+ not matter where in them it is
+
+ @param index  Free index to take
+ */
+void Registry::takeFree(int index)
+{
+    const int slot = records[index].freeSlot;
+    const int last = freeIndices.back();
+
+    freeIndices[slot] = last;
+    records[last].freeSlot = slot;
+    freeIndices.pop_back();
+
+    records[index].freeSlot = -1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gives a free index to a new entity with a set of default constructed components
+
+ @param index  Free index, taken out of the free indices already
+ @param mask   Mask of ComponentType values the entity has
+ @returns      Handle of the new entity
+ */
+Entity Registry::place(int index, unsigned int mask)
+{
+    Record& record = records[index];
+    Entity entity = {index, record.generation};
+
+    record.archetype = getArchetype(mask);
+    record.row = addRow(record.archetype, entity);
+
+    count++;
+
+    return entity;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Destroys an entity straight away. Do not call while iterating over the archetype the
+ entity is in, use destroyLater instead
+
+ @param entity  Entity to destroy, ignored if it is already dead
+ */
+void Registry::destroy(Entity entity)
+{
+    if (!isAlive(entity))
+    {
+        return;
+    }
+
+    Record& record = records[entity.index];
+
+    removeRow(record.archetype, record.row);
+
+    record.generation++;
+    record.archetype = nullptr;
+    record.row = -1;
+
+    pushFree(entity.index);
+    count--;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Queues an entity to be destroyed by the next call to flushDestroyed, safe to call while
+ systems iterate
+
+ @param entity  Entity to destroy
+ */
+void Registry::destroyLater(Entity entity)
+{
+    pendingDestroy.push_back(entity);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Destroys every entity queued with destroyLater
+
+ */
+void Registry::flushDestroyed()
+{
+    for (const Entity& entity : pendingDestroy)
+    {
+        destroy(entity);
+    }
+
+    pendingDestroy.clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Destroys every entity, archetypes keep their capacity for reuse
+
+ */
+void Registry::clear()
+{
+    for (size_t index = 0; index < records.size(); index++)
+    {
+        Record& record = records[index];
+
+        if (record.archetype != nullptr)
+        {
+            record.generation++;
+            record.archetype = nullptr;
+            record.row = -1;
+            pushFree(index);
+        }
+    }
+
+    for (auto& archetype : archetypes)
+    {
+        archetype->entities.clear();
+        archetype->transforms.clear();
+        archetype->velocities.clear();
+        archetype->sprites.clear();
+        archetype->colliders.clear();
+        archetype->lifetimes.clear();
+        archetype->bodies.clear();
+    }
+
+    pendingDestroy.clear();
+    count = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gives an entity more components by moving it to the archetype with the combined set, new
+ components are default constructed
+
+ @param entity  Entity to add components to
+ @param mask    Mask of the components to add
+ */
+void Registry::addComponents(Entity entity, unsigned int mask)
+{
+    if (!isAlive(entity))
+    {
+        return;
+    }
+
+    Record& record = records[entity.index];
+    Archetype* to = getArchetype(record.archetype->mask | mask);
+
+    if (to == record.archetype)
+    {
+        return;
+    }
+
+    int row = addRow(to, entity);
+    copyRow(record.archetype, record.row, to, row);
+    removeRow(record.archetype, record.row);
+
+    record.archetype = to;
+    record.row = row;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Takes components away from an entity by moving it to the archetype with the remaining set
+
+ @param entity  Entity to remove components from
+ @param mask    Mask of the components to remove
+ */
+void Registry::removeComponents(Entity entity, unsigned int mask)
+{
+    if (!isAlive(entity))
+    {
+        return;
+    }
+
+    Record& record = records[entity.index];
+    Archetype* to = getArchetype(record.archetype->mask & ~mask);
+
+    if (to == record.archetype)
+    {
+        return;
+    }
+
+    int row = addRow(to, entity);
+    copyRow(record.archetype, record.row, to, row);
+    removeRow(record.archetype, record.row);
+
+    record.archetype = to;
+    record.row = row;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether an entity handle still refers to a live entity
+
+ @param entity  Entity handle
+ @returns       False if the entity was destroyed, even if its index has been reused
+ */
+bool Registry::isAlive(Entity entity) const
+{
+    return entity.index >= 0 && entity.index < (int)records.size() &&
+           records[entity.index].generation == entity.generation &&
+           records[entity.index].archetype != nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a handle to the entity currently using an index, for code that files entities by
+ index such as a spatial grid
+
+ @param index   Entity index
+ @returns       Handle to the entity using the index, not alive if none is
+ */
+Entity Registry::getEntity(int index) const
+{
+    Entity entity = {index, index >= 0 && index < (int)records.size() ? records[index].generation : -1};
+    return entity;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether a live entity has every component in a mask
+
+ @param entity  Entity handle
+ @param mask    Mask of the components
+ @returns       True if the entity is alive and has all the components
+ */
+bool Registry::has(Entity entity, unsigned int mask) const
+{
+    return isAlive(entity) && (records[entity.index].archetype->mask & mask) == mask;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the components a live entity has
+
+ @param entity  Entity handle
+ @returns       Mask of the entity's components, 0 if it is dead
+ */
+unsigned int Registry::getMask(Entity entity) const
+{
+    return isAlive(entity) ? records[entity.index].archetype->mask : 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of live entities
+
+ @returns The number of entities
+ */
+int Registry::size() const { return count; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of entity indices handed out so far, live or free. Every entity's index
+ is below it
+
+ @returns The number of indices
+ */
+int Registry::getCapacity() const { return records.size(); }
@@ -0,0 +1,146 @@
+#ifndef registry_hpp
+#define registry_hpp
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "components.hpp"
+
+
+struct Entity
+{
+    int index;
+    int generation;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+
+/**
+ All entities with exactly the same set of components. Each component type has a packed
+ array with one element per entity, row i of every array belongs to entities[i]
+ */
+struct Archetype
+{
+    unsigned int mask;
+
+    std::vector<Entity> entities;
+    std::vector<Transform> transforms;
+    std::vector<Velocity> velocities;
+    std::vector<Sprite> sprites;
+    std::vector<Collider> colliders;
+    std::vector<Lifetime> lifetimes;
+    std::vector<Body> bodies;
+
+    int size() const { return entities.size(); }
+
+    template <typename T> std::vector<T>& column();
+};
+
+template <> inline std::vector<Transform>& Archetype::column<Transform>() { return transforms; }
+template <> inline std::vector<Velocity>& Archetype::column<Velocity>() { return velocities; }
+template <> inline std::vector<Sprite>& Archetype::column<Sprite>() { return sprites; }
+template <> inline std::vector<Collider>& Archetype::column<Collider>() { return colliders; }
+template <> inline std::vector<Lifetime>& Archetype::column<Lifetime>() { return lifetimes; }
+template <> inline std::vector<Body>& Archetype::column<Body>() { return bodies; }
+
+template <typename T> struct ComponentMask;
+template <> struct ComponentMask<Transform> { static const unsigned int value = TRANSFORM; };
+template <> struct ComponentMask<Velocity> { static const unsigned int value = VELOCITY; };
+template <> struct ComponentMask<Sprite> { static const unsigned int value = SPRITE; };
+template <> struct ComponentMask<Collider> { static const unsigned int value = COLLIDER; };
+template <> struct ComponentMask<Lifetime> { static const unsigned int value = LIFETIME; };
+template <> struct ComponentMask<Body> { static const unsigned int value = BODY; };
+
+
+class Registry
+{
+private:
+    struct Record
+    {
+        int generation;
+        Archetype* archetype;
+        int row;
+
+        // Where the index is in freeIndices, -1 while an entity uses it
+        int freeSlot;
+    };
+
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::map<unsigned int, Archetype*> archetypesByMask;
+
+    // Indexed by entity index, free indices are reused with a bumped generation so stale
+    // entity handles can be told apart from the entity now using the index
+    std::vector<Record> records;
+    std::vector<int> freeIndices;
+    std::vector<Entity> pendingDestroy;
+    int count = 0;
+
+    Archetype* getArchetype(unsigned int mask);
+    int addRow(Archetype* archetype, Entity entity);
+    void removeRow(Archetype* archetype, int row);
+    void copyRow(Archetype* from, int fromRow, Archetype* to, int toRow);
+    void addRecord();
+    void pushFree(int index);
+    void takeFree(int index);
+    Entity place(int index, unsigned int mask);
+
+public:
+    Entity create(unsigned int mask);
+    Entity createAt(int index, unsigned int mask);
+    void destroy(Entity entity);
+    void destroyLater(Entity entity);
+    void flushDestroyed();
+    void clear();
+
+    void addComponents(Entity entity, unsigned int mask);
+    void removeComponents(Entity entity, unsigned int mask);
+
+    Entity getEntity(int index) const;
+    bool isAlive(Entity entity) const;
+    bool has(Entity entity, unsigned int mask) const;
+    unsigned int getMask(Entity entity) const;
+    int size() const;
+    int getCapacity() const;
+
+    /**
+     Gets a component of an entity, valid until entities are created, destroyed or change
+     components
+
+     @returns The component, nullptr if the entity is dead or does not have it
+     */
+    template <typename T>
+    T* get(Entity entity)
+    {
+        if (!has(entity, ComponentMask<T>::value))
+        {
+            return nullptr;
+        }
+
+        const Record& record = records[entity.index];
+        return &record.archetype->column<T>()[record.row];
+    }
+
+    /**
+     Calls a function with every archetype that has at least the required components, so a
+     system walks packed arrays of only the components it needs
+
+     @param required  Mask of the components the system needs
+     @param function  Called with an Archetype& for each matching archetype
+     */
+    template <typename Function>
+    void each(unsigned int required, Function function)
+    {
+        for (auto& archetype : archetypes)
+        {
+            if ((archetype->mask & required) == required && archetype->size() > 0)
+            {
+                function(*archetype);
+            }
+        }
+    }
+};
+
+
+#endif /* registry_hpp */
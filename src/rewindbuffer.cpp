@@ -0,0 +1,570 @@
+#include "rewindbuffer.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+
+/** --------------------------------------------------------------------------------------
+ Zigzag coding folds signed differences into unsigned ones with small values either side
+ of zero small, so values that went down take as few bits as values that went up
+ */
+inline Uint32 zigzag(Uint32 difference)
+{
+    return (difference << 1) ^ (Uint32)((Sint32)difference >> 31);
+}
+
+
+inline Uint32 unzigzag(Uint32 value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+
+inline int bitLength(Uint32 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return value != 0 ? 32 - __builtin_clz(value) : 0;
+#else
+    int length = 0;
+
+    while (length < 32 && (value >> length) != 0)
+    {
+        length++;
+    }
+
+    return length;
+#endif
+}
+
+
+/** --------------------------------------------------------------------------------------
+ Packs a block of values at a bit width, REWIND_BLOCK values take exactly width words
+
+ @param values  Values that all fit in width bits
+ @param width   Bits per value, 0 to 32
+ @param out     Words to pack into
+ @returns       Word after the last one packed
+ */
+Uint32* packBlock(const Uint32* values, int width, Uint32* out)
+{
+    Uint64 bits = 0;
+    int used = 0;
+
+    for (int i = 0; i < REWIND_BLOCK && width > 0; i++)
+    {
+        bits |= (Uint64)values[i] << used;
+        used += width;
+
+        if (used >= 32)
+        {
+            *out++ = (Uint32)bits;
+            bits >>= 32;
+            used -= 32;
+        }
+    }
+
+    return out;
+}
+
+
+/** --------------------------------------------------------------------------------------
+ Unpacks a block of values packed at a bit width
+
+ @param in      Packed words
+ @param width   Bits per value, 0 to 32
+ @param values  Set to the REWIND_BLOCK values
+ @returns       Word after the last one unpacked
+ */
+const Uint32* unpackBlock(const Uint32* in, int width, Uint32* values)
+{
+    const Uint32 mask = width == 32 ? 0xFFFFFFFF : (1u << width) - 1;
+    Uint64 bits = 0;
+    int available = 0;
+
+    for (int i = 0; i < REWIND_BLOCK; i++)
+    {
+        if (available < width)
+        {
+            bits |= (Uint64)*in++ << available;
+            available += 32;
+        }
+
+        values[i] = (Uint32)bits & mask;
+        bits >>= width;
+        available -= width;
+    }
+
+    return in;
+}
+
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty buffer, the whole budget is taken straight away so pushing a tick
+ never allocates
+
+ @param capacity  Most ticks to hold
+ @param budget    Most bytes of encoded ticks to hold
+ */
+RewindBuffer::RewindBuffer(int capacity, long budget)
+  : capacity(std::max(capacity, 1)), ring(budget / sizeof(Uint32)), records(std::max(capacity, 1))
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the record of a held tick
+
+ @param sequence  Sequence number of the tick, counting every tick pushed
+ @returns         The tick's record
+ */
+RewindBuffer::Record& RewindBuffer::getRecord(long sequence) { return records[sequence % capacity]; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Checks whether a held tick keeps its whole state
+
+ @param sequence  Sequence number of the tick
+ @returns         True if the tick is a keyframe
+ */
+bool RewindBuffer::isKeyframe(long sequence) { return getRecord(sequence).keyframeWords > 0; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds the keyframe a held tick is a delta against. The oldest held tick is always a
+ keyframe, so there is one
+
+ @param sequence  Sequence number of the tick
+ @returns         Sequence number of the keyframe, the tick itself if it is one
+ */
+long RewindBuffer::findKeyframe(long sequence)
+{
+    while (!isKeyframe(sequence))
+    {
+        sequence--;
+    }
+
+    return sequence;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the most words one encoded state can take, every block at full width
+
+ @returns Words of the largest delta or keyframe
+ */
+long RewindBuffer::getWorstWords() const
+{
+    const long blocks = (words + REWIND_BLOCK - 1) / REWIND_BLOCK;
+    return (blocks * 2 + 3) / 4 + blocks * REWIND_BLOCK;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops the oldest keyframe and the deltas against it
+
+ */
+void RewindBuffer::dropOldest()
+{
+    do
+    {
+        count--;
+    }
+    while (count > 0 && !isKeyframe(pushes - count));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds room in the ring for a tick, dropping the oldest keyframes until there is. Ticks are
+ kept in one piece, so a tick that does not fit before the end of the ring starts over at
+ the beginning
+
+ @param needed  Words to make room for
+ @returns       Offset in the ring to write the tick at
+ */
+long RewindBuffer::reserve(long needed)
+{
+    for (;;)
+    {
+        if (count == 0)
+        {
+            head = 0;
+            return 0;
+        }
+
+        const long tail = getRecord(pushes - count).offset;
+
+        if (tail < head)
+        {
+            if (head + needed <= (long)ring.size())
+            {
+                return head;
+            }
+
+            if (needed <= tail)
+            {
+                return 0;
+            }
+        }
+        else if (head + needed <= tail)
+        {
+            return head;
+        }
+
+        dropOldest();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Packs a state, as the zigzag coded difference from a base state or as it is. Two bytes
+ per block holding its bit width and number of exceptions come first, padded to whole
+ words, then each block followed by its exceptions
+
+ @param state  State to encode
+ @param base   State to take the difference from, nullptr to pack the state as it is
+ @param out    Words to encode into, getWorstWords long
+ @returns      Number of words written
+ */
+long RewindBuffer::encode(const Uint32* state, const Uint32* base, Uint32* out) const
+{
+    const int blocks = (words + REWIND_BLOCK - 1) / REWIND_BLOCK;
+    const int headerWords = (blocks * 2 + 3) / 4;
+
+    out[headerWords - 1] = 0;
+
+    Uint8* header = (Uint8*)out;
+    Uint32* packed = out + headerWords;
+    Uint32 values[REWIND_BLOCK], exceptions[REWIND_BLOCK];
+
+    for (int block = 0; block < blocks; block++)
+    {
+        const int begin = block * REWIND_BLOCK;
+        const int size = std::min(REWIND_BLOCK, words - begin);
+        int lengths[33] = {0};
+
+        for (int i = 0; i < size; i++)
+        {
+            values[i] = base != nullptr ? zigzag(state[begin + i] - base[begin + i]) : state[begin + i];
+            lengths[bitLength(values[i])]++;
+        }
+
+        std::fill(values + size, values + REWIND_BLOCK, 0);
+
+        // Narrow the block while the values left out cost less as exceptions than the bits
+        // the whole block saves
+        int width = 32;
+
+        while (width > 0 && lengths[width] == 0)
+        {
+            width--;
+        }
+
+        int best = width, bestCost = width * REWIND_BLOCK, wider = 0;
+
+        for (int narrower = width - 1; narrower >= REWIND_EXCEPTION_WIDTH; narrower--)
+        {
+            wider += lengths[narrower + 1];
+
+            const int cost = narrower * REWIND_BLOCK + wider * 32;
+
+            if (cost < bestCost)
+            {
+                best = narrower;
+                bestCost = cost;
+            }
+        }
+
+        int exceptionCount = 0;
+
+        if (best < width)
+        {
+            for (int i = 0; i < size; i++)
+            {
+                if (values[i] >> best)
+                {
+                    exceptions[exceptionCount++] = (values[i] >> best) << REWIND_EXCEPTION_WIDTH | i;
+                    values[i] &= (1u << best) - 1;
+                }
+            }
+        }
+
+        header[block * 2] = best;
+        header[block * 2 + 1] = exceptionCount;
+
+        packed = packBlock(values, best, packed);
+        packed = std::copy(exceptions, exceptions + exceptionCount, packed);
+    }
+
+    return packed - out;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Unpacks a state encoded by encode
+
+ @param in     Encoded words
+ @param delta  True to add a delta to the state it was taken from, false to set the state
+               to a keyframe
+ @param state  State to decode into
+ */
+void RewindBuffer::decode(const Uint32* in, bool delta, Uint32* state) const
+{
+    const int blocks = (words + REWIND_BLOCK - 1) / REWIND_BLOCK;
+    const Uint8* header = (const Uint8*)in;
+    const Uint32* packed = in + (blocks * 2 + 3) / 4;
+    Uint32 values[REWIND_BLOCK];
+
+    for (int block = 0; block < blocks; block++)
+    {
+        Uint32* out = state + block * REWIND_BLOCK;
+        const int size = std::min(REWIND_BLOCK, words - block * REWIND_BLOCK);
+        const int width = header[block * 2];
+        const int exceptionCount = header[block * 2 + 1];
+
+        // Still values are the common case, nothing to unpack or apply
+        if (width == 0)
+        {
+            if (!delta)
+            {
+                std::fill(out, out + size, 0);
+            }
+
+            continue;
+        }
+
+        packed = unpackBlock(packed, width, values);
+
+        for (int i = 0; i < exceptionCount; i++)
+        {
+            const Uint32 exception = *packed++;
+            values[exception & (REWIND_BLOCK - 1)] |= (exception >> REWIND_EXCEPTION_WIDTH) << width;
+        }
+
+        if (!delta)
+        {
+            std::copy(values, values + size, out);
+        }
+        else
+        {
+            for (int i = 0; i < size; i++)
+            {
+                out[i] += unzigzag(values[i]);
+            }
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds the newest tick. A state of a different size than the ticks held starts the buffer
+ over, as the old ticks could no longer be restored into the simulation
+
+ @param state  State of the tick
+ */
+void RewindBuffer::push(const std::vector<Uint32>& state)
+{
+    if ((int)state.size() != words)
+    {
+        clear();
+
+        words = state.size();
+        base.resize(words);
+        decoded.resize(words);
+        disabled = getWorstWords() * 2 > (long)ring.size();
+
+        if (disabled)
+        {
+            printf("Rewind budget of %ld bytes cannot hold a tick of %d words, rewinding is off\n",
+                   (long)(ring.size() * sizeof(Uint32)), words);
+        }
+    }
+
+    if (disabled || words == 0)
+    {
+        return;
+    }
+
+    const long sequence = pushes;
+
+    if (count == capacity)
+    {
+        dropOldest();
+    }
+
+    const long offset = reserve(getWorstWords());
+
+    // Making room can drop every tick, the keyframe this tick would be a delta against too
+    const bool keyframe = count == 0 || sequence % REWIND_KEYFRAME_INTERVAL == 0;
+
+    Record& record = getRecord(sequence);
+    record.offset = offset;
+    record.deltaWords = keyframe ? 0 : encode(state.data(), base.data(), &ring[offset]);
+    record.keyframeWords = keyframe ? encode(state.data(), nullptr, &ring[offset]) : 0;
+
+    if (keyframe)
+    {
+        std::copy(state.begin(), state.end(), base.begin());
+        baseSequence = sequence;
+    }
+
+    head = offset + record.deltaWords + record.keyframeWords;
+    pushes++;
+    count++;
+
+    encodedTicks++;
+    rawWords += words;
+    storedWords += record.deltaWords + record.keyframeWords;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the state of a held tick, its keyframe plus its delta. Scrubbing through the ticks
+ of one keyframe only decodes the keyframe once
+
+ @param back   Ticks back from the newest, 0 for the newest
+ @param state  Set to the tick's state
+ @returns      False if the tick is not held
+ */
+bool RewindBuffer::seek(int back, std::vector<Uint32>& state)
+{
+    if (disabled || back < 0 || back >= count)
+    {
+        return false;
+    }
+
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const long sequence = pushes - 1 - back;
+    const long keyframe = findKeyframe(sequence);
+    const std::vector<Uint32>* keyframeState = &base;
+
+    if (keyframe != baseSequence)
+    {
+        if (keyframe != decodedSequence)
+        {
+            decode(&ring[getRecord(keyframe).offset], false, decoded.data());
+            decodedSequence = keyframe;
+        }
+
+        keyframeState = &decoded;
+    }
+
+    state.assign(keyframeState->begin(), keyframeState->end());
+
+    const Record& record = getRecord(sequence);
+
+    if (record.deltaWords > 0)
+    {
+        decode(&ring[record.offset], true, state.data());
+    }
+
+    const double time = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    seekTime += time;
+    slowestSeek = std::max(slowestSeek, time);
+    seeks++;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops the newest ticks, so the simulation carries on from a tick it was rewound to and
+ the ticks pushed next follow on from it
+
+ @param back  Number of ticks to drop
+ */
+void RewindBuffer::truncate(int back)
+{
+    if (back <= 0 || disabled)
+    {
+        return;
+    }
+
+    if (back >= count)
+    {
+        clear();
+        return;
+    }
+
+    pushes -= back;
+    count -= back;
+
+    const Record& newest = getRecord(pushes - 1);
+    head = newest.offset + newest.deltaWords + newest.keyframeWords;
+
+    // Sequence numbers past the newest tick are used again by the ticks pushed next
+    if (decodedSequence >= pushes)
+    {
+        decodedSequence = -1;
+    }
+
+    // The next ticks are deltas against the keyframe the newest tick belongs to
+    const long keyframe = findKeyframe(pushes - 1);
+
+    if (keyframe != baseSequence)
+    {
+        decode(&ring[getRecord(keyframe).offset], false, base.data());
+        baseSequence = keyframe;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops every tick
+
+ */
+void RewindBuffer::clear()
+{
+    count = 0;
+    head = 0;
+    baseSequence = -1;
+    decodedSequence = -1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of ticks held, the oldest is getCount() - 1 ticks back
+
+ @returns Number of ticks held
+ */
+int RewindBuffer::getCount() const { return count; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the memory taken by encoded ticks, which is the whole budget
+
+ @returns Size of the ring in bytes
+ */
+long RewindBuffer::getResidentBytes() const { return ring.size() * sizeof(Uint32); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints how many ticks are held, how well they packed and how long seeking took
+
+ */
+void RewindBuffer::printStats() const
+{
+    printf("rewind: ticks %d of %d bytes/tick %.0f (%.0f%% of raw) seeks %d avg %.3f ms slowest %.3f ms\n",
+           count, capacity, encodedTicks > 0 ? storedWords * 4.0 / encodedTicks : 0,
+           rawWords > 0 ? storedWords * 100.0 / rawWords : 0, seeks,
+           seeks > 0 ? seekTime * 1000 / seeks : 0, slowestSeek * 1000);
+}
@@ -0,0 +1,89 @@
+#ifndef rewindbuffer_hpp
+#define rewindbuffer_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <SDL.h>
+
+// Every this many ticks the whole state is kept, the ticks up to the next keyframe are kept
+// as the difference from it
+#define REWIND_KEYFRAME_INTERVAL 16
+
+// Values packed together at one bit width
+#define REWIND_BLOCK 32
+
+// Narrowest width a block keeps its widest values apart at, an exception holds the value's
+// index in its low bits and the bits that did not fit above them
+#define REWIND_EXCEPTION_WIDTH 5
+
+
+/**
+ The last ticks of a simulation, for scrubbing back through them. A tick's state is a
+ fixed number of 32 bit words, such as the raw bits of floats. Every
+ REWIND_KEYFRAME_INTERVAL ticks the whole state is kept as a keyframe and the ticks in
+ between as the difference from their keyframe, so restoring any tick takes decoding one
+ keyframe and one delta at most
+
+ Differences are zigzag coded and packed in blocks of REWIND_BLOCK values, each block at
+ the fewest bits that fit its values, so values that barely move take a few bits and
+ still ones none. The few values of a block that would widen it a lot, such as a float
+ changing sign, are kept apart as exceptions of a word each instead. Ticks go in a ring
+ of words with a fixed budget, once it is full or
+ holds the most ticks asked for the oldest keyframe is dropped along with its deltas
+ */
+class RewindBuffer
+{
+private:
+    struct Record
+    {
+        long offset;
+        int deltaWords, keyframeWords;
+    };
+
+    int capacity;
+    std::vector<Uint32> ring;
+    long head = 0;
+
+    // Held ticks by sequence number modulo capacity, pushes is the sequence of the next
+    std::vector<Record> records;
+    long pushes = 0;
+    int count = 0;
+
+    // Words in each tick's state. New ticks are deltas against the newest keyframe, and
+    // the keyframe decoded by the last seek is kept for the next
+    int words = 0;
+    std::vector<Uint32> base, decoded;
+    long baseSequence = -1, decodedSequence = -1;
+    bool disabled = false;
+
+    long encodedTicks = 0, rawWords = 0, storedWords = 0;
+    int seeks = 0;
+    double seekTime = 0, slowestSeek = 0;
+
+    RewindBuffer(const RewindBuffer&);
+    RewindBuffer& operator=(const RewindBuffer&);
+
+    Record& getRecord(long sequence);
+    bool isKeyframe(long sequence);
+    long findKeyframe(long sequence);
+    long getWorstWords() const;
+    void dropOldest();
+    long reserve(long needed);
+    long encode(const Uint32* state, const Uint32* base, Uint32* out) const;
+    void decode(const Uint32* in, bool delta, Uint32* state) const;
+
+public:
+    RewindBuffer(int capacity, long budget);
+
+    void push(const std::vector<Uint32>& state);
+    bool seek(int back, std::vector<Uint32>& state);
+    void truncate(int back);
+    void clear();
+
+    int getCount() const;
+    long getResidentBytes() const;
+    void printStats() const;
+};
+
+
+#endif /* rewindbuffer_hpp */
@@ -0,0 +1,502 @@
+#include "rotationcache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+/** --------------------------------------------------------------------------------------
+ Compares every field that changes what a sprite looks like rotated
+
+ @param other  Sprite to compare with
+ @returns      True if both sprites rotate to the same pixels
+ */
+bool RotationCache::Sprite::operator==(const Sprite& other) const
+{
+    return source == other.source && sourceRect.x == other.sourceRect.x && sourceRect.y == other.sourceRect.y &&
+           sourceRect.w == other.sourceRect.w && sourceRect.h == other.sourceRect.h && width == other.width &&
+           height == other.height && center.x == other.center.x && center.y == other.center.y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Hashes every field compared by Sprite::operator==
+
+ @param sprite  Sprite to hash
+ @returns       Hash of the sprite
+ */
+size_t RotationCache::SpriteHash::operator()(const Sprite& sprite) const
+{
+    const int values[8] = {sprite.sourceRect.x, sprite.sourceRect.y, sprite.sourceRect.w, sprite.sourceRect.h,
+                           sprite.width, sprite.height, sprite.center.x, sprite.center.y};
+
+    size_t hash = std::hash<const void*>()(sprite.source);
+
+    for (int value : values)
+    {
+        hash = hash * 31 + value;
+    }
+
+    return hash;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty rotation cache
+
+ @param renderer  Renderer to draw with and create the pages on
+ @param steps     Number of angles a full turn is rounded to
+ @param budget    Most bytes of pages to keep, once it is reached the least recently drawn
+                  frames make way for new ones
+ */
+RotationCache::RotationCache(SDL_Renderer *renderer, int steps, long budget)
+    : renderer(renderer), steps(std::max(1, steps)), budget(budget)
+{
+    // Frames are rotated by drawing into the pages
+    enabled = SDL_RenderTargetSupported(renderer);
+
+    if (!enabled)
+    {
+        printf("Renderer has no render targets, sprites are rotated as they are drawn\n");
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Deconstructs the cache, destroying its pages
+
+ */
+RotationCache::~RotationCache()
+{
+    clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the width and height of the cell a sprite is rotated into, wide enough for it at any
+ angle with its center in the middle of the cell
+
+ @param sprite  Sprite to fit
+ @returns       Width and height of the cell, a multiple of 8
+ */
+int RotationCache::getCellSize(const Sprite& sprite)
+{
+    const float reachX = std::max(sprite.center.x, sprite.width - sprite.center.x);
+    const float reachY = std::max(sprite.center.y, sprite.height - sprite.center.y);
+    const int reach = (int)ceilf(sqrtf(reachX * reachX + reachY * reachY)) + 1;
+
+    return (reach * 2 + 7) & ~7;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the index of a sprite, adding it if it has not been drawn before
+
+ @param sprite  Sprite to find
+ @returns       Index of the sprite
+ */
+int RotationCache::getSpriteIndex(const Sprite& sprite)
+{
+    auto found = spriteIndices.find(sprite);
+
+    if (found != spriteIndices.end())
+    {
+        return found->second;
+    }
+
+    int index;
+
+    if (!freeSprites.empty())
+    {
+        index = freeSprites.back();
+        freeSprites.pop_back();
+        sprites[index] = sprite;
+    }
+    else
+    {
+        index = sprites.size();
+        sprites.push_back(sprite);
+    }
+
+    spriteIndices[sprite] = index;
+
+    return index;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the rectangle of a cell within its page
+
+ @param page  Page the cell is on
+ @param cell  Index of the cell, row by row
+ @returns     Rectangle of the cell
+ */
+SDL_Rect RotationCache::getCellRect(const Page& page, int cell) const
+{
+    const SDL_Rect rect = {(cell % page.columns) * page.cellSize, (cell / page.columns) * page.cellSize,
+                           page.cellSize, page.cellSize};
+    return rect;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds a free cell of a size, adding a page if the budget allows and otherwise dropping
+ the least recently drawn frames until one is free
+
+ @param cellSize  Width and height of the cell
+ @param page      Set to the index of the page the cell is on
+ @param cell      Set to the index of the cell on the page
+ @returns         False if every frame left was drawn this frame and none can be dropped
+ */
+bool RotationCache::allocateCell(int cellSize, int& page, int& cell)
+{
+    const int pageSize = std::max(ROTATION_PAGE_SIZE, cellSize);
+    const long pageBytes = (long)pageSize * pageSize * 4;
+
+    while (true)
+    {
+        for (size_t i = 0; i < pages.size(); i++)
+        {
+            if (pages[i].texture != nullptr && pages[i].cellSize == cellSize && !pages[i].freeCells.empty())
+            {
+                page = i;
+                cell = pages[i].freeCells.back();
+
+                pages[i].freeCells.pop_back();
+                pages[i].usedCells++;
+
+                return true;
+            }
+        }
+
+        if (residentBytes + pageBytes <= budget)
+        {
+            // Same format as the software renderer's window, so drawing a cell is a plain blit
+            SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                                     pageSize, pageSize);
+
+            if (texture == nullptr)
+            {
+                printf("Failed to create rotation page: %s\n", SDL_GetError());
+                return false;
+            }
+
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+            Page created;
+            created.texture = texture;
+            created.cellSize = cellSize;
+            created.columns = pageSize / cellSize;
+            created.usedCells = 0;
+
+            // Handed out from the back, so the first cells go first
+            for (int i = created.columns * created.columns - 1; i >= 0; i--)
+            {
+                created.freeCells.push_back(i);
+            }
+
+            // Take the place of a destroyed page if there is one
+            auto slot = std::find_if(pages.begin(), pages.end(), [](const Page& page) { return page.texture == nullptr; });
+
+            if (slot != pages.end())
+            {
+                *slot = created;
+            }
+            else
+            {
+                pages.push_back(created);
+            }
+
+            residentBytes += pageBytes;
+            continue;
+        }
+
+        if (!evict())
+        {
+            return false;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops the least recently drawn frame, never one drawn this frame
+
+ @returns  False if there was nothing to drop
+ */
+bool RotationCache::evict()
+{
+    if (resident.empty() || resident.back().usedAt == frame)
+    {
+        return false;
+    }
+
+    freeCell(resident.back().page, resident.back().cell);
+    lookup.erase(resident.back().key);
+    resident.pop_back();
+    evictions++;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gives a cell back to its page, destroying the page once none of its cells are used
+
+ @param page  Index of the page the cell is on
+ @param cell  Index of the cell on the page
+ */
+void RotationCache::freeCell(int page, int cell)
+{
+    Page& owner = pages[page];
+
+    owner.freeCells.push_back(cell);
+    owner.usedCells--;
+
+    if (owner.usedCells == 0)
+    {
+        const long pageSize = std::max(ROTATION_PAGE_SIZE, owner.cellSize);
+
+        SDL_DestroyTexture(owner.texture);
+        owner.texture = nullptr;
+        owner.freeCells.clear();
+
+        residentBytes -= pageSize * pageSize * 4;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Rotates a sprite into a cell, with its center in the middle of the cell. The sprite is
+ copied without blending so the cell keeps its plain alpha, rather than the premultiplied
+ alpha blending into a cleared cell would leave, which the software renderer has no blend
+ mode to draw
+
+ @param sprite  Sprite to rotate
+ @param step    Step of the angle to rotate to
+ @param page    Page the cell is on
+ @param cell    Index of the cell on the page
+ */
+void RotationCache::bake(const Sprite& sprite, int step, const Page& page, int cell)
+{
+    const SDL_Rect cellRect = getCellRect(page, cell);
+    const SDL_Rect destination = {cellRect.x + page.cellSize / 2 - sprite.center.x,
+                                  cellRect.y + page.cellSize / 2 - sprite.center.y, sprite.width, sprite.height};
+    const SDL_Rect* sourceRect = sprite.sourceRect.w > 0 ? &sprite.sourceRect : nullptr;
+
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    SDL_BlendMode drawBlendMode, sourceBlendMode;
+    Uint8 r, g, b, a;
+
+    SDL_SetRenderTarget(renderer, page.texture);
+
+    // Clear the cell, a frame dropped from it may have left pixels the rotation misses
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(renderer, &drawBlendMode);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_RenderFillRect(renderer, &cellRect);
+    SDL_SetRenderDrawBlendMode(renderer, drawBlendMode);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+    SDL_GetTextureBlendMode(sprite.source, &sourceBlendMode);
+    SDL_SetTextureBlendMode(sprite.source, SDL_BLENDMODE_NONE);
+    SDL_RenderCopyEx(renderer, sprite.source, sourceRect, &destination, step * (360.0 / steps), &sprite.center,
+                     SDL_FLIP_NONE);
+    SDL_SetTextureBlendMode(sprite.source, sourceBlendMode);
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+
+    bakes++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws a sprite rotated clockwise around its center to the step nearest to a direction,
+ rotating it into the cache first if it has not been drawn at that step recently. When
+ there is no room the sprite is rotated as it is drawn
+
+ @param source      Texture to draw from
+ @param sourceRect  Region of the texture to draw, nullptr for all of it
+ @param rect        Destination rectangle on screen
+ @param direction   Unit vector the sprite points along, (1, 0) is unrotated
+ @param center      Center of rotation relative to the top left of rect
+ */
+void RotationCache::draw(SDL_Texture* source, const SDL_Rect* sourceRect, const SDL_Rect& rect,
+                         const Vec2& direction, const SDL_Point& center)
+{
+    const float angle = direction.angle();
+    const int step = (((int)lroundf(angle * steps / (2 * (float)M_PI)) % steps) + steps) % steps;
+
+    // Unrotated sprites are already a plain copy
+    if (step == 0)
+    {
+        SDL_RenderCopy(renderer, source, sourceRect, &rect);
+        return;
+    }
+
+    if (!enabled)
+    {
+        SDL_RenderCopyEx(renderer, source, sourceRect, &rect, angle * (180.0 / M_PI), &center, SDL_FLIP_NONE);
+        misses++;
+        return;
+    }
+
+    Sprite sprite;
+    sprite.source = source;
+    sprite.sourceRect = sourceRect != nullptr ? *sourceRect : SDL_Rect{0, 0, 0, 0};
+    sprite.width = rect.w;
+    sprite.height = rect.h;
+    sprite.center = center;
+
+    const Uint64 key = (Uint64)getSpriteIndex(sprite) * steps + step;
+    auto found = lookup.find(key);
+
+    if (found != lookup.end())
+    {
+        // Move to the front, it is the most recently drawn now
+        resident.splice(resident.begin(), resident, found->second);
+        found->second->usedAt = frame;
+    }
+    else
+    {
+        Frame created;
+        created.key = key;
+        created.usedAt = frame;
+
+        if (!allocateCell(getCellSize(sprite), created.page, created.cell))
+        {
+            SDL_RenderCopyEx(renderer, source, sourceRect, &rect, angle * (180.0 / M_PI), &center, SDL_FLIP_NONE);
+            misses++;
+            return;
+        }
+
+        bake(sprite, step, pages[created.page], created.cell);
+
+        resident.push_front(created);
+        lookup[key] = resident.begin();
+    }
+
+    const Page& page = pages[resident.front().page];
+    const SDL_Rect cellRect = getCellRect(page, resident.front().cell);
+    const SDL_Rect destination = {rect.x + center.x - page.cellSize / 2, rect.y + center.y - page.cellSize / 2,
+                                  page.cellSize, page.cellSize};
+
+    SDL_RenderCopy(renderer, page.texture, &cellRect, &destination);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts a new frame, frames drawn in the one before become free to drop. Call once per
+ frame before drawing
+
+ */
+void RotationCache::nextFrame()
+{
+    frame++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops every rotated frame of a source texture and forgets its sprites, call before the
+ texture is destroyed
+
+ @param source  Texture about to be destroyed
+ */
+void RotationCache::evict(SDL_Texture* source)
+{
+    if (source == nullptr)
+    {
+        return;
+    }
+
+    for (auto i = resident.begin(); i != resident.end(); )
+    {
+        if (sprites[i->key / steps].source == source)
+        {
+            freeCell(i->page, i->cell);
+            lookup.erase(i->key);
+            i = resident.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    for (size_t index = 0; index < sprites.size(); index++)
+    {
+        if (sprites[index].source == source)
+        {
+            spriteIndices.erase(sprites[index]);
+            sprites[index].source = nullptr;
+            freeSprites.push_back(index);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops every rotated frame and destroys the pages, for when the renderer has lost what was
+ drawn into them or the sources are going away
+
+ */
+void RotationCache::clear()
+{
+    for (Page& page : pages)
+    {
+        if (page.texture != nullptr)
+        {
+            SDL_DestroyTexture(page.texture);
+        }
+    }
+
+    pages.clear();
+    resident.clear();
+    lookup.clear();
+    sprites.clear();
+    spriteIndices.clear();
+    freeSprites.clear();
+    residentBytes = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of angles a full turn is rounded to
+
+ */
+int RotationCache::getSteps() const { return steps; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the memory taken up by the pages in bytes
+
+ */
+long RotationCache::getResidentBytes() const { return residentBytes; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints how often sprites were rotated and how much memory the rotated frames take
+
+ */
+void RotationCache::printStats() const
+{
+    printf("rotation cache: %d steps, %d bakes, %d evictions, %d rotated on the fly, %d frames, %ld kb resident of %ld kb budget\n",
+           steps, bakes, evictions, misses, (int)resident.size(), residentBytes / 1024, budget / 1024);
+}
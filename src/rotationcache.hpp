@@ -0,0 +1,109 @@
+#ifndef rotationcache_hpp
+#define rotationcache_hpp
+
+#include <stdio.h>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <SDL.h>
+#include "math2d.hpp"
+
+// Width and height of a page of rotated frames, larger sprites get a page each
+#define ROTATION_PAGE_SIZE 1024
+
+
+/**
+ Rotated copies of sprites for renderers that rotate slowly, such as the software renderer,
+ which rotates every pixel of a sprite each time it is drawn at an angle. Angles are
+ rounded to one of a fixed number of steps and each sprite is rotated to a step once, into
+ a cell of a page, the first time it is drawn at it. After that drawing it is a plain copy
+ of the cell. The least recently drawn frames are dropped once the pages take up more than
+ a memory budget
+
+ Sprites are told apart by their source texture, source rectangle, size on screen and
+ center, so a sprite drawn at a new size is rotated again. A source's frames have to be
+ evicted before it is destroyed, or the cache be cleared, so a texture created later at
+ the same address is not drawn with them
+ */
+class RotationCache
+{
+private:
+    struct Sprite
+    {
+        SDL_Texture* source;
+        SDL_Rect sourceRect;
+        int width, height;
+        SDL_Point center;
+
+        bool operator==(const Sprite& other) const;
+    };
+
+    struct SpriteHash
+    {
+        size_t operator()(const Sprite& sprite) const;
+    };
+
+    struct Page
+    {
+        SDL_Texture* texture;
+        int cellSize, columns;
+        std::vector<int> freeCells;
+        int usedCells;
+    };
+
+    struct Frame
+    {
+        Uint64 key;
+        int page, cell;
+        int usedAt;
+    };
+
+    SDL_Renderer *renderer;
+    int steps;
+    long budget, residentBytes = 0;
+
+    // Sprites seen so far, a frame's key is its sprite's index times steps plus its step
+    std::vector<Sprite> sprites;
+    std::unordered_map<Sprite, int, SpriteHash> spriteIndices;
+
+    // Indices of sprites whose source was evicted, reused for new sprites
+    std::vector<int> freeSprites;
+
+    // Pages by index, destroyed ones are nullptr until a new page takes their place
+    std::vector<Page> pages;
+
+    // Rotated frames, most recently drawn at the front
+    std::list<Frame> resident;
+    std::unordered_map<Uint64, std::list<Frame>::iterator> lookup;
+
+    bool enabled;
+    int frame = 0, bakes = 0, evictions = 0, misses = 0;
+
+    RotationCache(const RotationCache&);
+    RotationCache& operator=(const RotationCache&);
+
+    static int getCellSize(const Sprite& sprite);
+    int getSpriteIndex(const Sprite& sprite);
+    bool allocateCell(int cellSize, int& page, int& cell);
+    bool evict();
+    void freeCell(int page, int cell);
+    void bake(const Sprite& sprite, int step, const Page& page, int cell);
+    SDL_Rect getCellRect(const Page& page, int cell) const;
+
+public:
+    RotationCache(SDL_Renderer *renderer, int steps, long budget);
+    ~RotationCache();
+
+    void draw(SDL_Texture* source, const SDL_Rect* sourceRect, const SDL_Rect& rect, const Vec2& direction,
+              const SDL_Point& center);
+    void nextFrame();
+    void evict(SDL_Texture* source);
+    void clear();
+
+    int getSteps() const;
+    long getResidentBytes() const;
+    void printStats() const;
+};
+
+
+#endif /* rotationcache_hpp */
@@ -0,0 +1,451 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+
+/**
+ Bits of the field byte in front of each entity in a datagram. An entity that changed has
+ a bit set for each field that differs from the baseline, followed by the differences. A
+ new entity is written as a change from an entity with every field 0
+ */
+enum SnapshotField
+{
+    FIELD_X = 1,
+    FIELD_Y = 2,
+    FIELD_VELOCITY_X = 4,
+    FIELD_VELOCITY_Y = 8,
+    FIELD_ANGLE = 16,
+    FIELD_FLAGS = 32,
+    FIELD_NEW = 64,
+    FIELD_REMOVED = 128
+};
+
+// Most bytes one entity can take, its id gap, field byte and every field at full length
+#define SNAPSHOT_MAX_ENTITY 30
+
+
+/** --------------------------------------------------------------------------------------
+ Finds an entity by id
+
+ @param id  Id of the entity
+ @returns   The entity, nullptr if it is not in the snapshot
+ */
+const SnapshotEntity* Snapshot::find(Uint32 id) const
+{
+    auto found = std::lower_bound(entities.begin(), entities.end(), id,
+                                  [](const SnapshotEntity& entity, Uint32 id) { return entity.id < id; });
+
+    return found != entities.end() && found->id == id ? &*found : nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Appends a value 7 bits per byte, low bits first, with the top bit set on every byte but
+ the last, so small values take a single byte
+
+ @param out    Bytes to append to
+ @param value  Value to write
+ */
+static void writeVarint(std::vector<Uint8>& out, Uint32 value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+
+    out.push_back(value);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Appends a signed difference, zigzag encoded so small negative values stay small
+
+ @param out    Bytes to append to
+ @param delta  Difference to write
+ */
+static void writeDelta(std::vector<Uint8>& out, Sint32 delta)
+{
+    writeVarint(out, ((Uint32)delta << 1) ^ (Uint32)(delta >> 31));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads a value written by writeVarint
+
+ @param data    Next byte to read, moved past the value
+ @param end     End of the datagram
+ @param value   Set to the value read
+ @returns       False if the datagram ends inside the value
+ */
+static bool readVarint(const Uint8*& data, const Uint8* end, Uint32& value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (data == end)
+        {
+            return false;
+        }
+
+        const Uint8 byte = *data++;
+        value |= (Uint32)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads a difference written by writeDelta
+
+ @param data    Next byte to read, moved past the value
+ @param end     End of the datagram
+ @param delta   Set to the difference read
+ @returns       False if the datagram ends inside the value
+ */
+static bool readDelta(const Uint8*& data, const Uint8* end, Sint32& delta)
+{
+    Uint32 value;
+
+    if (!readVarint(data, end, value))
+    {
+        return false;
+    }
+
+    delta = (Sint32)((value >> 1) ^ (0 - (value & 1)));
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts a datagram with the snapshot header, little endian
+
+ @param out     Datagram to write, cleared first
+ @param header  Header to write
+ */
+static void writeHeader(std::vector<Uint8>& out, const SnapshotHeader& header)
+{
+    out.clear();
+    out.push_back(NET_SNAPSHOT);
+    out.push_back(header.fragment);
+    out.push_back(header.fragmentCount);
+    out.push_back(header.tickRate & 0xFF);
+    out.push_back(header.tickRate >> 8);
+    out.push_back(header.interval);
+
+    for (int i = 0; i < 4; i++) out.push_back(header.tick >> (i * 8));
+    for (int i = 0; i < 4; i++) out.push_back(header.baselineTick >> (i * 8));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the fields of an entity that differ from the baseline entity
+
+ @param entity    Entity as it is now
+ @param baseline  Entity as the client has it
+ @returns         SnapshotField bits of the fields that changed, 0 if none did
+ */
+static Uint8 getChangedFields(const SnapshotEntity& entity, const SnapshotEntity& baseline)
+{
+    Uint8 fields = 0;
+
+    if (entity.x != baseline.x) fields |= FIELD_X;
+    if (entity.y != baseline.y) fields |= FIELD_Y;
+    if (entity.velocityX != baseline.velocityX) fields |= FIELD_VELOCITY_X;
+    if (entity.velocityY != baseline.velocityY) fields |= FIELD_VELOCITY_Y;
+    if (entity.angle != baseline.angle) fields |= FIELD_ANGLE;
+    if (entity.flags != baseline.flags) fields |= FIELD_FLAGS;
+
+    return fields;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Appends one entity as its changes from the baseline entity
+
+ @param out       Datagram to append to
+ @param entity    Entity as it is now
+ @param baseline  Entity as the client has it, all 0 for a new entity
+ @param fields    SnapshotField bits to write, with the bits of the changed fields
+ @param lastId    Id of the entity written before this one in the datagram, updated
+ */
+static void writeEntity(std::vector<Uint8>& out, const SnapshotEntity& entity, const SnapshotEntity& baseline,
+                        Uint8 fields, Uint32& lastId)
+{
+    // Ids ascend, so each is written as the gap from the last
+    writeVarint(out, entity.id - lastId);
+    out.push_back(fields);
+    lastId = entity.id;
+
+    if (fields & FIELD_X) writeDelta(out, entity.x - baseline.x);
+    if (fields & FIELD_Y) writeDelta(out, entity.y - baseline.y);
+    if (fields & FIELD_VELOCITY_X) writeDelta(out, entity.velocityX - baseline.velocityX);
+    if (fields & FIELD_VELOCITY_Y) writeDelta(out, entity.velocityY - baseline.velocityY);
+    if (fields & FIELD_ANGLE) writeDelta(out, (Sint16)(entity.angle - baseline.angle));
+    if (fields & FIELD_FLAGS) out.push_back(entity.flags);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Encodes a snapshot as its changes from a baseline the client already has, split into
+ datagrams. Entities the same as in the baseline are left out, those that moved only send
+ the fields that changed, and the baseline's entities that are gone are sent as removed.
+ Without a baseline every entity is new
+
+ @param current      Snapshot to send
+ @param baseline     Snapshot the client acknowledged, nullptr to send it whole
+ @param header       Tick, tick rate, interval and baseline tick to write in each datagram
+ @param packets      Datagrams, reused between calls so they keep their capacity
+ @param packetCount  Set to the number of datagrams written
+ @returns            False if the snapshot needs more than SNAPSHOT_MAX_FRAGMENTS datagrams
+ */
+bool encodeSnapshot(const Snapshot& current, const Snapshot* baseline, SnapshotHeader header,
+                    std::vector<std::vector<Uint8>>& packets, int& packetCount)
+{
+    static const SnapshotEntity zero = {0, 0, 0, 0, 0, 0, 0};
+
+    const std::vector<SnapshotEntity>& now = current.entities;
+    const std::vector<SnapshotEntity>* before = baseline != nullptr ? &baseline->entities : nullptr;
+    const size_t beforeCount = before != nullptr ? before->size() : 0;
+
+    packetCount = 0;
+    Uint32 lastId = 0;
+    size_t i = 0, j = 0;
+
+    while (i < now.size() || j < beforeCount)
+    {
+        // Start a new datagram when the next entity might not fit
+        if (packetCount == 0 || packets[packetCount - 1].size() + SNAPSHOT_MAX_ENTITY > SNAPSHOT_MAX_PACKET)
+        {
+            if (packetCount == SNAPSHOT_MAX_FRAGMENTS)
+            {
+                return false;
+            }
+
+            if (packetCount == (int)packets.size())
+            {
+                packets.emplace_back();
+                packets.back().reserve(SNAPSHOT_MAX_PACKET);
+            }
+
+            header.fragment = packetCount;
+            writeHeader(packets[packetCount++], header);
+            lastId = 0;
+        }
+
+        std::vector<Uint8>& out = packets[packetCount - 1];
+
+        if (j == beforeCount || (i < now.size() && now[i].id < (*before)[j].id))
+        {
+            writeEntity(out, now[i], zero, FIELD_NEW | getChangedFields(now[i], zero), lastId);
+            i++;
+        }
+        else if (i == now.size() || (*before)[j].id < now[i].id)
+        {
+            writeEntity(out, (*before)[j++], zero, FIELD_REMOVED, lastId);
+        }
+        else
+        {
+            const SnapshotEntity& entity = now[i++];
+            const SnapshotEntity& previous = (*before)[j++];
+            const Uint8 fields = getChangedFields(entity, previous);
+
+            if (fields != 0)
+            {
+                writeEntity(out, entity, previous, fields, lastId);
+            }
+        }
+    }
+
+    // Nothing changed, still send the header so the client knows the tick
+    if (packetCount == 0)
+    {
+        if (packets.empty())
+        {
+            packets.emplace_back();
+        }
+
+        header.fragment = 0;
+        writeHeader(packets[packetCount++], header);
+    }
+
+    // Every datagram carries the count, which is only known now
+    for (int p = 0; p < packetCount; p++)
+    {
+        packets[p][2] = packetCount;
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads the header of a snapshot datagram
+
+ @param data    Datagram
+ @param length  Length of the datagram
+ @param header  Set to the header read
+ @returns       False if it is not a snapshot datagram or its header is not one a server
+                sends, such as one with no interval between snapshots
+ */
+bool decodeSnapshotHeader(const Uint8* data, int length, SnapshotHeader& header)
+{
+    if (length < SNAPSHOT_HEADER_SIZE || data[0] != NET_SNAPSHOT)
+    {
+        return false;
+    }
+
+    header.fragment = data[1];
+    header.fragmentCount = data[2];
+    header.tickRate = data[3] | (data[4] << 8);
+    header.interval = data[5];
+    header.tick = data[6] | (data[7] << 8) | (data[8] << 16) | ((Uint32)data[9] << 24);
+    header.baselineTick = data[10] | (data[11] << 8) | (data[12] << 16) | ((Uint32)data[13] << 24);
+
+    return header.fragmentCount > 0 && header.fragment < header.fragmentCount &&
+           header.fragmentCount <= SNAPSHOT_MAX_FRAGMENTS && header.tickRate > 0 && header.interval > 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads the entities of a snapshot datagram as changes, to apply to the baseline once every
+ datagram of the snapshot is in
+
+ @param data     Datagram
+ @param length   Length of the datagram
+ @param changes  Changes read are appended to this
+ @returns        False if the datagram is cut short
+ */
+bool decodeSnapshot(const Uint8* data, int length, std::vector<SnapshotChange>& changes)
+{
+    const Uint8* end = data + length;
+    data += SNAPSHOT_HEADER_SIZE;
+
+    Uint32 id = 0;
+
+    while (data < end)
+    {
+        SnapshotChange change = {{0, 0, 0, 0, 0, 0, 0}, 0};
+        Uint32 gap;
+        Sint32 delta;
+
+        if (!readVarint(data, end, gap) || data == end)
+        {
+            return false;
+        }
+
+        id += gap;
+        change.entity.id = id;
+        change.fields = *data++;
+
+        SnapshotEntity& e = change.entity;
+
+        if (change.fields & FIELD_X) { if (!readDelta(data, end, delta)) return false; e.x = delta; }
+        if (change.fields & FIELD_Y) { if (!readDelta(data, end, delta)) return false; e.y = delta; }
+        if (change.fields & FIELD_VELOCITY_X) { if (!readDelta(data, end, delta)) return false; e.velocityX = delta; }
+        if (change.fields & FIELD_VELOCITY_Y) { if (!readDelta(data, end, delta)) return false; e.velocityY = delta; }
+        if (change.fields & FIELD_ANGLE) { if (!readDelta(data, end, delta)) return false; e.angle = delta; }
+
+        if (change.fields & FIELD_FLAGS)
+        {
+            if (data == end)
+            {
+                return false;
+            }
+
+            e.flags = *data++;
+        }
+
+        changes.push_back(change);
+    }
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Builds a snapshot from the baseline and the changes read from every datagram of it, in
+ datagram order so the changes are sorted by id
+
+ @param baseline  Snapshot the changes are against, nullptr when it was sent whole
+ @param changes   Changes from decodeSnapshot
+ @param result    Set to the entities of the snapshot, its tick is left alone
+ @returns         False if a change is to an entity the baseline does not have
+ */
+bool applySnapshot(const Snapshot* baseline, const std::vector<SnapshotChange>& changes, Snapshot& result)
+{
+    static const std::vector<SnapshotEntity> none;
+    const std::vector<SnapshotEntity>& before = baseline != nullptr ? baseline->entities : none;
+
+    result.entities.clear();
+
+    size_t j = 0;
+
+    for (const SnapshotChange& change : changes)
+    {
+        // Entities up to the changed one are the same as in the baseline
+        while (j < before.size() && before[j].id < change.entity.id)
+        {
+            result.entities.push_back(before[j++]);
+        }
+
+        const bool inBaseline = j < before.size() && before[j].id == change.entity.id;
+
+        if (change.fields & FIELD_REMOVED)
+        {
+            j += inBaseline ? 1 : 0;
+            continue;
+        }
+
+        SnapshotEntity entity = {change.entity.id, 0, 0, 0, 0, 0, 0};
+
+        if (!(change.fields & FIELD_NEW))
+        {
+            if (!inBaseline)
+            {
+                return false;
+            }
+
+            entity = before[j++];
+        }
+        else if (inBaseline)
+        {
+            j++;
+        }
+
+        const SnapshotEntity& delta = change.entity;
+
+        if (change.fields & FIELD_X) entity.x += delta.x;
+        if (change.fields & FIELD_Y) entity.y += delta.y;
+        if (change.fields & FIELD_VELOCITY_X) entity.velocityX += delta.velocityX;
+        if (change.fields & FIELD_VELOCITY_Y) entity.velocityY += delta.velocityY;
+        if (change.fields & FIELD_ANGLE) entity.angle += delta.angle;
+        if (change.fields & FIELD_FLAGS) entity.flags = delta.flags;
+
+        result.entities.push_back(entity);
+    }
+
+    while (j < before.size())
+    {
+        result.entities.push_back(before[j++]);
+    }
+
+    return true;
+}
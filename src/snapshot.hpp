@@ -0,0 +1,97 @@
+#ifndef snapshot_hpp
+#define snapshot_hpp
+
+#include <vector>
+#include <SDL.h>
+
+/**
+ Snapshots quantize positions to 1 / 8 of a pixel, velocities to 1 / 256 of a pixel per
+ 60hz frame and angles to 65536ths of a turn
+ */
+#define SNAPSHOT_POSITION_SCALE 8.0f
+#define SNAPSHOT_VELOCITY_SCALE 256.0f
+
+// Largest datagram written, below the usual internet MTU so nothing is fragmented by IP
+#define SNAPSHOT_MAX_PACKET 1200
+
+// Most datagrams one snapshot is split across
+#define SNAPSHOT_MAX_FRAGMENTS 64
+
+// Bytes before the first entity of every snapshot datagram
+#define SNAPSHOT_HEADER_SIZE 14
+
+// First byte of every datagram between server and clients
+enum NetPacketType
+{
+    NET_SNAPSHOT = 1,
+    NET_ACK = 2
+};
+
+enum SnapshotEntityFlag
+{
+    SNAPSHOT_SPRITE = 1
+};
+
+
+/**
+ Quantized state of one entity as clients see it. The id is the registry index in the
+ high bits and the low bits of the generation, so a reused index is a new id
+ */
+struct SnapshotEntity
+{
+    Uint32 id;
+    Sint32 x, y, velocityX, velocityY;
+    Uint16 angle;
+    Uint8 flags;
+
+    static Uint32 makeId(int index, int generation) { return ((Uint32)index << 8) | (generation & 0xFF); }
+};
+
+
+/**
+ Every entity a client can see on one tick, sorted by id
+ */
+struct Snapshot
+{
+    Uint32 tick = 0;
+    std::vector<SnapshotEntity> entities;
+
+    const SnapshotEntity* find(Uint32 id) const;
+};
+
+
+/**
+ Fields at the front of every snapshot datagram. The entities of a snapshot are split
+ across fragmentCount datagrams that are each decoded on their own, and only a snapshot
+ with every fragment can be acknowledged
+ */
+struct SnapshotHeader
+{
+    Uint8 fragment, fragmentCount;
+    Uint16 tickRate;
+    Uint8 interval;
+    Uint32 tick;
+
+    // Tick of the snapshot this one is a delta against, 0 when it is sent whole
+    Uint32 baselineTick;
+};
+
+
+/**
+ Entity as read from a datagram, a change to the entity with the same id in the baseline
+ */
+struct SnapshotChange
+{
+    SnapshotEntity entity;
+    Uint8 fields;
+};
+
+
+bool encodeSnapshot(const Snapshot& current, const Snapshot* baseline, SnapshotHeader header,
+                    std::vector<std::vector<Uint8>>& packets, int& packetCount);
+bool decodeSnapshotHeader(const Uint8* data, int length, SnapshotHeader& header);
+bool decodeSnapshot(const Uint8* data, int length, std::vector<SnapshotChange>& changes);
+bool applySnapshot(const Snapshot* baseline, const std::vector<SnapshotChange>& changes, Snapshot& result);
+
+
+#endif /* snapshot_hpp */
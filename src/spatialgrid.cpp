@@ -0,0 +1,471 @@
+#include "spatialgrid.hpp"
+
+#include <algorithm>
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty grid
+
+ @param cellSize      Width and height of a grid cell
+ */
+SpatialGrid::SpatialGrid(float cellSize)
+    : cellSize(cellSize)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the size of the grid cells. Changing the size refiles every body on the next update
+
+ @param cellSize      Width and height of a grid cell
+ */
+void SpatialGrid::setCellSize(float cellSize)
+{
+    this->cellSize = cellSize;
+
+    cellKeys.clear();
+    cellHeads.clear();
+    cellCount = 0;
+    bodyCell.clear();
+    bodyPrev.clear();
+    bodyNext.clear();
+    bodySeen.clear();
+    bodyFiled.clear();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the size of the grid cells
+
+ @returns Width and height of a grid cell
+ */
+float SpatialGrid::getCellSize() const { return cellSize; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Packs the coordinates of the cell containing a point into a single key
+
+ @param x             Horizontal position of the point
+ @param y             Vertical position of the point
+ @returns             Key of the cell the point lies in
+ */
+long long SpatialGrid::getCellKey(float x, float y) const
+{
+    return packCellKey((int)floorf(x / cellSize), (int)floorf(y / cellSize));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Packs cell coordinates into a single key, x in the high 32 bits and y in the low 32 bits
+
+ @param cellX         Horizontal cell coordinate
+ @param cellY         Vertical cell coordinate
+ @returns             Key of the cell
+ */
+long long SpatialGrid::packCellKey(int cellX, int cellY)
+{
+    return (long long)(((unsigned long long)(unsigned int)cellX << 32) | (unsigned int)cellY);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the slot of the cell table a cell key is looked up from first, by mixing the key's
+ bits so neighbouring cells spread over the table
+
+ @param key           Key of the cell
+ @returns             Slot the search for the cell starts at
+ */
+size_t SpatialGrid::getHomeSlot(long long key) const
+{
+    unsigned long long hash = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash >> 32) & (cellKeys.size() - 1);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds the slot of a filled cell in the cell table
+
+ @param key           Key of the cell
+ @returns             Slot of the cell, -1 if no body is filed under it
+ */
+int SpatialGrid::findCell(long long key) const
+{
+    if (cellCount == 0)
+    {
+        return -1;
+    }
+
+    const size_t mask = cellKeys.size() - 1;
+
+    for (size_t slot = getHomeSlot(key); cellHeads[slot] != -1; slot = (slot + 1) & mask)
+    {
+        if (cellKeys[slot] == key)
+        {
+            return (int)slot;
+        }
+    }
+
+    return -1;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Adds an empty cell to the cell table, growing the table first if it would be more than
+ half full
+
+ @param key           Key of the cell, not already in the table
+ @returns             Slot of the cell
+ */
+int SpatialGrid::addCell(long long key)
+{
+    if ((cellCount + 1) * 2 > (int)cellKeys.size())
+    {
+        growCells();
+    }
+
+    const size_t mask = cellKeys.size() - 1;
+    size_t slot = getHomeSlot(key);
+
+    while (cellHeads[slot] != -1)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    cellKeys[slot] = key;
+    cellCount++;
+
+    return (int)slot;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops an emptied cell from the cell table. Cells after it in the same run of filled slots
+ are shifted back into the gap if their search would otherwise stop at it
+
+ @param slot          Slot of the cell
+ */
+void SpatialGrid::dropCell(int slot)
+{
+    const size_t mask = cellKeys.size() - 1;
+    size_t gap = slot;
+
+    cellHeads[gap] = -1;
+    cellCount--;
+
+    for (size_t next = (gap + 1) & mask; cellHeads[next] != -1; next = (next + 1) & mask)
+    {
+        const size_t home = getHomeSlot(cellKeys[next]);
+
+        // The cell can fill the gap if its home slot is not between the gap and it
+        if (((next - home) & mask) >= ((next - gap) & mask))
+        {
+            cellKeys[gap] = cellKeys[next];
+            cellHeads[gap] = cellHeads[next];
+            cellHeads[next] = -1;
+            gap = next;
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Doubles the cell table and refiles the cells in it
+
+ */
+void SpatialGrid::growCells()
+{
+    std::vector<long long> oldKeys;
+    std::vector<int> oldHeads;
+
+    oldKeys.swap(cellKeys);
+    oldHeads.swap(cellHeads);
+
+    cellKeys.assign(std::max<size_t>(oldKeys.size() * 2, 64), 0);
+    cellHeads.assign(cellKeys.size(), -1);
+
+    const size_t mask = cellKeys.size() - 1;
+
+    for (size_t i = 0; i < oldKeys.size(); i++)
+    {
+        if (oldHeads[i] == -1)
+        {
+            continue;
+        }
+
+        size_t slot = getHomeSlot(oldKeys[i]);
+
+        while (cellHeads[slot] != -1)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        cellKeys[slot] = oldKeys[i];
+        cellHeads[slot] = oldHeads[i];
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Files a body under a grid cell, at the front of the cell's bodies
+
+ @param id            Id of the body
+ @param key           Key of the cell to file the body under
+ */
+void SpatialGrid::insertBody(int id, long long key)
+{
+    int slot = findCell(key);
+
+    if (slot == -1)
+    {
+        slot = addCell(key);
+    }
+
+    const int head = cellHeads[slot];
+
+    bodyCell[id] = key;
+    bodyPrev[id] = -1;
+    bodyNext[id] = head;
+    bodyFiled[id] = 1;
+
+    if (head != -1)
+    {
+        bodyPrev[head] = id;
+    }
+
+    cellHeads[slot] = id;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Removes a body from the grid cell it is filed under, dropping the cell if it was the last
+ body in it
+
+ @param id            Id of the body
+ */
+void SpatialGrid::removeBody(int id)
+{
+    const int prev = bodyPrev[id];
+    const int next = bodyNext[id];
+
+    if (next != -1)
+    {
+        bodyPrev[next] = prev;
+    }
+
+    if (prev != -1)
+    {
+        bodyNext[prev] = next;
+    }
+    else
+    {
+        const int slot = findCell(bodyCell[id]);
+
+        cellHeads[slot] = next;
+
+        if (next == -1)
+        {
+            dropCell(slot);
+        }
+    }
+
+    bodyFiled[id] = 0;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Starts bringing the grid up to date, every body still there has to be passed to update
+ before endUpdate
+
+ */
+void SpatialGrid::beginUpdate()
+{
+    updateCount++;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Files a body under the cell its center is in, moving it only if it changed cell
+
+ @param id            Id of the body, ids should be small and reused as they index arrays
+ @param x             Horizontal position of the center of the body
+ @param y             Vertical position of the center of the body
+ */
+void SpatialGrid::update(int id, float x, float y)
+{
+    long long key = getCellKey(x, y);
+
+    if (id >= (int)bodyCell.size())
+    {
+        bodyCell.resize(id + 1, 0);
+        bodyPrev.resize(id + 1, -1);
+        bodyNext.resize(id + 1, -1);
+        bodySeen.resize(id + 1, 0);
+        bodyFiled.resize(id + 1, 0);
+    }
+
+    if (!bodyFiled[id])
+    {
+        insertBody(id, key);
+    }
+    else if (bodyCell[id] != key)
+    {
+        removeBody(id);
+        insertBody(id, key);
+    }
+
+    bodySeen[id] = updateCount;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finishes bringing the grid up to date, removing every body that was not updated since
+ beginUpdate
+
+ */
+void SpatialGrid::endUpdate()
+{
+    for (size_t id = 0; id < bodyFiled.size(); id++)
+    {
+        if (bodyFiled[id] && bodySeen[id] != updateCount)
+        {
+            removeBody(id);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds candidate pairs of bodies that may be touching. Each pair of bodies in the same cell
+ or in neighbouring cells is reported once, by visiting each cell and only the half of its
+ neighbours that come after it
+
+ @param pairs         Cleared and filled with pairs of body ids that may be touching
+ */
+void SpatialGrid::findPairs(std::vector<std::pair<int, int>>& pairs) const
+{
+    pairs.clear();
+
+    for (size_t slot = 0; slot < cellKeys.size(); slot++)
+    {
+        if (cellHeads[slot] == -1)
+        {
+            continue;
+        }
+
+        for (int first = cellHeads[slot]; first != -1; first = bodyNext[first])
+        {
+            for (int second = bodyNext[first]; second != -1; second = bodyNext[second])
+            {
+                pairs.push_back(std::make_pair(first, second));
+            }
+        }
+
+        int cellX = (int)(cellKeys[slot] >> 32);
+        int cellY = (int)(cellKeys[slot] & 0xffffffffLL);
+
+        const int neighbours[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+        for (const auto& offset : neighbours)
+        {
+            const int neighbour = findCell(packCellKey(cellX + offset[0], cellY + offset[1]));
+
+            if (neighbour == -1)
+            {
+                continue;
+            }
+
+            for (int first = cellHeads[slot]; first != -1; first = bodyNext[first])
+            {
+                for (int second = cellHeads[neighbour]; second != -1; second = bodyNext[second])
+                {
+                    pairs.push_back(std::make_pair(first, second));
+                }
+            }
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Finds the bodies whose center lies in the cells a rectangle covers. Bodies reach past
+ their center, so callers widen the rectangle by the largest reach of their bodies and
+ test the bodies returned exactly. A rectangle covering more cells than the grid holds
+ walks the grid instead, so the cost is never more than one visit per filled cell
+
+ @param left          Left edge of the rectangle
+ @param top           Top edge of the rectangle
+ @param right         Right edge of the rectangle
+ @param bottom        Bottom edge of the rectangle
+ @param ids           Cleared and filled with the ids of the bodies found
+ */
+void SpatialGrid::query(float left, float top, float right, float bottom, std::vector<int>& ids) const
+{
+    ids.clear();
+
+    const int firstX = (int)floorf(left / cellSize);
+    const int firstY = (int)floorf(top / cellSize);
+    const int lastX = (int)floorf(right / cellSize);
+    const int lastY = (int)floorf(bottom / cellSize);
+
+    if (lastX < firstX || lastY < firstY)
+    {
+        return;
+    }
+
+    if ((double)(lastX - firstX + 1) * (lastY - firstY + 1) > cellCount)
+    {
+        for (size_t slot = 0; slot < cellKeys.size(); slot++)
+        {
+            if (cellHeads[slot] == -1)
+            {
+                continue;
+            }
+
+            int cellX = (int)(cellKeys[slot] >> 32);
+            int cellY = (int)(cellKeys[slot] & 0xffffffffLL);
+
+            if (cellX >= firstX && cellX <= lastX && cellY >= firstY && cellY <= lastY)
+            {
+                for (int id = cellHeads[slot]; id != -1; id = bodyNext[id])
+                {
+                    ids.push_back(id);
+                }
+            }
+        }
+
+        return;
+    }
+
+    for (int cellY = firstY; cellY <= lastY; cellY++)
+    {
+        for (int cellX = firstX; cellX <= lastX; cellX++)
+        {
+            const int slot = findCell(packCellKey(cellX, cellY));
+
+            if (slot == -1)
+            {
+                continue;
+            }
+
+            for (int id = cellHeads[slot]; id != -1; id = bodyNext[id])
+            {
+                ids.push_back(id);
+            }
+        }
+    }
+}
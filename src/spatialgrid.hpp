@@ -0,0 +1,64 @@
+#ifndef spatialgrid_hpp
+#define spatialgrid_hpp
+
+#include <cmath>
+#include <vector>
+#include <utility>
+
+
+/**
+ Uniform grid of cells keyed by their packed x and y cell coordinates, each holding the ids
+ of the bodies whose center lies inside it. Bodies are refiled only when they change cell,
+ so keeping the grid up to date costs one cell key per body. Collision detection asks it
+ for bodies in neighbouring cells, rendering asks it for bodies in the view
+
+ Only cells with bodies in are held, in an open addressed table, and the bodies of a cell
+ are linked through arrays indexed by body id. A cell is dropped as its last body leaves,
+ so the table stays as large as the most cells ever filled at once and, once that is
+ reached, refiling bodies never allocates
+ */
+class SpatialGrid
+{
+private:
+    float cellSize;
+
+    // Table of filled cells: each slot's cell key and the first body filed under it, -1 for
+    // a free slot. Its size is a power of two kept at least twice the cells filled
+    std::vector<long long> cellKeys;
+    std::vector<int> cellHeads;
+    int cellCount = 0;
+
+    // Per body id: the cell it is filed under, the bodies before and after it in that cell,
+    // whether it is filed at all and the update it was last seen in, so bodies that were
+    // not seen can be removed
+    std::vector<long long> bodyCell;
+    std::vector<int> bodyPrev, bodyNext, bodySeen;
+    std::vector<unsigned char> bodyFiled;
+    int updateCount = 0;
+
+    long long getCellKey(float x, float y) const;
+    static long long packCellKey(int cellX, int cellY);
+    size_t getHomeSlot(long long key) const;
+    int findCell(long long key) const;
+    int addCell(long long key);
+    void dropCell(int slot);
+    void growCells();
+    void insertBody(int id, long long key);
+    void removeBody(int id);
+
+public:
+    SpatialGrid(float cellSize);
+
+    void setCellSize(float cellSize);
+    float getCellSize() const;
+
+    void beginUpdate();
+    void update(int id, float x, float y);
+    void endUpdate();
+
+    void findPairs(std::vector<std::pair<int, int>>& pairs) const;
+    void query(float left, float top, float right, float bottom, std::vector<int>& ids) const;
+};
+
+
+#endif /* spatialgrid_hpp */
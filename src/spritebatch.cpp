@@ -0,0 +1,169 @@
+#include "spritebatch.hpp"
+
+#include <cmath>
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  #define SPRITEBATCH_GEOMETRY
+#endif
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a sprite batch that draws regions of an atlas
+
+ @param renderer  Renderer to draw the batch with
+ @param atlas     Atlas the drawn regions belong to
+ */
+SpriteBatch::SpriteBatch(SDL_Renderer *renderer, Atlas *atlas)
+    : renderer(renderer), atlas(atlas)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Queues an atlas region to be drawn on the next flush. The region is stretched to the rect
+ and rotated clockwise around center to point along direction. With a rotation cache the
+ region is drawn straight away instead, which keeps the order sprites are drawn in
+
+ @param region     Atlas region to draw
+ @param rect       Destination rectangle on screen
+ @param direction  Unit vector the sprite points along, (1, 0) is unrotated
+ @param center     Center of rotation relative to the top left of rect
+ */
+void SpriteBatch::draw(const AtlasRegion* region, const SDL_Rect& rect, const Vec2& direction, const SDL_Point& center)
+{
+    if (rotations != nullptr)
+    {
+        rotations->draw(atlas->getPage(region->page), &region->rect, rect, direction, center);
+        return;
+    }
+
+#ifdef SPRITEBATCH_GEOMETRY
+    if (region->page >= (int)vertices.size())
+    {
+        vertices.resize(region->page + 1);
+        indices.resize(region->page + 1);
+    }
+
+    std::vector<SDL_Vertex>& pageVertices = vertices[region->page];
+    std::vector<int>& pageIndices = indices[region->page];
+
+    const float pageWidth = atlas->getPageSize(region->page).x;
+    const float pageHeight = atlas->getPageSize(region->page).y;
+
+    // Rotate about the center and move the center to where it sits on screen, the direction
+    // is the cosine and sine of the rotation already
+    const Mat2x3 transform = Mat2x3::rotationAbout(Vec2(rect.x + center.x, rect.y + center.y),
+                                                   direction.x, direction.y);
+
+    const float u0 = region->rect.x / pageWidth;
+    const float v0 = region->rect.y / pageHeight;
+    const float u1 = (region->rect.x + region->rect.w) / pageWidth;
+    const float v1 = (region->rect.y + region->rect.h) / pageHeight;
+
+    // Corners of the quad relative to the center of rotation, clockwise from top left
+    Vec2 corners[4] = {
+        Vec2(-center.x,          -center.y),
+        Vec2(rect.w - center.x,  -center.y),
+        Vec2(rect.w - center.x,  rect.h - center.y),
+        Vec2(-center.x,          rect.h - center.y)
+    };
+    const Vec2 texCoords[4] = {Vec2(u0, v0), Vec2(u1, v0), Vec2(u1, v1), Vec2(u0, v1)};
+
+    transform.transformPoints(corners, corners, 4);
+
+    const int first = pageVertices.size();
+
+    for (int i = 0; i < 4; i++)
+    {
+        SDL_Vertex vertex;
+        vertex.position.x = corners[i].x;
+        vertex.position.y = corners[i].y;
+        vertex.color.r = vertex.color.g = vertex.color.b = vertex.color.a = 255;
+        vertex.tex_coord.x = texCoords[i].x;
+        vertex.tex_coord.y = texCoords[i].y;
+
+        pageVertices.push_back(vertex);
+    }
+
+    const int quad[6] = {0, 1, 2, 0, 2, 3};
+
+    for (int index : quad)
+    {
+        pageIndices.push_back(first + index);
+    }
+#else
+    Sprite sprite = {region, rect, direction.angle() * (180.0 / M_PI), center};
+    sprites.push_back(sprite);
+#endif
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws everything queued since the last flush, one call per atlas page that has sprites
+ queued. Sprites on the same page keep the order they were queued in
+
+ */
+void SpriteBatch::flush()
+{
+    drawCalls = 0;
+
+#ifdef SPRITEBATCH_GEOMETRY
+    for (size_t page = 0; page < vertices.size(); page++)
+    {
+        if (vertices[page].empty())
+        {
+            continue;
+        }
+
+        SDL_RenderGeometry(renderer, atlas->getPage(page), vertices[page].data(), vertices[page].size(),
+                           indices[page].data(), indices[page].size());
+        drawCalls++;
+
+        // Clearing keeps the capacity, so a steady number of sprites does not reallocate
+        vertices[page].clear();
+        indices[page].clear();
+    }
+#else
+    for (const Sprite& sprite : sprites)
+    {
+        SDL_RenderCopyEx(renderer, atlas->getPage(sprite.region->page), &sprite.region->rect, &sprite.rect,
+                         sprite.angle, &sprite.center, SDL_FLIP_NONE);
+        drawCalls++;
+    }
+
+    sprites.clear();
+#endif
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets a rotation cache to draw sprites through, for renderers that rotate slowly. It must
+ outlive the batch
+
+ @param rotations  Rotation cache, nullptr to rotate sprites as they are drawn
+ */
+void SpriteBatch::setRotationCache(RotationCache *rotations)
+{
+    this->rotations = rotations;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the atlas the batch draws from
+
+ @returns The atlas of the batch
+ */
+Atlas* SpriteBatch::getAtlas() { return atlas; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number of draw calls the last flush issued
+
+ @returns The number of draw calls
+ */
+int SpriteBatch::getDrawCalls() const { return drawCalls; }
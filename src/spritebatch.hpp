@@ -0,0 +1,49 @@
+#ifndef spritebatch_hpp
+#define spritebatch_hpp
+
+#include <vector>
+#include <SDL.h>
+#include "atlas.hpp"
+#include "rotationcache.hpp"
+#include "math2d.hpp"
+
+
+class SpriteBatch
+{
+private:
+    struct Sprite
+    {
+        const AtlasRegion* region;
+        SDL_Rect rect;
+        double angle;
+        SDL_Point center;
+    };
+
+    SDL_Renderer *renderer;
+    Atlas *atlas;
+
+    // With a rotation cache sprites are drawn straight away from their rotated frames
+    RotationCache *rotations = nullptr;
+
+    // Quads are queued per atlas page, each flush issues one geometry call per page
+    std::vector<std::vector<SDL_Vertex>> vertices;
+    std::vector<std::vector<int>> indices;
+
+    // Renderers older than SDL 2.0.18 have no geometry call, sprites are drawn one by one
+    std::vector<Sprite> sprites;
+
+    int drawCalls = 0;
+
+public:
+    SpriteBatch(SDL_Renderer *renderer, Atlas *atlas);
+
+    void draw(const AtlasRegion* region, const SDL_Rect& rect, const Vec2& direction, const SDL_Point& center);
+    void flush();
+    void setRotationCache(RotationCache *rotations);
+
+    Atlas* getAtlas();
+    int getDrawCalls() const;
+};
+
+
+#endif /* spritebatch_hpp */
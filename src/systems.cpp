@@ -0,0 +1,436 @@
+#include "systems.hpp"
+
+#include <algorithm>
+
+/** --------------------------------------------------------------------------------------
+ Moves a range of rows of an archetype with bodies in fixed point, as a deterministic
+ particle system does, then copies the result into the transforms and velocities
+
+ @param archetype  Archetype with transforms, velocities and bodies
+ @param begin      First row to move
+ @param end        One past the last row to move
+ @param dt         Length of the tick in 60hz frames
+ */
+static void moveBodies(Archetype& archetype, int begin, int end, float dt)
+{
+    Transform* transforms = archetype.transforms.data();
+    Velocity* velocities = archetype.velocities.data();
+    Body* bodies = archetype.bodies.data();
+
+    const Fixed step = Fixed::fromFloat(dt);
+
+    // Entities mostly share a friction, only compound each one over the tick once
+    float lastFriction = -1;
+    Fixed friction;
+
+    for (int i = begin; i < end; i++)
+    {
+        Velocity& velocity = velocities[i];
+        Body& body = bodies[i];
+
+        if (velocity.friction != lastFriction)
+        {
+            lastFriction = velocity.friction;
+            friction = fixedPow(Fixed::fromFloat(lastFriction), step);
+        }
+
+        body.velocityX *= friction;
+        body.velocityY *= friction;
+        body.velocityY += Fixed::fromFloat(velocity.gravity) * step;
+        body.x += body.velocityX * step;
+        body.y += body.velocityY * step;
+
+        velocity.x = body.velocityX.toFloat();
+        velocity.y = body.velocityY.toFloat();
+        transforms[i].x = body.x.toFloat();
+        transforms[i].y = body.y.toFloat();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves a range of rows of an archetype, applying friction and gravity the same way a
+ particle system does. Archetypes with bodies move in fixed point
+
+ @param archetype  Archetype with transforms and velocities
+ @param begin      First row to move
+ @param end        One past the last row to move
+ @param dt         Length of the tick in 60hz frames
+ */
+static void moveRows(Archetype& archetype, int begin, int end, float dt)
+{
+    if (archetype.mask & BODY)
+    {
+        moveBodies(archetype, begin, end, dt);
+        return;
+    }
+
+    Transform* transforms = archetype.transforms.data();
+    Velocity* velocities = archetype.velocities.data();
+
+    for (int i = begin; i < end; i++)
+    {
+        Velocity& velocity = velocities[i];
+
+        // Friction is tuned per 60hz frame, so compound it over the tick
+        const float friction = dt == 1 ? velocity.friction : powf(velocity.friction, dt);
+
+        velocity.x *= friction;
+        velocity.y *= friction;
+        velocity.y += velocity.gravity * dt;
+
+        transforms[i].x += velocity.x * dt;
+        transforms[i].y += velocity.y * dt;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves every entity with a transform and velocity
+
+ @param registry  Registry holding the entities
+ @param dt        Length of the tick in 60hz frames
+ */
+void MovementSystem::update(Registry& registry, float dt)
+{
+    registry.each(TRANSFORM | VELOCITY, [dt](Archetype& archetype)
+    {
+        moveRows(archetype, 0, archetype.size(), dt);
+    });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves every entity with a transform and velocity, each archetype split across threads
+
+ @param registry  Registry holding the entities
+ @param dt        Length of the tick in 60hz frames
+ @param jobs      Job system to run the ranges on
+ */
+void MovementSystem::update(Registry& registry, float dt, JobSystem& jobs)
+{
+    registry.each(TRANSFORM | VELOCITY, [dt, &jobs](Archetype& archetype)
+    {
+        jobs.parallelFor(archetype.size(), SYSTEM_GRAIN, [&archetype, dt](int begin, int end)
+        {
+            moveRows(archetype, begin, end, dt);
+        });
+    });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a collision system that keeps entities on screen
+
+ @param colDet  Collision detection object with the screen size
+ */
+CollisionSystem::CollisionSystem(ColDet *colDet)
+    : colDet(colDet)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Keeps a range of rows of an archetype with bodies on screen in fixed point, as collideRows
+ does in float, then copies the result into the transforms and velocities
+
+ @param colDet     Collision detection object with the screen size
+ @param archetype  Archetype with transforms, colliders and bodies
+ @param begin      First row to collide
+ @param end        One past the last row to collide
+ */
+static void collideBodies(ColDet* colDet, Archetype& archetype, int begin, int end)
+{
+    Transform* transforms = archetype.transforms.data();
+    const Collider* colliders = archetype.colliders.data();
+    Velocity* velocities = (archetype.mask & VELOCITY) ? archetype.velocities.data() : nullptr;
+    Body* bodies = archetype.bodies.data();
+
+    for (int i = begin; i < end; i++)
+    {
+        Body& body = bodies[i];
+        FixedVec2 position(body.x, body.y);
+        FixedVec2 velocity(body.velocityX, body.velocityY);
+        const Fixed midPoint = Fixed::fromFloat(colliders[i].midPoint);
+
+        if (colliders[i].wrap)
+        {
+            colDet->wrapScreen(position, midPoint);
+        }
+        else if (velocities != nullptr)
+        {
+            colDet->bounceScreen(position, velocity, midPoint);
+
+            body.velocityX = velocity.x;
+            body.velocityY = velocity.y;
+            velocities[i].x = velocity.x.toFloat();
+            velocities[i].y = velocity.y.toFloat();
+        }
+
+        body.x = position.x;
+        body.y = position.y;
+        transforms[i].x = position.x.toFloat();
+        transforms[i].y = position.y.toFloat();
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Keeps a range of rows of an archetype on screen. Colliders set to wrap come back on the
+ opposite edge, the rest bounce when they also have a velocity. Archetypes with bodies
+ collide in fixed point
+
+ @param colDet     Collision detection object with the screen size
+ @param archetype  Archetype with transforms and colliders
+ @param begin      First row to collide
+ @param end        One past the last row to collide
+ */
+static void collideRows(ColDet* colDet, Archetype& archetype, int begin, int end)
+{
+    if (archetype.mask & BODY)
+    {
+        collideBodies(colDet, archetype, begin, end);
+        return;
+    }
+
+    Transform* transforms = archetype.transforms.data();
+    const Collider* colliders = archetype.colliders.data();
+    Velocity* velocities = (archetype.mask & VELOCITY) ? archetype.velocities.data() : nullptr;
+
+    for (int i = begin; i < end; i++)
+    {
+        if (colliders[i].wrap)
+        {
+            colDet->wrapScreen(transforms[i].x, transforms[i].y, colliders[i].midPoint);
+        }
+        else if (velocities != nullptr)
+        {
+            colDet->bounceScreen(transforms[i].x, transforms[i].y, velocities[i].x, velocities[i].y,
+                                 colliders[i].midPoint);
+        }
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Keeps every entity with a collider on screen
+
+ @param registry  Registry holding the entities
+ */
+void CollisionSystem::update(Registry& registry)
+{
+    ColDet* colDet = this->colDet;
+
+    registry.each(TRANSFORM | COLLIDER, [colDet](Archetype& archetype)
+    {
+        collideRows(colDet, archetype, 0, archetype.size());
+    });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Keeps every entity with a collider on screen, each archetype split across threads
+
+ @param registry  Registry holding the entities
+ @param jobs      Job system to run the ranges on
+ */
+void CollisionSystem::update(Registry& registry, JobSystem& jobs)
+{
+    ColDet* colDet = this->colDet;
+
+    registry.each(TRANSFORM | COLLIDER, [colDet, &jobs](Archetype& archetype)
+    {
+        jobs.parallelFor(archetype.size(), SYSTEM_GRAIN, [colDet, &archetype](int begin, int end)
+        {
+            collideRows(colDet, archetype, begin, end);
+        });
+    });
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Files every entity with a transform in the collision grid under its position, and works
+ out how far the filed entities reach and could move. Call after the entities are kept on
+ screen, or after they are moved some other way such as being restored
+
+ @param registry  Registry holding the entities
+ */
+void CollisionSystem::updateGrid(Registry& registry)
+{
+    SpatialGrid& grid = colDet->getEntityGrid();
+
+    grid.beginUpdate();
+    reach = speed = gravity = 0;
+
+    registry.each(TRANSFORM, [this, &grid](Archetype& archetype)
+    {
+        const Transform* transforms = archetype.transforms.data();
+        const int count = archetype.size();
+
+        for (int i = 0; i < count; i++)
+        {
+            grid.update(archetype.entities[i].index, transforms[i].x, transforms[i].y);
+        }
+
+        if (archetype.mask & COLLIDER)
+        {
+            for (const Collider& collider : archetype.colliders)
+            {
+                reach = std::max(reach, collider.midPoint);
+            }
+        }
+
+        if (archetype.mask & VELOCITY)
+        {
+            for (const Velocity& velocity : archetype.velocities)
+            {
+                speed = std::max(speed, fabsf(velocity.x) + fabsf(velocity.y));
+                gravity = std::max(gravity, fabsf(velocity.gravity));
+            }
+        }
+
+        // Entities mostly share textures, only work out the reach of each once
+        if (archetype.mask & SPRITE)
+        {
+            const Texture* previous = nullptr;
+
+            for (const Sprite& sprite : archetype.sprites)
+            {
+                if (sprite.texture != nullptr && sprite.texture != previous)
+                {
+                    previous = sprite.texture;
+                    reach = std::max(reach, previous->getRadius());
+                }
+            }
+        }
+    });
+
+    // Anything still filed but not seen this update has been destroyed
+    grid.endUpdate();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the grid of entity indices, as of the last call to updateGrid
+
+ @returns The grid
+ */
+const SpatialGrid& CollisionSystem::getGrid() const { return colDet->getEntityGrid(); }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the furthest any filed entity reaches from its position, with its collider or its
+ sprite
+
+ @returns Distance in world units
+ */
+float CollisionSystem::getReach() const { return reach; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the furthest any filed entity could move in a tick. Friction only ever slows an
+ entity, so its speed plus a tick of gravity bounds it
+
+ @param dt  Length of the tick in 60hz frames
+ @returns   Distance in world units
+ */
+float CollisionSystem::getTravel(float dt) const
+{
+    return (speed + gravity * dt) * dt;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Counts down every entity with a lifetime and destroys those whose time has run out. The
+ entities are destroyed after the walk so no archetype changes while it is iterated
+
+ @param registry  Registry holding the entities
+ @param dt        Length of the tick in 60hz frames
+ */
+void LifetimeSystem::update(Registry& registry, float dt)
+{
+    registry.each(LIFETIME, [&registry, dt](Archetype& archetype)
+    {
+        Lifetime* lifetimes = archetype.lifetimes.data();
+        const int count = archetype.size();
+
+        for (int i = 0; i < count; i++)
+        {
+            lifetimes[i].remaining -= dt;
+
+            if (lifetimes[i].remaining <= 0)
+            {
+                registry.destroyLater(archetype.entities[i]);
+            }
+        }
+    });
+
+    registry.flushDestroyed();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Constructs a sprite system
+
+ @param collisionSystem  Collision system whose grid of entities the view is culled with
+ */
+SpriteSystem::SpriteSystem(const CollisionSystem *collisionSystem)
+    : collisionSystem(collisionSystem)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Draws every entity with a transform and sprite the camera can see. The collision grid
+ gives the entities filed near the view, in index order so overlapping sprites keep their
+ order as they move between cells. The grid is filed before the entities move in a tick,
+ so the view is widened by the most they could have moved since. Entities may share a
+ texture, each one places and turns it before it is drawn
+
+ @param registry  Registry holding the entities
+ @param camera    Camera to draw through
+ @param dt        Length of the tick in 60hz frames
+ */
+void SpriteSystem::render(Registry& registry, const Camera& camera, float dt)
+{
+    const Vec2 topLeft = camera.getPosition();
+    const Vec2 bottomRight = topLeft + camera.getViewSize();
+    const float reach = collisionSystem->getReach() + collisionSystem->getTravel(dt);
+
+    collisionSystem->getGrid().query(topLeft.x - reach, topLeft.y - reach, bottomRight.x + reach,
+                                     bottomRight.y + reach, visible);
+    std::sort(visible.begin(), visible.end());
+
+    for (int index : visible)
+    {
+        const Entity entity = registry.getEntity(index);
+        const Transform* transform = registry.get<Transform>(entity);
+        const Sprite* sprite = registry.get<Sprite>(entity);
+
+        if (transform == nullptr || sprite == nullptr || sprite->texture == nullptr)
+        {
+            continue;
+        }
+
+        // Transform angles are in radians, see Texture::setAngleByDegrees, which turns
+        // them into a direction with the polynomial sin / cos
+        sprite->texture->setAngleByDegrees(transform->angle);
+        sprite->texture->setLocation(transform->x, transform->y);
+        sprite->texture->render(camera);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef systems_hpp
+#define systems_hpp
+
+#include <cmath>
+#include "registry.hpp"
+#include "coldet.hpp"
+#include "jobsystem.hpp"
+#include "spatialgrid.hpp"
+#include "camera.hpp"
+
+/**
+ Systems run behaviour over every entity that has the components they need. Each one walks
+ the packed component arrays of the matching archetypes, so no entity is visited through a
+ pointer of its own. Systems given a job system split each archetype into ranges that
+ run across threads, entities in different rows never touch each other
+ */
+
+// Entities per job when a system is split across threads
+#define SYSTEM_GRAIN 1024
+
+
+class MovementSystem
+{
+public:
+    void update(Registry& registry, float dt);
+    void update(Registry& registry, float dt, JobSystem& jobs);
+};
+
+
+class CollisionSystem
+{
+private:
+    ColDet *colDet;
+
+    // Furthest any filed entity reaches from its position with its collider or sprite, and
+    // the fastest and most pulled on one is, so a grid query can allow for a tick of moving
+    float reach = 0, speed = 0, gravity = 0;
+
+public:
+    CollisionSystem(ColDet *colDet);
+
+    void update(Registry& registry);
+    void update(Registry& registry, JobSystem& jobs);
+    void updateGrid(Registry& registry);
+
+    const SpatialGrid& getGrid() const;
+    float getReach() const;
+    float getTravel(float dt) const;
+};
+
+
+class LifetimeSystem
+{
+public:
+    void update(Registry& registry, float dt);
+};
+
+
+class SpriteSystem
+{
+private:
+    // Culls against the collision grid, so drawing only visits the entities in view
+    const CollisionSystem *collisionSystem;
+    std::vector<int> visible;
+
+public:
+    SpriteSystem(const CollisionSystem *collisionSystem);
+
+    void render(Registry& registry, const Camera& camera, float dt);
+};
+
+
+#endif /* systems_hpp */
@@ -1,28 +1,26 @@
 #include "texture.hpp"
 
+#include <algorithm>
+
 /**
- Constructs a hardware texture from an image with a custom center of rotation
+ Constructs a hardware texture from an image with a custom center of rotation. Textures
+ of the same image share one hardware texture through the cache
 
- @param renderer  Renderer to send the texture to
+ @param cache     Texture cache to get the hardware texture from, also gives the renderer
  @param path      Path of the file to use when creating the texture
  @param rect      The rectangle we bind the texture to ready for sending to renderer
  @param centerX   Center X point of texture in the rect, used for rotation / offset
  @param centerY   Center Y point of the texture in the rect, used for rotation / offset
  */
-Texture::Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect, int centerX, int centerY)
-    : renderer(renderer), rect(rect)
+Texture::Texture(TextureCache* cache, std::string path, SDL_Rect &rect, int centerX, int centerY)
+    : renderer(cache->getRenderer()), rect(rect), rotations(cache->getRotationCache())
 {
     center.x = centerX;
     center.y = centerY;
 
-    // Create SDL surface from image
-    SDL_Surface* surface = IMG_Load(path.c_str());
-
-    // Create hardware optimise SDL texture from the surface
-    texture = SDL_CreateTextureFromSurface(renderer, surface);
-
-    // Free the surface after texture is made
-    SDL_FreeSurface(surface);
+    // Headless games have no renderer, the cache then hands out no texture and this only
+    // tracks its rect and direction
+    texture = cache->load(path);
 }
 
 
@@ -31,12 +29,31 @@ Texture::Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect, int c
  Construct a hardware texture from image with a default centered rotation center
  rect.w / 2 and rect.h / 2 are half the width and height of the output image
 
- @param renderer Renderer to send the texture to
+ @param cache    Texture cache to get the hardware texture from, also gives the renderer
  @param path     Path of the file to use when creating the texture
  @param rect     The rectangle we bind the texture to ready for sending to renderer
  */
-Texture::Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect)
-    :Texture(renderer, path, rect, rect.w / 2, rect.h / 2) {}
+Texture::Texture(TextureCache* cache, std::string path, SDL_Rect &rect)
+    :Texture(cache, path, rect, rect.w / 2, rect.h / 2) {}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Construct a texture that draws a region of an atlas through a sprite batch, with a
+ default centered rotation center
+
+ @param batch    Sprite batch to queue the texture in when rendering
+ @param name     Name of the atlas region to draw
+ @param rect     The rectangle we bind the texture to ready for sending to the batch
+ */
+Texture::Texture(SpriteBatch* batch, std::string name, SDL_Rect &rect)
+    : renderer(nullptr), rect(rect), batch(batch)
+{
+    center.x = rect.w / 2;
+    center.y = rect.h / 2;
+
+    region = batch->getAtlas()->getRegion(name);
+}
 
 
 
@@ -47,8 +64,8 @@ Texture::Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect)
  */
 void Texture::setAngleByDegrees(float degrees)
 {
-    // Angle of texture is in radians so convert from degrees to radians
-    this->angle = degrees * (180.0 / M_PI);
+    // Callers pass radians here, see SpriteSystem::render
+    direction = Vec2::fromAngleFast(degrees);
 }
 
 
@@ -60,7 +77,20 @@ void Texture::setAngleByDegrees(float degrees)
  */
 void Texture::setAngleByRadians(float radians)
 {
-    this->angle = radians;
+    // The value has always been handed to SDL as is, which takes degrees
+    direction = Vec2::fromAngleFast(radians * (M_PI / 180.0));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the rotation of the texture from a direction, with no trigonometry
+
+ @param direction   Unit vector the texture should point along, (1, 0) is unrotated
+ */
+void Texture::setDirection(const Vec2& direction)
+{
+    this->direction = direction;
 }
 
 
@@ -87,17 +117,78 @@ void Texture::scroll(int xOffset, int yOffset)
  */
 void Texture::setLocation(float x, float y)
 {
-    rect.x = x - rect.w / 2;
-    rect.y = y - rect.h / 2;
+    setLocation(Vec2(x, y));
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets the location of the texture relative to its center point
+
+ @param position   Location relative to center point
+ */
+void Texture::setLocation(const Vec2& position)
+{
+    const Vec2 topLeft = position - Vec2(rect.w / 2, rect.h / 2);
+
+    rect.x = topLeft.x;
+    rect.y = topLeft.y;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how far the texture reaches from its center of rotation at any angle, the distance
+ to its furthest corner
+
+ @returns Radius of the circle the texture stays within as it turns
+ */
+float Texture::getRadius() const
+{
+    const float reachX = std::max(center.x, rect.w - center.x);
+    const float reachY = std::max(center.y, rect.h - center.y);
+
+    return sqrtf(reachX * reachX + reachY * reachY);
 }
 
 
 
 /** --------------------------------------------------------------------------------------
- Copies the texture to the render and in so doing makes it visibile on screen
+ Copies the texture to the render and in so doing makes it visibile on screen, textures
+ bound to a sprite batch are queued and drawn when the batch is flushed. The location of
+ the texture is in the world, textures the camera cannot see are not sent at all
 
+ @param camera    Camera to draw the texture through
  */
-void Texture::render()
+void Texture::render(const Camera& camera)
 {
-    SDL_RenderCopyEx(renderer, texture, nullptr, &rect, angle, &center, SDL_FLIP_NONE );
+    if (!camera.isVisible(Vec2(rect.x + center.x, rect.y + center.y), getRadius()))
+    {
+        return;
+    }
+
+    const float zoom = camera.getZoom();
+    const SDL_Rect screen = camera.worldToScreen(rect);
+    const SDL_Point screenCenter = {(int)(center.x * zoom), (int)(center.y * zoom)};
+
+    if (region != nullptr)
+    {
+        batch->draw(region, screen, direction, screenCenter);
+        return;
+    }
+
+    if (texture == nullptr)
+    {
+        return;
+    }
+
+    if (rotations != nullptr)
+    {
+        rotations->draw(texture.get(), nullptr, screen, direction, screenCenter);
+        return;
+    }
+
+    const double angle = direction.angle() * (180.0 / M_PI);
+
+    SDL_RenderCopyEx(renderer, texture.get(), nullptr, &screen, angle, &screenCenter, SDL_FLIP_NONE );
 }
@@ -6,26 +6,46 @@
 #include <stdio.h>
 #include <cmath>
 #include <string>
+#include <memory>
+#include "math2d.hpp"
+#include "camera.hpp"
+#include "spritebatch.hpp"
+#include "texturecache.hpp"
 
 
 class Texture
 {
 private:
     SDL_Renderer *renderer;
-    SDL_Texture *texture;
+    std::shared_ptr<SDL_Texture> texture;
     SDL_Rect rect;
     SDL_Point center;
-    double angle = 0;
+
+    // Rotation as a unit vector, SpriteBatch uses it as is and only textures drawn on
+    // their own turn it into the angle SDL_RenderCopyEx wants
+    Vec2 direction = Vec2(1, 0);
+
+    // Textures drawn through a sprite batch use a region of the batch's atlas instead of
+    // a texture of their own
+    SpriteBatch *batch = nullptr;
+    const AtlasRegion *region = nullptr;
+
+    // Textures of their own are drawn from rotated frames when there is a rotation cache
+    RotationCache *rotations = nullptr;
 
 public:
-    Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect, int centerX, int centerY);
-    Texture(SDL_Renderer* renderer, std::string path, SDL_Rect &rect);
+    Texture(TextureCache* cache, std::string path, SDL_Rect &rect, int centerX, int centerY);
+    Texture(TextureCache* cache, std::string path, SDL_Rect &rect);
+    Texture(SpriteBatch* batch, std::string name, SDL_Rect &rect);
 
     void setAngleByDegrees(float degrees);
     void setAngleByRadians(float radians);
+    void setDirection(const Vec2& direction);
     void scroll(int xOffset, int yOffset);
     void setLocation(float x, float y);
-    void render();
+    void setLocation(const Vec2& position);
+    float getRadius() const;
+    void render(const Camera& camera);
 };
 
 
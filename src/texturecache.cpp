@@ -0,0 +1,227 @@
+#include "texturecache.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Constructs an empty texture cache
+
+ @param renderer  Renderer to create the cached textures with
+ */
+TextureCache::TextureCache(SDL_Renderer *renderer)
+    : renderer(renderer), stats(std::make_shared<Stats>())
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a shared handle to the texture of an image, decoding and uploading the image only
+ if no other handle to it is still alive. Images in the archive are uploaded straight from
+ it without decoding, the image file is used if that fails
+
+ @param path  Path of the image file, used as the cache key
+ @returns     Shared handle to the texture, nullptr if the image could not be loaded
+ */
+std::shared_ptr<SDL_Texture> TextureCache::load(const std::string& path)
+{
+    std::shared_ptr<SDL_Texture> texture = find(path);
+
+    if (texture)
+    {
+        return texture;
+    }
+
+    stats->misses++;
+
+    if (renderer == nullptr)
+    {
+        return nullptr;
+    }
+
+    const ArchiveEntry* entry = archive != nullptr ? archive->find(path) : nullptr;
+
+    if (entry != nullptr)
+    {
+        SDL_Texture* created = archive->createTexture(renderer, entry);
+
+        if (created != nullptr)
+        {
+            return insert(path, created);
+        }
+
+        // Fall back to the image file rather than losing the image
+        printf("Failed to load %s from the archive, trying the file\n", path.c_str());
+    }
+
+    // Create SDL surface from image
+    SDL_Surface* surface = IMG_Load(path.c_str());
+
+    if (surface == nullptr)
+    {
+        printf("Failed to load %s: %s\n", path.c_str(), IMG_GetError());
+        return nullptr;
+    }
+
+    // Create hardware optimised SDL texture from the surface
+    SDL_Texture* created = SDL_CreateTextureFromSurface(renderer, surface);
+
+    // Free the surface after texture is made
+    SDL_FreeSurface(surface);
+
+    return insert(path, created);
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a shared handle to an already cached texture, counting a hit if there is one
+
+ @param path  Path of the image file, used as the cache key
+ @returns     Shared handle to the texture, nullptr if it is not cached
+ */
+std::shared_ptr<SDL_Texture> TextureCache::find(const std::string& path)
+{
+    auto entry = entries.find(path);
+
+    if (entry != entries.end())
+    {
+        std::shared_ptr<SDL_Texture> texture = entry->second.lock();
+
+        if (texture)
+        {
+            stats->hits++;
+            return texture;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Hands a texture created elsewhere over to the cache, which destroys it when the last
+ handle to it goes away
+
+ @param path     Path of the image the texture was made from, used as the cache key
+ @param texture  Texture to hand over
+ @returns        Shared handle to the texture, nullptr if texture is nullptr or cannot be
+                 queried, which destroys it
+ */
+std::shared_ptr<SDL_Texture> TextureCache::insert(const std::string& path, SDL_Texture* texture)
+{
+    if (texture == nullptr)
+    {
+        return nullptr;
+    }
+
+    Uint32 format;
+    int width, height;
+
+    if (SDL_QueryTexture(texture, &format, nullptr, &width, &height) != 0)
+    {
+        printf("Failed to query texture for %s: %s\n", path.c_str(), SDL_GetError());
+        SDL_DestroyTexture(texture);
+        return nullptr;
+    }
+
+    long bytes = (long)width * height * SDL_BYTESPERPIXEL(format);
+
+    stats->residentTextures++;
+    stats->residentBytes += bytes;
+
+    std::shared_ptr<Stats> counts = stats;
+    RotationCache* frames = rotations;
+
+    std::shared_ptr<SDL_Texture> handle(texture, [counts, frames, bytes](SDL_Texture* texture)
+    {
+        // A texture created later at the same address must not be drawn with these frames
+        if (frames != nullptr)
+        {
+            frames->evict(texture);
+        }
+
+        SDL_DestroyTexture(texture);
+
+        counts->residentTextures--;
+        counts->residentBytes -= bytes;
+    });
+
+    entries[path] = handle;
+
+    return handle;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets an archive to load images from before trying files, it must stay open while the
+ cache is used
+
+ @param archive  Open archive, nullptr to only load files
+ */
+void TextureCache::setArchive(AssetArchive *archive)
+{
+    this->archive = archive;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the archive images are loaded from
+
+ @returns The archive, nullptr if there is none
+ */
+AssetArchive* TextureCache::getArchive() { return archive; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets a rotation cache for textures made from the cache's images to draw through, set it
+ before creating them. It must outlive them
+
+ @param rotations  Rotation cache, nullptr to rotate textures as they are drawn
+ */
+void TextureCache::setRotationCache(RotationCache *rotations)
+{
+    this->rotations = rotations;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the rotation cache textures draw through
+
+ @returns The rotation cache, nullptr if there is none
+ */
+RotationCache* TextureCache::getRotationCache() { return rotations; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the renderer the cache creates textures with
+
+ @returns The renderer of the cache
+ */
+SDL_Renderer* TextureCache::getRenderer() { return renderer; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the cache statistics: loads served from the cache, loads that had to decode an
+ image, and the number and approximate GPU memory of textures still alive
+ */
+int TextureCache::getHits() const { return stats->hits; }
+int TextureCache::getMisses() const { return stats->misses; }
+int TextureCache::getResidentTextures() const { return stats->residentTextures; }
+long TextureCache::getResidentBytes() const { return stats->residentBytes; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints the cache statistics
+
+ */
+void TextureCache::printStats() const
+{
+    printf("texture cache: %d hits, %d misses, %d textures, %ld kb resident\n",
+           stats->hits, stats->misses, stats->residentTextures, stats->residentBytes / 1024);
+}
@@ -0,0 +1,57 @@
+#ifndef texturecache_hpp
+#define texturecache_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "assetarchive.hpp"
+#include "rotationcache.hpp"
+
+
+class TextureCache
+{
+private:
+    struct Stats
+    {
+        int hits = 0, misses = 0, residentTextures = 0;
+        long residentBytes = 0;
+    };
+
+    SDL_Renderer *renderer;
+
+    // Images in the archive are uploaded from it instead of being decoded from files
+    AssetArchive *archive = nullptr;
+
+    // Rotated frames for the textures made from the cache's images
+    RotationCache *rotations = nullptr;
+
+    // Entries do not keep their texture alive, the last handle to go away destroys it
+    std::unordered_map<std::string, std::weak_ptr<SDL_Texture>> entries;
+
+    // Shared with the handles so they can update the counts even after the cache is gone
+    std::shared_ptr<Stats> stats;
+
+public:
+    TextureCache(SDL_Renderer *renderer);
+
+    std::shared_ptr<SDL_Texture> load(const std::string& path);
+    std::shared_ptr<SDL_Texture> insert(const std::string& path, SDL_Texture* texture);
+    std::shared_ptr<SDL_Texture> find(const std::string& path);
+
+    void setArchive(AssetArchive *archive);
+    AssetArchive* getArchive();
+    void setRotationCache(RotationCache *rotations);
+    RotationCache* getRotationCache();
+    SDL_Renderer* getRenderer();
+    int getHits() const;
+    int getMisses() const;
+    int getResidentTextures() const;
+    long getResidentBytes() const;
+    void printStats() const;
+};
+
+
+#endif /* texturecache_hpp */
@@ -0,0 +1,287 @@
+#include "tilelayer.hpp"
+
+/** --------------------------------------------------------------------------------------
+ Constructs a tile layer with no map, open one before rendering
+
+ @param textureCache  Texture cache the tiles are loaded through, its renderer is the one
+                      the layer is sent to
+ @param budget        Most bytes of tiles to keep loaded, the tiles on screen are kept even
+                      if they take more
+ */
+TileLayer::TileLayer(TextureCache *textureCache, long budget)
+    : renderer(textureCache->getRenderer()), textureCache(textureCache), budget(budget)
+{
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Reads a map file, dropping every tile of the previous map. No tiles are loaded until they
+ are drawn
+
+ @param path  Path of the map file, the tiles are in the same directory
+ @returns     False if the file could not be read or describes an empty map
+ */
+bool TileLayer::open(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "r");
+
+    if (file == nullptr)
+    {
+        printf("Failed to open tile map %s\n", path.c_str());
+        return false;
+    }
+
+    char line[256];
+    int read = 0;
+
+    // Lines starting with # are comments, the first other line is the map size
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        if (line[0] != '#')
+        {
+            read = sscanf(line, "%d %d %d %d", &tileWidth, &tileHeight, &columns, &rows);
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if (read != 4 || tileWidth <= 0 || tileHeight <= 0 || columns <= 0 || rows <= 0)
+    {
+        printf("Tile map %s should hold tile width, tile height, columns and rows\n", path.c_str());
+        tileWidth = tileHeight = columns = rows = 0;
+        return false;
+    }
+
+    size_t slash = path.find_last_of("/\\");
+    directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+    resident.clear();
+    lookup.clear();
+    missing.clear();
+    residentBytes = 0;
+    frame = 0;
+
+    return true;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets a tile, marking it as drawn this frame. A tile that is not loaded yet is loaded if
+ allowed and there are loads left this frame
+
+ @param column  Column of the tile, wrapped onto the map
+ @param row     Row of the tile, wrapped onto the map
+ @param load    True to load the tile if it is not loaded
+ @returns       The tile, nullptr if it is not loaded
+ */
+TileLayer::Tile* TileLayer::getTile(int column, int row, bool load)
+{
+    column = ((column % columns) + columns) % columns;
+    row = ((row % rows) + rows) % rows;
+
+    const int index = row * columns + column;
+    auto entry = lookup.find(index);
+
+    if (entry != lookup.end())
+    {
+        // Move to the front, it is the most recently drawn now
+        resident.splice(resident.begin(), resident, entry->second);
+        entry->second->usedAt = frame;
+
+        return &*entry->second;
+    }
+
+    if (!load || loadsLeft == 0 || missing.count(index) > 0)
+    {
+        return nullptr;
+    }
+
+    loadsLeft--;
+    loads++;
+
+    std::shared_ptr<SDL_Texture> texture = textureCache->load(
+        directory + "tile_" + std::to_string(column) + "_" + std::to_string(row) + ".png");
+
+    if (texture == nullptr)
+    {
+        missing.insert(index);
+        return nullptr;
+    }
+
+    Uint32 format;
+    int width, height;
+    SDL_QueryTexture(texture.get(), &format, nullptr, &width, &height);
+
+    Tile tile = {index, texture, (long)width * height * SDL_BYTESPERPIXEL(format), frame};
+
+    resident.push_front(tile);
+    lookup[index] = resident.begin();
+    residentBytes += tile.bytes;
+
+    return &resident.front();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Drops the least recently drawn tiles until the loaded tiles fit in the budget, never one
+ drawn this frame. Dropping the last handle to a tile destroys its texture
+
+ */
+void TileLayer::evict()
+{
+    while (residentBytes > budget && !resident.empty() && resident.back().usedAt != frame)
+    {
+        residentBytes -= resident.back().bytes;
+        lookup.erase(resident.back().index);
+        resident.pop_back();
+        evictions++;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Moves the map through the world, it repeats so only the offset within one map is kept
+
+ @param xOffset   Amount to scroll right, negative scrolls left
+ @param yOffset   Amount to scroll down, negative scrolls up
+ */
+void TileLayer::scroll(int xOffset, int yOffset)
+{
+    if (columns == 0)
+    {
+        return;
+    }
+
+    scrollX = (scrollX + xOffset) % getWidth();
+    scrollY = (scrollY + yOffset) % getHeight();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Render the tiles in view of a camera, tiles outside the view are never sent. Tiles that
+ are not loaded yet are loaded a few per frame so a fast camera cannot stall a frame, then
+ the ring of tiles just out of view is loaded ahead of the camera
+
+ @param camera    Camera to draw through
+ */
+void TileLayer::render(const Camera& camera)
+{
+    if (renderer == nullptr || columns == 0)
+    {
+        return;
+    }
+
+    // The first frame of a map loads the whole screen rather than popping it in
+    frame++;
+    loadsLeft = frame == 1 ? columns * rows : loadsPerFrame;
+
+    // The part of the map in view, tiles left of or above the map get negative indices
+    const Vec2 topLeft = camera.getPosition() - Vec2(scrollX, scrollY);
+    const Vec2 bottomRight = topLeft + camera.getViewSize();
+
+    const int firstColumn = (int)floorf(topLeft.x / tileWidth);
+    const int firstRow = (int)floorf(topLeft.y / tileHeight);
+    const int lastColumn = (int)ceilf(bottomRight.x / tileWidth) - 1;
+    const int lastRow = (int)ceilf(bottomRight.y / tileHeight) - 1;
+
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        for (int column = firstColumn; column <= lastColumn; column++)
+        {
+            Tile* tile = getTile(column, row, true);
+
+            if (tile != nullptr)
+            {
+                SDL_Rect world = {column * tileWidth + scrollX, row * tileHeight + scrollY, tileWidth, tileHeight};
+                SDL_Rect destination = camera.worldToScreen(world);
+
+                SDL_RenderCopy(renderer, tile->texture.get(), nullptr, &destination);
+            }
+        }
+    }
+
+    // Only load ahead when the screen and the ring around it fit in the budget together,
+    // or the ring would push out tiles that are about to come back on screen
+    const long ringBytes = (long)(lastColumn - firstColumn + 3) * (lastRow - firstRow + 3) * tileWidth * tileHeight * 4;
+
+    for (int row = firstRow - 1; row <= lastRow + 1 && ringBytes <= budget && loadsLeft > 0; row++)
+    {
+        for (int column = firstColumn - 1; column <= lastColumn + 1; column++)
+        {
+            bool onScreen = row >= firstRow && row <= lastRow && column >= firstColumn && column <= lastColumn;
+
+            if (!onScreen)
+            {
+                getTile(column, row, true);
+            }
+        }
+    }
+
+    evict();
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Sets how many tiles may be loaded in one frame, more tiles come in faster when the camera
+ jumps but a frame that loads them takes longer
+
+ @param loadsPerFrame  Most tiles to load per frame
+ */
+void TileLayer::setLoadsPerFrame(int loadsPerFrame)
+{
+    if (loadsPerFrame > 0)
+    {
+        this->loadsPerFrame = loadsPerFrame;
+    }
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the size of the whole map, after which it repeats
+
+ @returns Width or height of the map in pixels, 0 if no map is open
+ */
+int TileLayer::getWidth() const { return tileWidth * columns; }
+int TileLayer::getHeight() const { return tileHeight * rows; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets how far the map is moved through the world
+
+ @returns Scroll of the map, wrapped to within one map
+ */
+SDL_Point TileLayer::getScroll() const
+{
+    SDL_Point point = {scrollX, scrollY};
+    return point;
+}
+
+
+
+/** --------------------------------------------------------------------------------------
+ Gets the number and approximate GPU memory of the tiles loaded
+
+ */
+int TileLayer::getResidentTiles() const { return resident.size(); }
+long TileLayer::getResidentBytes() const { return residentBytes; }
+
+
+
+/** --------------------------------------------------------------------------------------
+ Prints the tile statistics
+
+ */
+void TileLayer::printStats() const
+{
+    printf("tile layer: %d loads, %d evictions, %d tiles, %ld kb resident of %ld kb budget\n",
+           loads, evictions, (int)resident.size(), residentBytes / 1024, budget / 1024);
+}
@@ -0,0 +1,75 @@
+#ifndef tilelayer_hpp
+#define tilelayer_hpp
+
+#include <stdio.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <SDL.h>
+#include <SDL_image.h>
+#include "texturecache.hpp"
+#include "camera.hpp"
+
+
+/**
+ A world sized image split into fixed size tiles, drawn through a camera. Only the tiles
+ the camera has been near are loaded, the least recently drawn ones are dropped once
+ the loaded tiles take up more than a memory budget. The map repeats past its edges like
+ the screen sized layers do
+
+ A map is a text file holding the tile width, tile height, columns and rows, with the
+ tiles next to it named tile_<column>_<row>.png
+ */
+class TileLayer
+{
+private:
+    struct Tile
+    {
+        int index;
+        std::shared_ptr<SDL_Texture> texture;
+        long bytes;
+        int usedAt;
+    };
+
+    SDL_Renderer *renderer;
+    TextureCache *textureCache;
+
+    // How far the map is moved through the world, wrapped to within one map
+    int scrollX = 0, scrollY = 0;
+
+    std::string directory;
+    int tileWidth = 0, tileHeight = 0, columns = 0, rows = 0;
+
+    // Loaded tiles, most recently drawn at the front. Tiles that failed to load are not
+    // tried again
+    std::list<Tile> resident;
+    std::unordered_map<int, std::list<Tile>::iterator> lookup;
+    std::unordered_set<int> missing;
+
+    long budget, residentBytes = 0;
+    int loadsPerFrame = 4, loadsLeft = 0;
+    int frame = 0, loads = 0, evictions = 0;
+
+    Tile* getTile(int column, int row, bool load);
+    void evict();
+
+public:
+    TileLayer(TextureCache *textureCache, long budget);
+
+    bool open(const std::string& path);
+    void scroll(int xOffset, int yOffset);
+    void render(const Camera& camera);
+    void setLoadsPerFrame(int loadsPerFrame);
+
+    int getWidth() const;
+    int getHeight() const;
+    SDL_Point getScroll() const;
+    int getResidentTiles() const;
+    long getResidentBytes() const;
+    void printStats() const;
+};
+
+
+#endif /* tilelayer_hpp */